@@ -0,0 +1,166 @@
+#include "blob_packer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+#include "simd.hpp"
+
+namespace UsArMirror {
+
+namespace {
+
+using simd::f32x4;
+
+/// Channel `channel` of the source pixels at byte offsets `offsets`.
+template<typename V> V gather(const uint8_t* row, const int* offsets, int channel);
+template<> inline float gather<float>(const uint8_t* row, const int* offsets, int channel) {
+    return row[offsets[0] + channel];
+}
+template<> inline f32x4 gather<f32x4>(const uint8_t* row, const int* offsets, int channel) {
+    return f32x4{static_cast<float>(row[offsets[0] + channel]), static_cast<float>(row[offsets[1] + channel]),
+                 static_cast<float>(row[offsets[2] + channel]), static_cast<float>(row[offsets[3] + channel])};
+}
+
+template<typename V> V loadFloats(const float* p);
+template<> inline float loadFloats<float>(const float* p) { return *p; }
+template<> inline f32x4 loadFloats<f32x4>(const float* p) { return simd::load(p); }
+
+inline void storeFloats(float* p, float v) { *p = v; }
+inline void storeFloats(float* p, f32x4 v) { simd::store(p, v); }
+
+/// Horizontal pass: output columns [x, x + lanes) of one source row into
+/// planar rows of `width` floats per channel.
+template<typename V>
+inline void resampleRow(const uint8_t* row, const int* left, const int* right, const float* weight, int width,
+                        float* out, int x) {
+    V wx = loadFloats<V>(weight + x);
+    for (int c = 0; c < 3; ++c) {
+        V a = gather<V>(row, left + x, c);
+        V b = gather<V>(row, right + x, c);
+        storeFloats(out + c * width + x, a + (b - a) * wx);
+    }
+}
+
+/// Vertical pass: blend two resampled rows and subtract the mean.
+template<typename V>
+inline void blendRows(const float* upper, const float* lower, float wy, float mean, float* out, int x) {
+    V a = loadFloats<V>(upper + x);
+    V b = loadFloats<V>(lower + x);
+    storeFloats(out + x, a + (b - a) * wy - mean);
+}
+
+/// Source coordinate of output pixel `i` for a resize by `scale`, with
+/// pixel centres aligned like cv::resize.
+inline float sourceCoordinate(int i, float scale, int size) {
+    float s = (static_cast<float>(i) + 0.5f) / scale - 0.5f;
+    return std::clamp(s, 0.0f, static_cast<float>(size - 1));
+}
+
+} // namespace
+
+BlobPacker::BlobPacker(cv::Size inputSize, const cv::Scalar& mean) : inputSize(inputSize) {
+    for (int c = 0; c < 3; ++c) this->mean[c] = static_cast<float>(mean[c]);
+}
+
+void BlobPacker::buildColumns(int cols, int width, float scale) {
+    if (cols == tableCols && width == tableWidth && scale == tableScale) return;
+    tableCols = cols;
+    tableWidth = width;
+    tableScale = scale;
+    left.resize(width);
+    right.resize(width);
+    weight.resize(width);
+    for (int x = 0; x < width; ++x) {
+        float s = sourceCoordinate(x, scale, cols);
+        int x0 = static_cast<int>(s);
+        int x1 = std::min(x0 + 1, cols - 1);
+        left[x] = x0 * 3;
+        right[x] = x1 * 3;
+        weight[x] = s - static_cast<float>(x0);
+    }
+}
+
+const float* BlobPacker::resampledRow(const cv::Mat& image, int row, int width) {
+    for (int i = 0; i < 2; ++i) {
+        if (cachedRow[i] == row) return rowCache[i].data();
+    }
+    // Rows are visited top to bottom, so the older entry is never needed again.
+    int slot = cachedRow[0] < cachedRow[1] ? 0 : 1;
+    cachedRow[slot] = row;
+    std::vector<float>& out = rowCache[slot];
+    out.resize(static_cast<size_t>(3) * width);
+    const uint8_t* source = image.ptr<uint8_t>(row);
+    int x = 0;
+    for (; x + simd::lanes <= width; x += simd::lanes) {
+        resampleRow<f32x4>(source, left.data(), right.data(), weight.data(), width, out.data(), x);
+    }
+    for (; x < width; ++x) resampleRow<float>(source, left.data(), right.data(), weight.data(), width, out.data(), x);
+    return out.data();
+}
+
+BlobPacker::Placement BlobPacker::pack(size_t index, const cv::Mat& image, bool letterbox) {
+    if (image.type() != CV_8UC3 || image.empty()) throw std::runtime_error("BlobPacker needs a CV_8UC3 image");
+    auto start = std::chrono::steady_clock::now();
+
+    const int outWidth = inputSize.width;
+    const int outHeight = inputSize.height;
+    const size_t plane = static_cast<size_t>(outWidth) * outHeight;
+    if (data.size() < (index + 1) * 3 * plane) data.resize((index + 1) * 3 * plane);
+    float* slot = data.data() + index * 3 * plane;
+
+    float scaleX = static_cast<float>(outWidth) / image.cols;
+    float scaleY = static_cast<float>(outHeight) / image.rows;
+    if (letterbox) scaleX = scaleY = std::min(scaleX, scaleY);
+    int width = std::clamp(static_cast<int>(std::lround(image.cols * scaleX)), 1, outWidth);
+    int height = std::clamp(static_cast<int>(std::lround(image.rows * scaleY)), 1, outHeight);
+    int offsetX = (outWidth - width) / 2;
+    int offsetY = (outHeight - height) / 2;
+    buildColumns(image.cols, width, scaleX);
+    cachedRow[0] = cachedRow[1] = -1;
+
+    for (int c = 0; c < 3; ++c) {
+        float* channel = slot + c * plane;
+        // Padding is the mean color, i.e. zero.
+        std::fill(channel, channel + static_cast<size_t>(offsetY) * outWidth, 0.0f);
+        std::fill(channel + static_cast<size_t>(offsetY + height) * outWidth, channel + plane, 0.0f);
+    }
+
+    for (int y = 0; y < height; ++y) {
+        float s = sourceCoordinate(y, scaleY, image.rows);
+        int y0 = static_cast<int>(s);
+        int y1 = std::min(y0 + 1, image.rows - 1);
+        float wy = s - static_cast<float>(y0);
+
+        const float* upper = resampledRow(image, y0, width);
+        const float* lower = resampledRow(image, y1, width);
+
+        for (int c = 0; c < 3; ++c) {
+            float* row = slot + c * plane + static_cast<size_t>(offsetY + y) * outWidth;
+            std::fill(row, row + offsetX, 0.0f);
+            std::fill(row + offsetX + width, row + outWidth, 0.0f);
+            float* out = row + offsetX;
+            const float* a = upper + c * width;
+            const float* b = lower + c * width;
+            int x = 0;
+            for (; x + simd::lanes <= width; x += simd::lanes) blendRows<f32x4>(a, b, wy, mean[c], out, x);
+            for (; x < width; ++x) blendRows<float>(a, b, wy, mean[c], out, x);
+        }
+    }
+
+    lastCost = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    Placement placement;
+    placement.scale = cv::Point2f(scaleX, scaleY);
+    placement.offset = cv::Point2f(static_cast<float>(offsetX), static_cast<float>(offsetY));
+    return placement;
+}
+
+cv::Mat BlobPacker::batch(size_t count) {
+    const size_t plane = static_cast<size_t>(inputSize.width) * inputSize.height;
+    if (data.size() < count * 3 * plane) data.resize(count * 3 * plane);
+    int sizes[4] = {static_cast<int>(count), 3, inputSize.height, inputSize.width};
+    return cv::Mat(4, sizes, CV_32F, data.data());
+}
+
+} // namespace UsArMirror
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace UsArMirror {
+
+/// Persistent NCHW float input tensor for a CNN, filled in place.
+///
+/// pack() resizes a BGR8 image bilinearly, subtracts the mean and writes
+/// the three channel planes of one batch slot in a single pass over the
+/// output, four pixels at a time: each source row is resampled
+/// horizontally once into planar floats, and every output row blends two
+/// of those. That replaces cv::dnn::blobFromImage(), which
+/// allocates a new blob every call and resizes, converts, subtracts and
+/// transposes in separate passes. Storage only grows, so a steady batch
+/// size allocates nothing after the first call.
+class BlobPacker {
+public:
+    /// Where a packed image landed: network pixel = image pixel * scale + offset.
+    struct Placement {
+        cv::Point2f scale = cv::Point2f(1.0f, 1.0f);
+        cv::Point2f offset;
+
+        cv::Point2f toImage(const cv::Point2f& p) const {
+            return cv::Point2f((p.x - offset.x) / scale.x, (p.y - offset.y) / scale.y);
+        }
+    };
+
+    BlobPacker(cv::Size inputSize, const cv::Scalar& mean);
+
+    /// Fill slot `index` from CV_8UC3 `image`. With `letterbox`, the image
+    /// keeps its aspect ratio, centred, and the padding is zero, i.e. the
+    /// mean color; otherwise it is stretched to the input size.
+    Placement pack(size_t index, const cv::Mat& image, bool letterbox = true);
+
+    /// NCHW view of the first `count` slots, valid until the next pack()
+    /// into a new slot.
+    cv::Mat batch(size_t count);
+
+    cv::Size getInputSize() const { return inputSize; }
+    /// Wall time of the last pack() call.
+    double lastCostMs() const { return lastCost; }
+
+private:
+    /// Rebuild the column tables for an image of `cols` columns mapped to
+    /// `width` output columns.
+    void buildColumns(int cols, int width, float scale);
+    /// Source `row` resampled to `width` columns, one plane per channel.
+    const float* resampledRow(const cv::Mat& image, int row, int width);
+
+    cv::Size inputSize;
+    float mean[3];
+    std::vector<float> data;
+
+    // Per output column: byte offsets of the two source pixels and the
+    // weight of the right one. Cached for the last geometry.
+    int tableCols = -1;
+    int tableWidth = -1;
+    float tableScale = 0.0f;
+    std::vector<int> left;
+    std::vector<int> right;
+    std::vector<float> weight;
+    // The last two resampled source rows.
+    std::vector<float> rowCache[2];
+    int cachedRow[2] = {-1, -1};
+
+    double lastCost = 0.0;
+};
+
+} // namespace UsArMirror
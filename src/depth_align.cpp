@@ -0,0 +1,220 @@
+#include "depth_align.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace UsArMirror {
+
+namespace {
+
+using namespace simd;
+
+inline float lane(float v, int) { return v; }
+inline float lane(f32x4 v, int i) { return v[i]; }
+
+template<typename V> constexpr int laneCount = 1;
+template<> constexpr int laneCount<f32x4> = lanes;
+
+template<typename V> V loadDepth(const uint16_t* row, int x);
+template<> float loadDepth<float>(const uint16_t* row, int x) { return row[x]; }
+template<> f32x4 loadDepth<f32x4>(const uint16_t* row, int x) { return loadU16(row + x); }
+
+bool hasDistortion(const StreamIntrinsics& intr) {
+    return std::any_of(intr.dist.begin(), intr.dist.end(), [](float k) { return k != 0.0f; });
+}
+
+/// Depth-camera point -> color pixel.
+struct ColorProjection {
+    float r[9];
+    float t[3];
+    StreamIntrinsics intr;
+    bool distorted;
+
+    template<typename V>
+    void operator()(V x, V y, V z, V& u, V& v) const {
+        V cx = r[0] * x + r[1] * y + r[2] * z + t[0];
+        V cy = r[3] * x + r[4] * y + r[5] * z + t[1];
+        V cz = r[6] * x + r[7] * y + r[8] * z + t[2];
+        V inv = 1.0f / cz;
+        V nx = cx * inv, ny = cy * inv;
+        if (distorted) {
+            const std::array<float, 5>& k = intr.dist;
+            V r2 = nx * nx + ny * ny;
+            V f = 1.0f + r2 * (k[0] + r2 * (k[1] + r2 * k[4]));
+            V xy = nx * ny;
+            V dx = nx * f + 2.0f * k[2] * xy + k[3] * (r2 + 2.0f * nx * nx);
+            V dy = ny * f + k[2] * (r2 + 2.0f * ny * ny) + 2.0f * k[3] * xy;
+            nx = dx;
+            ny = dy;
+        }
+        u = nx * intr.fx + intr.cx;
+        v = ny * intr.fy + intr.cy;
+    }
+};
+
+struct RowKernel {
+    const ColorProjection& project;
+    /// Half a depth pixel in normalised coordinates.
+    float halfX, halfY;
+    float depthScale;
+    cv::Mat& aligned;
+    /// ROI bounds; right and bottom are just below the first pixel past it.
+    float roiLeft, roiRight, roiTop, roiBottom;
+
+    /// Splat depth pixels x..x+lanes-1 of one row.
+    template<typename V>
+    void operator()(const uint16_t* depthRow, const float* rayX, const float* rayY, int x) const {
+        V raw = loadDepth<V>(depthRow, x);
+        V z = raw * depthScale;
+        V rx = loadAt<V>(rayX, x), ry = loadAt<V>(rayY, x);
+        // Opposite corners of the pixel footprint.
+        V uA, vA, uB, vB;
+        project((rx - halfX) * z, (ry - halfY) * z, z, uA, vA);
+        project((rx + halfX) * z, (ry + halfY) * z, z, uB, vB);
+
+        // Footprint in color pixels, rounded and clipped to the ROI. Lanes
+        // with no depth, no overlap or NaN corners end up with begin > end.
+        V left = minimum(uA, uB) + 0.5f, right = maximum(uA, uB) + 0.5f;
+        V top = minimum(vA, vB) + 0.5f, bottom = maximum(vA, vB) + 0.5f;
+        V zero = splat<V>(0.0f), empty = splat<V>(-1.0f);
+        left = select(raw > zero, maximum(left, splat<V>(roiLeft)), splat<V>(roiRight + 1.0f));
+        right = select(right >= splat<V>(roiLeft), minimum(right, splat<V>(roiRight)), empty);
+        top = maximum(top, splat<V>(roiTop));
+        bottom = select(bottom >= splat<V>(roiTop), minimum(bottom, splat<V>(roiBottom)), empty);
+
+        for (int i = 0; i < laneCount<V>; ++i) {
+            // Everything is >= 0 here, so truncation is floor.
+            int xBegin = static_cast<int>(lane(left, i)), xEnd = static_cast<int>(lane(right, i));
+            int yBegin = static_cast<int>(lane(top, i)), yEnd = static_cast<int>(lane(bottom, i));
+            if (!(lane(left, i) <= lane(right, i) && lane(top, i) <= lane(bottom, i))) continue;
+            auto value = static_cast<uint16_t>(lane(raw, i));
+            for (int cy = yBegin; cy <= yEnd; ++cy) {
+                uint16_t* out = aligned.ptr<uint16_t>(cy);
+                for (int cx = xBegin; cx <= xEnd; ++cx) {
+                    // 0 (no data yet) wraps to the largest value.
+                    out[cx] = static_cast<uint16_t>(out[cx] - 1) < value ? out[cx] : value;
+                }
+            }
+        }
+    }
+
+    template<typename V> static V loadAt(const float* row, int x);
+};
+
+template<> float RowKernel::loadAt<float>(const float* row, int x) { return row[x]; }
+template<> f32x4 RowKernel::loadAt<f32x4>(const float* row, int x) { return load(row + x); }
+
+} // namespace
+
+DepthAligner::DepthAligner(const RgbdStreamInfo& streams) : streams(streams) {
+    const StreamIntrinsics& d = streams.depth;
+    const StreamIntrinsics& c = streams.color;
+    if (d.width <= 0 || d.height <= 0 || d.fx <= 0.0f || d.fy <= 0.0f) {
+        throw std::runtime_error("DepthAligner needs valid depth intrinsics");
+    }
+
+    const std::array<float, 9> identity = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+    registered = d.width == c.width && d.height == c.height && d.fx == c.fx && d.fy == c.fy && d.cx == c.cx &&
+                 d.cy == c.cy && d.dist == c.dist && streams.depthToColorRotation == identity &&
+                 streams.depthToColorTranslation == std::array<float, 3>{};
+    colorDistorted = hasDistortion(c);
+
+    rays = RayTable::get(d);
+}
+
+cv::Rect DepthAligner::depthSearchArea(const cv::Rect& colorRoi) const {
+    const StreamIntrinsics& c = streams.color;
+    const StreamIntrinsics& d = streams.depth;
+    const std::array<float, 9>& r = streams.depthToColorRotation;
+    const std::array<float, 3>& t = streams.depthToColorTranslation;
+
+    // A color pixel sees depth pixels along its epipolar line; the ends at
+    // minDepth and maxDepth bound it.
+    float minX = std::numeric_limits<float>::max(), minY = minX;
+    float maxX = std::numeric_limits<float>::lowest(), maxY = maxX;
+    const float us[2] = {static_cast<float>(colorRoi.x), static_cast<float>(colorRoi.x + colorRoi.width)};
+    const float vs[2] = {static_cast<float>(colorRoi.y), static_cast<float>(colorRoi.y + colorRoi.height)};
+    for (float z : {minDepth, maxDepth}) {
+        for (float u : us) {
+            for (float v : vs) {
+                float px = (u - c.cx) / c.fx * z - t[0];
+                float py = (v - c.cy) / c.fy * z - t[1];
+                float pz = z - t[2];
+                // Inverse rotation = transpose.
+                float dx = r[0] * px + r[3] * py + r[6] * pz;
+                float dy = r[1] * px + r[4] * py + r[7] * pz;
+                float dz = r[2] * px + r[5] * py + r[8] * pz;
+                if (dz <= 0.0f) return cv::Rect(0, 0, d.width, d.height);
+                float x = d.fx * dx / dz + d.cx, y = d.fy * dy / dz + d.cy;
+                minX = std::min(minX, x);
+                maxX = std::max(maxX, x);
+                minY = std::min(minY, y);
+                maxY = std::max(maxY, y);
+            }
+        }
+    }
+    // Pixel footprints and rounding, plus slack for lens distortion, which
+    // the bound above ignores.
+    int margin = 2 + (colorDistorted || hasDistortion(d) ? 16 : 0);
+    cv::Rect area(cv::Point(static_cast<int>(std::floor(minX)) - margin, static_cast<int>(std::floor(minY)) - margin),
+                  cv::Point(static_cast<int>(std::ceil(maxX)) + margin + 1,
+                            static_cast<int>(std::ceil(maxY)) + margin + 1));
+    return area & cv::Rect(0, 0, d.width, d.height);
+}
+
+void DepthAligner::align(const cv::Mat& depth, cv::Mat& aligned) {
+    align(depth, aligned, cv::Rect(0, 0, streams.color.width, streams.color.height));
+}
+
+void DepthAligner::align(const cv::Mat& depth, cv::Mat& aligned, cv::Rect colorRoi) {
+    const StreamIntrinsics& d = streams.depth;
+    const StreamIntrinsics& c = streams.color;
+    if (depth.type() != CV_16UC1 || depth.cols != d.width || depth.rows != d.height) {
+        throw std::runtime_error("DepthAligner: depth does not match the depth stream intrinsics");
+    }
+    if (aligned.rows != c.height || aligned.cols != c.width || aligned.type() != CV_16UC1) {
+        aligned.create(c.height, c.width, CV_16UC1);
+        aligned.setTo(0);
+    }
+    colorRoi &= cv::Rect(0, 0, c.width, c.height);
+    if (colorRoi.empty()) return;
+
+    if (registered) {
+        depth(colorRoi).copyTo(aligned(colorRoi));
+        return;
+    }
+    aligned(colorRoi).setTo(0);
+
+    bool fullFrame = colorRoi == cv::Rect(0, 0, c.width, c.height);
+    cv::Rect area = fullFrame ? cv::Rect(0, 0, d.width, d.height) : depthSearchArea(colorRoi);
+
+    ColorProjection project{};
+    std::copy(streams.depthToColorRotation.begin(), streams.depthToColorRotation.end(), project.r);
+    std::copy(streams.depthToColorTranslation.begin(), streams.depthToColorTranslation.end(), project.t);
+    project.intr = c;
+    project.distorted = colorDistorted;
+    const float below = 1.0f - 1.0f / 1024;
+    RowKernel kernel{project,
+                     0.5f / d.fx,
+                     0.5f / d.fy,
+                     streams.depthScale,
+                     aligned,
+                     static_cast<float>(colorRoi.x),
+                     static_cast<float>(colorRoi.x + colorRoi.width - 1) + below,
+                     static_cast<float>(colorRoi.y),
+                     static_cast<float>(colorRoi.y + colorRoi.height - 1) + below};
+
+    for (int y = area.y; y < area.y + area.height; ++y) {
+        const uint16_t* row = depth.ptr<uint16_t>(y);
+        const float* rx = rays->rowX(y);
+        const float* ry = rays->rowY(y);
+        int x = area.x;
+        for (; x + lanes <= area.x + area.width; x += lanes) kernel.operator()<f32x4>(row, rx, ry, x);
+        for (; x < area.x + area.width; ++x) kernel.operator()<float>(row, rx, ry, x);
+    }
+}
+
+} // namespace UsArMirror
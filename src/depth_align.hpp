@@ -0,0 +1,50 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <memory>
+
+#include "frame_source.hpp"
+#include "ray_table.hpp"
+
+namespace UsArMirror {
+
+/// Maps Z16 depth into the color camera's pixel grid.
+///
+/// Rays through every depth pixel are computed once from the depth
+/// intrinsics. Per frame, each depth pixel is scaled along its ray, moved
+/// into the color camera with the depth-to-color extrinsics and projected
+/// with the color intrinsics. The pixel's whole footprint is splatted into
+/// a z-buffer, so the nearest surface wins and upsampling to a larger color
+/// stream leaves no pinholes. Aligned pixels keep the input depth units.
+class DepthAligner {
+public:
+    explicit DepthAligner(const RgbdStreamInfo& streams);
+
+    /// Depth already is in color pixel coordinates; align() is a copy.
+    bool isRegistered() const { return registered; }
+
+    /// Align the whole frame. `aligned` is (re)allocated as CV_16UC1 at
+    /// the color resolution.
+    void align(const cv::Mat& depth, cv::Mat& aligned);
+    /// Align only the color pixels inside `colorRoi`, visiting only the
+    /// depth pixels that can land there. Pixels of `aligned` outside the
+    /// ROI are left as they were.
+    void align(const cv::Mat& depth, cv::Mat& aligned, cv::Rect colorRoi);
+
+    /// Depth range in meters assumed when bounding the depth pixels that
+    /// can reach an ROI. Surfaces outside it may be missing from ROI output.
+    float minDepth = 0.15f;
+    float maxDepth = 10.0f;
+
+private:
+    /// Depth pixels whose footprint may reach `colorRoi`.
+    cv::Rect depthSearchArea(const cv::Rect& colorRoi) const;
+
+    RgbdStreamInfo streams;
+    bool registered = false;
+    bool colorDistorted = false;
+    std::shared_ptr<const RayTable> rays;
+};
+
+} // namespace UsArMirror
@@ -6,9 +6,13 @@
 #include <opencv2/dnn.hpp>
 #include <opencv2/face.hpp>
 #include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cmath>
 #include <thread>
 #include <mutex>
+#include <utility>
 
+#include "derived_images.hpp"
 #include "AprilTags/TagDetector.h"
 #include "AprilTags/Tag25h9.h"
 
@@ -31,157 +35,318 @@ inline double standardRad(double t) {
         pitch = standardRad(atan2(-wRo(2,0), wRo(0,0)*c + wRo(1,0)*s));
         roll  = standardRad(atan2(wRo(0,2)*s - wRo(1,2)*c, -wRo(0,1)*s + wRo(1,1)*c));
     }
-    
 
-DepthCameraInput::DepthCameraInput(const std::shared_ptr<State>& state, int idx)
-    : state(state), running(true), textureId(-1), depth_frame(rs2::frame()) {
-    try {
-        impl = std::make_unique<DepthCameraInputImpl>();
-        rs2::config cfg;
-        cfg.enable_stream(RS2_STREAM_COLOR, state->viewportWidth, state->viewportHeight, RS2_FORMAT_BGR8, 30);
-        cfg.enable_stream(RS2_STREAM_DEPTH, state->viewportWidth, state->viewportHeight, RS2_FORMAT_Z16, 30);
-        spdlog::info("Trying to start RealSense pipeline...");
-        impl->pipe.start(cfg);
+namespace {
+FrameSourceOptions realSenseOptions(const State& state) {
+    FrameSourceOptions options;
+    options.width = state.viewportWidth;
+    options.height = state.viewportHeight;
+    return options;
+}
 
-        width = state->viewportWidth;
-        height = state->viewportHeight;
+/// Pool size for frames this input copies out of the source: sized like a
+/// source pool, with the history as the retained frames.
+size_t inputPoolBlocks(bool keepHistory, size_t streams) {
+    FrameSourceOptions options;
+    options.retainedFrames = keepHistory ? DepthCameraInput::History::capacity() : 0;
+    return poolBlockCount(options, 1, streams);
+}
+} // namespace
 
-        spdlog::info("RealSense camera started: width={}, height={}", width, height);
+DepthCameraInput::DepthCameraInput(const std::shared_ptr<State>& state, int)
+    : DepthCameraInput(state, openFrameSource("realsense", realSenseOptions(*state))) {}
 
-        faceNet = cv::dnn::readNetFromCaffe(
-            "deploy.prototxt",
-            "res10_300x300_ssd_iter_140000.caffemodel");
+DepthCameraInput::DepthCameraInput(const std::shared_ptr<State>& state, std::unique_ptr<FrameSource> source)
+    : state(state), source(std::move(source)), running(true) {
+    const SourceCapabilities& caps = this->source->capabilities();
+    streamInfo = caps.streams;
+    width = streamInfo.color.width;
+    height = streamInfo.color.height;
+    spdlog::info("Depth camera input on {}: width={}, height={}", this->source->name(), width, height);
+    if (caps.hasDepth) depthAligner = std::make_unique<DepthAligner>(streamInfo);
+    if (caps.hasDepth) depthFaceProposer = std::make_unique<DepthFaceProposer>(streamInfo);
+    if (streamInfo.color.fx > 0.0f) colorRays = RayTable::get(streamInfo.color);
 
+    loadModels();
+
+    captureThread = std::thread(&DepthCameraInput::captureLoop, this);
+    detectionThread = std::thread(&DepthCameraInput::detectionLoop, this);
+    if (!caps.hasPose) extrinsicsThread = std::thread(&DepthCameraInput::extrinsicsLoop, this);
+}
+
+void DepthCameraInput::loadModels() {
+    faceInference = FaceInference::shared();
+    facePrefilter.load();
+
+    try {
+        landmarkRegressor = std::make_unique<LandmarkRegressor>("lbfmodel.yaml");
+        spdlog::info("Loaded LBF landmark model, {} stages", landmarkRegressor->stageCount());
+    } catch (const std::exception& e) {
+        spdlog::warn("{}; falling back to OpenCV FacemarkLBF", e.what());
         facemark = cv::face::FacemarkLBF::create();
         facemark->loadModel("lbfmodel.yaml");
         spdlog::info("Loaded OpenCV FacemarkLBF model");
-
-        tagDetector = new AprilTags::TagDetector(AprilTags::tagCodes25h9);
-
-    } catch (const rs2::error& e) {
-        throw std::runtime_error(std::string("RealSense error: ") + e.what());
     }
 
-    createGlTexture();
-    captureThread = std::thread(&DepthCameraInput::captureLoop, this);
-    detectionThread = std::thread(&DepthCameraInput::detectionLoop, this);
+    tagTracker = std::make_unique<TagTracker>(AprilTags::tagCodes25h9);
 }
 
 DepthCameraInput::~DepthCameraInput() {
-    running = false;
+    {
+        std::lock_guard lock(extrinsicsWakeMutex);
+        running = false;
+    }
+    extrinsicsWake.notify_all();
 
     if (captureThread.joinable()) captureThread.join();
     if (detectionThread.joinable()) detectionThread.join();
-
-    if (impl) {
-        impl->pipe.stop();
-    }
+    if (extrinsicsThread.joinable()) extrinsicsThread.join();
 }
 
-void DepthCameraInput::createGlTexture() {
-    glGenTextures(1, &textureId);
-    glBindTexture(GL_TEXTURE_2D, textureId);
+void DepthCameraInput::captureLoop() {
+    const bool lockstep = source->pace() == SourcePace::Lockstep;
+
+    while (running && !source->finished()) {
+        // Blocks until the source has the next frame; the timeout only
+        // bounds how long shutdown can take.
+        DepthCameraFrame captured;
+        if (!source->read(captured, std::chrono::milliseconds(captureTimeoutMs))) continue;
+        if (captured.color.empty()) continue;
+
+        if (!retainSensorFrames && captured.color.isSensorBacked()) {
+            if (!framePool) {
+                framePool = std::make_unique<FramePool>(captured.color.sizeBytes(), inputPoolBlocks(keepHistory, 2));
+            }
+            captured.color = captured.color.detach(*framePool);
+            captured.depth = captured.depth.detach(*framePool);
+        }
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        if (!captured.pose.empty()) {
+            std::lock_guard lock(extrinsicsMutex);
+            extrinsicsMatrix = captured.pose;
+            extrinsicsVersion.fetch_add(1, std::memory_order_release);
+        }
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, nullptr);
-}
+        {
+            std::lock_guard lock(recorderMutex);
+            if (recorder) recorder->append(captured, getExtrinsics());
+        }
 
-void DepthCameraInput::captureLoop() {
-    while (running) {
-        if (!impl) continue;
+        if (!filterDepth) {
+            depthFilter.reset();
+        } else if (!captured.depth.empty()) {
+            filterCapturedDepth(captured.depth);
+        }
 
-        if (impl->pipe.poll_for_frames(&impl->frames)) {
-            rs2::video_frame color = impl->frames.get_color_frame();
-            rs2::depth_frame depth = impl->frames.get_depth_frame();
+        // Nothing is computed here; consumers fill the cache on demand.
+        if (captured.color.mat().type() == CV_8UC3) {
+            captured.derived = std::make_shared<DerivedImages>(captured.color);
+        }
 
-            if (color) {
-                const uint8_t* data = reinterpret_cast<const uint8_t*>(color.get_data());
-                cv::Mat raw(color.get_height(), color.get_width(), CV_8UC3, (void*)data, cv::Mat::AUTO_STEP);
-                std::lock_guard lock(frameMutex);
-                frame = raw.clone();
-            }
+        // Handles are shared, so the history entry costs no pixel copy.
+        const bool keep = keepHistory;
+        DepthCameraFrame entry = keep ? captured : DepthCameraFrame();
+        if (frames.publish([&](DepthCameraFrame& slot) {
+                slot = std::move(captured);
+                return true;
+            })) {
+            if (keep) history.push(frames.sequence(), entry.color.timestamp(), std::move(entry));
+        }
 
-            if (depth) {
-                std::lock_guard lock(frameMutex);
-                depth_frame = depth;
+        if (lockstep) {
+            uint64_t published = frames.sequence();
+            while (running && processedSequence.load() < published) {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
             }
         }
+    }
+    if (source->finished()) spdlog::info("Frame source {} finished", source->name());
+}
+
+void DepthCameraInput::filterCapturedDepth(FrameHandle& depth) {
+    const cv::Mat& raw = depth.mat();
+    if (!depthPool) {
+        depthPool = std::make_unique<FramePool>(raw.total() * raw.elemSize(), inputPoolBlocks(keepHistory, 1));
+    }
+    FrameHandle filtered = depthPool->allocate(raw.rows, raw.cols, raw.type());
+    depthFilter.process(raw, filtered.mat());
+    filtered.setTiming(depth.timestamp(), depth.frameNumber(), depth.arrivalTime());
+    depth = std::move(filtered);
+
+    if (depthFilter.lastCostMs() > 2.0) {
+        spdlog::debug("Depth filter took {:.2f} ms", depthFilter.lastCostMs());
+    }
+}
+
+void DepthCameraInput::startRecording(const std::string& path) {
+    auto writer = std::make_unique<RecordingWriter>(path, streamInfo);
+    std::lock_guard lock(recorderMutex);
+    recorder = std::move(writer);
+}
+
+void DepthCameraInput::stopRecording() {
+    std::unique_ptr<RecordingWriter> finished;
+    {
+        std::lock_guard lock(recorderMutex);
+        finished = std::move(recorder);
+    }
+}
+
+bool DepthCameraInput::detectFaces(const DerivedImages& derived, const cv::Mat& depth,
+                                   const std::vector<cv::Rect>& previous, std::vector<cv::Rect>& faces) {
+    faces.clear();
+    const cv::Mat& bgr = derived.bgr();
+    std::vector<cv::Rect> regions;
+    FacePrefilter::Search search = FacePrefilter::Search::FullFrame;
+    bool depthProposed = false;
+    if (faceDepthProposals && depthFaceProposer) {
+        // Only people in the band: posters and passers-by behind them
+        // never reach the SSD.
+        depthFaceProposer->options.minDepth = faceMinDepth;
+        depthFaceProposer->options.maxDepth = faceMaxDepth;
+        depthProposed = depthFaceProposer->propose(depth, regions);
+        if (depthProposed) {
+            mergeOverlapping(regions);
+            search = regions.empty() ? FacePrefilter::Search::None : FacePrefilter::Search::Regions;
+        }
+    }
+    if (!depthProposed && faceCascadePrefilter) {
+        facePrefilter.setFullFrameInterval(faceFullFrameInterval);
+        search = facePrefilter.propose(derived, previous, regions);
+    }
+    if (search == FacePrefilter::Search::None) return false;
+    if (search == FacePrefilter::Search::FullFrame) regions.assign(1, cv::Rect(0, 0, bgr.cols, bgr.rows));
+
+    // The detector letterboxes each image to its input, keeping the face's
+    // aspect ratio. Crop from the smallest pyramid level that is still
+    // larger than that, so the resize has little work left. All regions
+    // go in together and share one forward() call.
+    cv::Size input = faceInference->getInputSize();
+    std::vector<std::future<std::vector<FaceInference::Detection>>> pending;
+    std::vector<float> levels;
+    std::vector<cv::Rect> crops;
+    for (const cv::Rect& region : regions) {
+        float scale = std::min(static_cast<float>(input.width) / region.width,
+                               static_cast<float>(input.height) / region.height);
+        const cv::Mat* source = &bgr;
+        int level = 1;
+        if (scale <= 0.25f) {
+            source = &derived.quarter();
+            level = 4;
+        } else if (scale <= 0.5f) {
+            source = &derived.half();
+            level = 2;
+        }
+        cv::Rect crop = cv::Rect(region.x / level, region.y / level, region.width / level, region.height / level) &
+                        cv::Rect(0, 0, source->cols, source->rows);
+        if (crop.empty()) continue;
+        pending.push_back(faceInference->submit((*source)(crop), 0.9f));
+        levels.push_back(static_cast<float>(level));
+        crops.push_back(crop);
+    }
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    for (size_t i = 0; i < pending.size(); ++i) {
+        cv::Point2f origin(static_cast<float>(crops[i].x), static_cast<float>(crops[i].y));
+        for (const FaceInference::Detection& detection : pending[i].get()) {
+            cv::Point2f p1 = (detection.topLeft + origin) * levels[i];
+            cv::Point2f p2 = (detection.bottomRight + origin) * levels[i];
+            faces.emplace_back(cv::Point(static_cast<int>(p1.x), static_cast<int>(p1.y)),
+                               cv::Point(static_cast<int>(p2.x), static_cast<int>(p2.y)));
+        }
     }
+    return true;
 }
 
 void DepthCameraInput::detectionLoop() {
+    uint64_t lastSequence = 0;
+    uint64_t nextFaceReport = 300;
+    cv::Mat alignedDepth;
+    std::vector<cv::Rect> lastFaces;
     while (running) {
-        cv::Mat currentFrame, depthMat;
+        processedSequence = lastSequence;
+        FrameRef handle = frames.waitNewer(lastSequence, std::chrono::milliseconds(captureTimeoutMs));
+        if (!handle) continue;
+        lastSequence = handle.sequence();
+        if (!handle->derived) continue;
+        // Without depth, faces are still tracked but not lifted to 3D.
+        const DerivedImages& derived = *handle->derived;
+        const cv::Mat& rawDepth = handle->depth.mat();
+
+        // Nothing moved since the last run: the published faces and
+        // landmarks still hold.
+        faceMotionGate.setThreshold(faceMotionThreshold);
+        faceMotionGate.setMaxStaleFrames(faceMaxStaleFrames);
+        bool moved = faceMotionGate.check(derived, lastFaces);
         {
-            std::lock_guard lock(frameMutex);
-            if (frame.empty() || !depth_frame) continue;
-            currentFrame = frame.clone();
-            depthMat = cv::Mat(depth_frame.get_height(), depth_frame.get_width(), CV_16UC1,
-                               (void*)depth_frame.get_data(), cv::Mat::AUTO_STEP).clone();
+            std::lock_guard lock(faceMutex);
+            faceMotionMetrics = faceMotionGate.metrics();
         }
+        if (!moved) continue;
 
-        cv::Mat blob = cv::dnn::blobFromImage(currentFrame, 1.0, cv::Size(300, 300), cv::Scalar(104.0, 177.0, 123.0), false, false);
-        faceNet.setInput(blob);
-        cv::Mat detections = faceNet.forward();
-
+        // Between detector runs, move the last boxes with the tracker.
+        faceTracker.setDetectInterval(faceDetectInterval);
+        faceTracker.setMinConfidence(faceTrackConfidence);
         std::vector<cv::Rect> faces;
-        cv::Mat detectionMat(detections.size[2], detections.size[3], CV_32F, detections.ptr<float>());
-
-        for (int i = 0; i < detectionMat.rows; ++i) {
-            float confidence = detectionMat.at<float>(i, 2);
-            if (confidence > 0.9f) {
-                int x1 = static_cast<int>(detectionMat.at<float>(i, 3) * currentFrame.cols);
-                int y1 = static_cast<int>(detectionMat.at<float>(i, 4) * currentFrame.rows);
-                int x2 = static_cast<int>(detectionMat.at<float>(i, 5) * currentFrame.cols);
-                int y2 = static_cast<int>(detectionMat.at<float>(i, 6) * currentFrame.rows);
-                faces.emplace_back(cv::Rect(cv::Point(x1, y1), cv::Point(x2, y2)));
+        if (faceTracker.needsDetection() || !faceTracker.track(derived, faces)) {
+            auto detectStart = std::chrono::steady_clock::now();
+            bool detected = detectFaces(derived, rawDepth, lastFaces, faces);
+            double detectMs =
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - detectStart).count();
+            faceTracker.setDetections(derived, faces, detected ? std::optional<double>(detectMs) : std::nullopt);
+        }
+        lastFaces = faces;
+        if (faceTracker.detections() + faceTracker.trackedFrames() >= nextFaceReport) {
+            nextFaceReport += 300;
+            spdlog::info("Face detector ran on {} of {} frames ({:.1f} ms each); tracking saved {:.0f} ms",
+                         faceTracker.detections(), faceTracker.detections() + faceTracker.trackedFrames(),
+                         faceTracker.averageDetectMs(), faceTracker.savedMs());
+            FaceInference::Metrics metrics = faceInference->metrics();
+            spdlog::info("Face inference: {} batches, {:.2f} images each, {:.1f} ms per batch, {} queued",
+                         metrics.batches, metrics.averageBatchSize, metrics.averageBatchMs, metrics.queueDepth);
+            if (faceCascadePrefilter && facePrefilter.loaded()) {
+                spdlog::info("Face cascade: SSD skipped on {} and narrowed to crops on {} of {} searches",
+                             facePrefilter.skipped(), facePrefilter.narrowed(), facePrefilter.calls());
+            }
+            MotionGate::Metrics motion = faceMotionGate.metrics();
+            spdlog::info("Face motion gate: skipped {} of {} frames ({:.0f}%), last score {:.1f}", motion.skipped,
+                         motion.frames, 100.0 * motion.skipRate, motion.score);
+            if (landmarkRegressor) {
+                spdlog::info("Landmarks: {} warm starts, {} cold, {:.2f} ms last fit", landmarkRegressor->warmStarts(),
+                             landmarkRegressor->coldStarts(), landmarkRegressor->lastCostMs());
             }
         }
 
         std::vector<std::vector<cv::Point2f>> landmarks;
-        if (facemark->fit(currentFrame, faces, landmarks) && !landmarks.empty()) {
+        // Both work on gray; hand them the shared one.
+        bool fitted = landmarkRegressor ? landmarkRegressor->fit(derived.gray(), faces, landmarks)
+                                        : facemark->fit(derived.gray(), faces, landmarks);
+        if (fitted && !landmarks.empty()) {
             std::vector<cv::Point3f> points3D;
-            auto intr = impl->pipe.get_active_profile()
-                            .get_stream(RS2_STREAM_COLOR)
-                            .as<rs2::video_stream_profile>()
-                            .get_intrinsics();
-
-            for (const auto& pt : landmarks[0]) {
-                int x = static_cast<int>(pt.x);
-                int y = static_cast<int>(pt.y);
-                if (x < 0 || x >= depthMat.cols || y < 0 || y >= depthMat.rows) continue;
-
-                uint16_t d = depthMat.at<uint16_t>(y, x);
-                if (d == 0) continue;
-
-                float depth_m = d * 0.001f;
-                float px = (x - intr.ppx) / intr.fx;
-                float py = (y - intr.ppy) / intr.fy;
-
-                cv::Point3f cameraPoint(px * depth_m, py * depth_m, depth_m);
-                auto extrinsic = getExtrinsics(); 
-
-                if (extrinsic.type() != CV_32F && extrinsic.type() != CV_64F) {
-                    extrinsic.convertTo(extrinsic, CV_32F);  // Safely convert to float
-                }
-
-                auto extrinsic_inv = extrinsic.inv();
-                // Transform into world coordinates
-                cv::Mat p_c_h = (cv::Mat_<float>(4,1) << cameraPoint.x, cameraPoint.y, cameraPoint.z, 1.0f);
-                cv::Mat p_w_h = extrinsic_inv * p_c_h;  // <- extrinsic_inv is your inverted extrinsicsMatrix
-                cv::Point3f worldPoint(
-                    p_w_h.at<float>(0,0),
-                    p_w_h.at<float>(1,0),
-                    p_w_h.at<float>(2,0)
-                );
-                std::cout << "Landmark 3D: " << px * depth_m << ", " << py * depth_m << ", " << depth_m << std::endl;
-                points3D.emplace_back(cv::Point3f(px * depth_m, py * depth_m, depth_m));
+
+            // Landmarks are color pixels; map depth into the color camera,
+            // but only around the face.
+            cv::Mat depthMat = rawDepth;
+            if (depthAligner && !depthAligner->isRegistered() && rawDepth.cols == streamInfo.depth.width &&
+                rawDepth.rows == streamInfo.depth.height) {
+                cv::Rect roi = cv::boundingRect(landmarks[0]);
+                roi = cv::Rect(roi.x - 2, roi.y - 2, roi.width + 4, roi.height + 4);
+                depthAligner->align(rawDepth, alignedDepth, roi);
+                depthMat = alignedDepth;
+            }
+
+            // One table fetch per landmark instead of per-point unprojection.
+            std::vector<cv::Point3f> cameraPoints;
+            if (colorRays && !depthMat.empty()) {
+                cameraPoints.resize(landmarks[0].size());
+                colorRays->backProject(landmarks[0].data(), landmarks[0].size(), depthMat, streamInfo.depthScale,
+                                       cameraPoints.data());
+            }
+
+            // Camera coordinates; getExtrinsics() maps them to the world.
+            for (const cv::Point3f& cameraPoint : cameraPoints) {
+                if (std::isnan(cameraPoint.z)) continue;
+                spdlog::trace("Landmark 3D: {}, {}, {}", cameraPoint.x, cameraPoint.y, cameraPoint.z);
+                points3D.push_back(cameraPoint);
             }
 
             {
@@ -197,12 +362,26 @@ void DepthCameraInput::detectionLoop() {
 }
 
 
-bool DepthCameraInput::getFrame(cv::Mat& outputFrame) {
-    std::lock_guard lock(frameMutex);
-    if (!frame.empty()) {
-        outputFrame = frame.clone();
+MotionGate::Metrics DepthCameraInput::getFaceMotionMetrics() const {
+    std::lock_guard lock(faceMutex);
+    return faceMotionMetrics;
+}
+
+DepthCameraInput::FrameRef DepthCameraInput::acquireFrame() const {
+    FrameRef handle = frames.acquire();
+    if (handle && handle->color.empty()) handle.release();
+    return handle;
+}
+
+DepthCameraInput::FrameRef DepthCameraInput::waitForFrame(uint64_t after, std::chrono::milliseconds timeout) const {
+    FrameRef handle = frames.waitNewer(after, timeout);
+    if (handle && handle->color.empty()) handle.release();
+    return handle;
+}
 
-        updateExtrinsicsFromAprilTag();
+bool DepthCameraInput::getFrame(cv::Mat& outputFrame) {
+    if (FrameRef handle = acquireFrame()) {
+        handle->color.mat().copyTo(outputFrame);
 
         std::lock_guard faceLock(faceMutex);
         for (size_t i = 0; i < faceBoxes.size(); ++i) {
@@ -223,29 +402,20 @@ bool DepthCameraInput::getFrame(cv::Mat& outputFrame) {
     return false;
 }
 
-rs2::depth_frame DepthCameraInput::getDepth() {
-    std::lock_guard lock(frameMutex);
-    return depth_frame;
+FrameHandle DepthCameraInput::getLastColorFrame() const {
+    FrameRef handle = acquireFrame();
+    return handle ? handle->color : FrameHandle();
 }
 
-cv::Mat DepthCameraInput::getLastColorFrame() const {
-    return frame.empty() ? cv::Mat() : frame.clone();
+FrameHandle DepthCameraInput::getLastDepthFrame() const {
+    FrameRef handle = acquireFrame();
+    return handle ? handle->depth : FrameHandle();
 }
 
 void DepthCameraInput::render() {
-    cv::Mat frame;
-    if (getFrame(frame)) {
-        glEnable(GL_TEXTURE_2D);
-        glBindTexture(GL_TEXTURE_2D, textureId);
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, frame.cols, frame.rows, GL_BGR, GL_UNSIGNED_BYTE, frame.data);
-
-        glColor3f(1.0f, 1.0f, 1.0f);
-        glBegin(GL_QUADS);
-        glTexCoord2f(0.0f, 1.0f); glVertex2f(1.0f, -1.0f);
-        glTexCoord2f(1.0f, 1.0f); glVertex2f(-1.0f, -1.0f);
-        glTexCoord2f(1.0f, 0.0f); glVertex2f(-1.0f, 1.0f);
-        glTexCoord2f(0.0f, 0.0f); glVertex2f(1.0f, 1.0f);
-        glEnd();
+    if (FrameRef handle = acquireFrame()) {
+        texture.upload(handle->color.mat());
+        texture.draw(1.0f, -1.0f);
     }
 }
 
@@ -254,42 +424,156 @@ std::vector<cv::Point3f> DepthCameraInput::getLandmarks3D() {
     return landmark3D;
 }
 
-void DepthCameraInput::updateExtrinsicsFromAprilTag() {
-    cv::Mat colorFrame = getLastColorFrame();
-    if (colorFrame.empty()) {
-        spdlog::warn("No color frame available for AprilTag detection.");
-        return;
+void DepthCameraInput::setExtrinsicsRate(float hz) {
+    extrinsicsRateHz = std::max(hz, 0.0f);
+    // Wake the worker so it picks up the new period now.
+    requestExtrinsicsUpdate();
+}
+
+void DepthCameraInput::requestExtrinsicsUpdate() {
+    {
+        std::lock_guard lock(extrinsicsWakeMutex);
+        extrinsicsRequested = true;
+    }
+    extrinsicsWake.notify_one();
+}
+
+void DepthCameraInput::unlockExtrinsics() {
+    {
+        std::lock_guard lock(extrinsicsWakeMutex);
+        extrinsicsUnlockRequested = true;
+        extrinsicsRequested = true;
+    }
+    extrinsicsWake.notify_one();
+}
+
+void DepthCameraInput::setTagBundle(std::shared_ptr<const TagBundle> bundle) {
+    {
+        std::lock_guard lock(tagBundleMutex);
+        tagBundle = std::move(bundle);
     }
+    requestExtrinsicsUpdate();
+}
+
+void DepthCameraInput::extrinsicsLoop() {
+    uint64_t lastSequence = 0;
+    auto nextRun = std::chrono::steady_clock::now();
+    while (running) {
+        bool requested = false;
+        bool unlock = false;
+        {
+            std::unique_lock lock(extrinsicsWakeMutex);
+            auto woken = [this] { return !running || extrinsicsRequested; };
+            if (extrinsicsRateHz > 0.0f) {
+                extrinsicsWake.wait_until(lock, nextRun, woken);
+            } else {
+                extrinsicsWake.wait(lock, woken);
+            }
+            requested = std::exchange(extrinsicsRequested, false);
+            unlock = std::exchange(extrinsicsUnlockRequested, false);
+        }
+        if (!running) break;
+        if (unlock || (!lockExtrinsics && extrinsicsLock.isLocked())) {
+            extrinsicsLock.reset();
+            extrinsicsLocked = false;
+        }
+        {
+            std::lock_guard lock(tagBundleMutex);
+            if (tagBundle != activeTagBundle) {
+                // A multi-tag pose is steady from the first frames, so a
+                // short window is enough to lock it.
+                ExtrinsicsLockOptions lockOptions;
+                if (tagBundle && tagBundle->getTags().size() > 1) lockOptions.window = 3;
+                extrinsicsLock = ExtrinsicsLock(lockOptions);
+                extrinsicsLocked = false;
+                activeTagBundle = tagBundle;
+            }
+        }
+
+        // Never estimate twice from the same frame.
+        FrameRef frame = waitForFrame(lastSequence, std::chrono::milliseconds(captureTimeoutMs));
+        if (!frame) {
+            // No new frame yet, e.g. at startup or while the source
+            // stalls: keep the request for the next one.
+            if (requested) {
+                std::lock_guard lock(extrinsicsWakeMutex);
+                extrinsicsRequested = true;
+            }
+            continue;
+        }
+        lastSequence = frame.sequence();
+
+        auto start = std::chrono::steady_clock::now();
+        // While locked, a cheap look at the tag region replaces detection.
+        if (extrinsicsLock.isLocked() && frame->derived) {
+            if (extrinsicsLock.checkMotion(*frame->derived, frame->depth.mat(), streamInfo.depthScale)) {
+                extrinsicsLocked = false;
+                spdlog::info("Tag region changed (gray {:.1f}, depth {:.3f} m); re-estimating extrinsics",
+                             extrinsicsLock.lastGrayChange(), extrinsicsLock.lastDepthChange());
+            }
+        }
+        if (!extrinsicsLock.isLocked()) updateExtrinsicsFromAprilTag(*frame);
+        frame.release();
 
-    // 1. Create AprilTags detector
-    // static AprilTags::TagDetector tagDetector(AprilTags::tagCodes25h9); // or 36h11 depending on your tags
+        float rate = extrinsicsRateHz;
+        if (rate > 0.0f) {
+            nextRun = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                  std::chrono::duration<double>(1.0 / rate));
+        }
+    }
+}
 
-    // 2. Convert to grayscale
-    cv::Mat gray;
-    cv::cvtColor(colorFrame, gray, cv::COLOR_BGR2GRAY);
+void DepthCameraInput::updateExtrinsicsFromAprilTag(const DepthCameraFrame& frame) {
+    if (!frame.derived) return;
 
-    // 3. Detect tags
-    double t0 = static_cast<double>(cv::getTickCount());
-    std::vector<AprilTags::TagDetection> detections = tagDetector->extractTags(gray);
-    double dt = (static_cast<double>(cv::getTickCount()) - t0) / cv::getTickFrequency();
-    spdlog::info("{} tags detected in {:.3f} seconds", detections.size(), dt);
+    // 1-3. Detect tags, near last frame's tags when possible
+    std::vector<AprilTags::TagDetection> detections = tagTracker->detect(*frame.derived);
+    spdlog::debug("{} tags detected in {:.3f} ms (pass {})", detections.size(), tagTracker->lastCostMs(),
+                  static_cast<int>(tagTracker->lastPass()));
 
     if (detections.empty()) {
-        spdlog::warn("No AprilTags detected.");
+        spdlog::debug("No AprilTags detected.");
         return;
     }
 
-    // 4. Only use the first detection for now
-    AprilTags::TagDetection& detection = detections[0];
+    // 4. Solve jointly over the bundle tags in view, or use the first tag
+    const std::shared_ptr<const TagBundle>& bundle = activeTagBundle;
 
     // 5. Recover relative pose
     Eigen::Vector3d translation;
     Eigen::Matrix3d rotation;
-    detection.getRelativeTranslationRotation(
-        tag_size_meters,   // tag size in meters (adjust to your actual tag size)
-        intrinsics.fx, intrinsics.fy,
-        intrinsics.cx, intrinsics.cy,
-        translation, rotation);
+    std::vector<cv::Point2f> corners;
+    int tagCount = 1;
+    if (bundle && !bundle->empty()) {
+        TagBundle::Pose pose;
+        if (!bundle->solve(detections, intrinsics.fx, intrinsics.fy, intrinsics.cx, intrinsics.cy, pose)) {
+            spdlog::debug("No usable bundle tags among {} detections.", detections.size());
+            return;
+        }
+        // Same axes as getRelativeTranslationRotation: the translation in
+        // x-forward, y-left, z-up, the rotation in camera axes.
+        Eigen::Matrix3d toObjectAxes;
+        toObjectAxes << 0, 0, 1,
+            -1, 0, 0,
+            0, -1, 0;
+        translation = toObjectAxes * pose.translation;
+        rotation = pose.rotation;
+        tagCount = pose.tags;
+        for (const auto& detection : detections) {
+            if (!bundle->find(detection.id)) continue;
+            for (const auto& corner : detection.p) corners.emplace_back(corner.first, corner.second);
+        }
+        spdlog::debug("Bundle pose from {} tags, {:.2f} px RMS", pose.tags, pose.rmsError);
+    } else {
+        const AprilTags::TagDetection& detection = detections[0];
+        detection.getRelativeTranslationRotation(
+            tag_size_meters,   // tag size in meters (adjust to your actual tag size)
+            intrinsics.fx, intrinsics.fy,
+            intrinsics.cx, intrinsics.cy,
+            translation, rotation);
+        for (const auto& corner : detection.p) corners.emplace_back(corner.first, corner.second);
+        spdlog::debug("AprilTag ID: {}", detection.id);
+    }
 
     // 6. Convert rotation matrix to OpenCV
     Eigen::Matrix3d F;
@@ -314,18 +598,28 @@ void DepthCameraInput::updateExtrinsicsFromAprilTag() {
     R_cv.convertTo(extrinsic(cv::Rect(0, 0, 3, 3)), CV_32F);
     tvec.convertTo(extrinsic(cv::Rect(3, 0, 1, 3)), CV_32F);
 
+    // Average with the recent poses and lock once they are steady
+    if (lockExtrinsics) {
+        extrinsic = extrinsicsLock.addPose(extrinsic, cv::boundingRect(corners), *frame.derived, frame.depth.mat());
+        if (extrinsicsLock.isLocked() && !extrinsicsLocked) {
+            extrinsicsLocked = true;
+            spdlog::info("Extrinsics locked from {} tag(s) (spread {:.1f} mm, {:.2f} deg); tag detection paused",
+                         tagCount, extrinsicsLock.translationSpread() * 1000.0, extrinsicsLock.rotationSpreadDeg());
+        }
+    }
+
     {
         std::lock_guard lock(extrinsicsMutex);
         extrinsicsMatrix = extrinsic;
     }
+    extrinsicsVersion.fetch_add(1, std::memory_order_release);
 
     // 8. Log results
-    spdlog::info("AprilTag ID: {}", detection.id);
-    spdlog::info("Translation (x, y, z) = ({:.3f}, {:.3f}, {:.3f}) meters",
+    spdlog::debug("Translation (x, y, z) = ({:.3f}, {:.3f}, {:.3f}) meters",
         fixed_trans(0), fixed_trans(1), fixed_trans(2));
     double yaw, pitch, roll;
     wRo_to_euler(fixed_rot, yaw, pitch, roll);
-    spdlog::info("Rotation (yaw, pitch, roll) = ({:.3f}, {:.3f}, {:.3f}) radians",
+    spdlog::debug("Rotation (yaw, pitch, roll) = ({:.3f}, {:.3f}, {:.3f}) radians",
                  yaw, pitch, roll);
 }
 
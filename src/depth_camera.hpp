@@ -5,6 +5,7 @@
 #include <memory>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 #include <optional>
 #include <librealsense2/rs.hpp>
 
@@ -13,6 +14,24 @@
 #include <opencv2/dnn.hpp>
 
 #include "common.hpp"
+#include "depth_align.hpp"
+#include "depth_face_proposer.hpp"
+#include "depth_filter.hpp"
+#include "extrinsics_lock.hpp"
+#include "face_inference.hpp"
+#include "face_prefilter.hpp"
+#include "face_tracker.hpp"
+#include "ray_table.hpp"
+#include "frame_handle.hpp"
+#include "frame_history.hpp"
+#include "frame_source.hpp"
+#include "frame_texture.hpp"
+#include "landmark_regressor.hpp"
+#include "motion_gate.hpp"
+#include "recording.hpp"
+#include "tag_bundle.hpp"
+#include "tag_tracker.hpp"
+#include "triple_buffer.hpp"
 
 #include <vector>
 #include <atomic>
@@ -31,25 +50,86 @@ namespace UsArMirror {
 //     int viewportHeight;
 // };
 
-struct DepthCameraInputImpl {
-    rs2::pipeline pipe;
-    rs2::colorizer color_map;
-    rs2::frameset frames;
-    rs2::frame color_frame;
-    rs2::frame depth_frame;
-};
-
 class DepthCameraInput {
 public:
+    // One spare buffer per concurrent reader (render, detection, extrinsics).
+    using FrameBuffer = TripleBuffer<DepthCameraFrame, 4>;
+    using FrameRef = FrameBuffer::ReadHandle;
+    /// Last few framesets by sequence number. Kept short: with sensor
+    /// frames retained, every entry holds a librealsense buffer.
+    using History = FrameHistory<DepthCameraFrame, 4>;
+
+    /// Open the RealSense camera at the viewport resolution.
     explicit DepthCameraInput(const std::shared_ptr<State>& state, int idx);
+    /// Run the pipeline on any source, e.g. a recording or an image
+    /// sequence. Needs no GL context until render() is called.
+    DepthCameraInput(const std::shared_ptr<State>& state, std::unique_ptr<FrameSource> source);
     ~DepthCameraInput();
 
     bool getFrame(cv::Mat& outputFrame);
+    /// Pin the latest frameset without copying it.
+    FrameRef acquireFrame() const;
+    /// Block until a frameset newer than sequence `after` arrives.
+    FrameRef waitForFrame(uint64_t after, std::chrono::milliseconds timeout) const;
     void render();
 
     int width, height;
-    cv::Mat getLastColorFrame() const;
-    rs2::depth_frame getDepth();
+    FrameHandle getLastColorFrame() const;
+    /// Latest Z16 depth frame, filtered if filterDepth is set; empty for
+    /// sources without depth.
+    FrameHandle getLastDepthFrame() const;
+
+    /// Publish librealsense buffers directly (default). When false, frames
+    /// are copied into a local pool so librealsense gets its buffers back
+    /// immediately, e.g. while a reader holds frames for a long time.
+    std::atomic<bool> retainSensorFrames = true;
+
+    /// Run captured depth through the spatial/temporal/hole-fill filter
+    /// before publishing it. Recordings always get the raw depth.
+    std::atomic<bool> filterDepth = true;
+
+    /// Run the face SSD at least every `faceDetectInterval` frames and
+    /// track the face boxes in between; run it sooner when the share of
+    /// tracked corners drops below `faceTrackConfidence`. 1 detects on
+    /// every frame. See FaceTracker.
+    std::atomic<int> faceDetectInterval = 5;
+    std::atomic<float> faceTrackConfidence = 0.6f;
+    /// Let a Haar cascade on the quarter-size gray image pick where the
+    /// SSD looks, skipping it on frames with no face candidates; with no
+    /// candidates, the SSD still searches the whole frame every
+    /// `faceFullFrameInterval` frames. See FacePrefilter.
+    std::atomic<bool> faceCascadePrefilter = true;
+    std::atomic<int> faceFullFrameInterval = 30;
+    /// With depth, look for faces only in head-sized crops around the
+    /// people between `faceMinDepth` and `faceMaxDepth` meters, taking
+    /// precedence over the cascade. See DepthFaceProposer.
+    std::atomic<bool> faceDepthProposals = true;
+    std::atomic<float> faceMinDepth = 0.4f;
+    std::atomic<float> faceMaxDepth = 1.5f;
+    /// Skip face detection and landmarks, keeping the last results, while
+    /// the scene moves less than `faceMotionThreshold` gray levels on
+    /// average, but no more than `faceMaxStaleFrames` frames in a row. 0
+    /// runs on every frame. See MotionGate.
+    std::atomic<float> faceMotionThreshold = 2.0f;
+    std::atomic<int> faceMaxStaleFrames = 30;
+    /// Motion score and skip rate of the detection thread.
+    MotionGate::Metrics getFaceMotionMetrics() const;
+
+    /// Record every captured frameset, with the current extrinsics, to
+    /// `path`. Replaces any recording in progress.
+    void startRecording(const std::string& path);
+    void stopRecording();
+
+    /// Stream geometry as reported by the source.
+    const RgbdStreamInfo& getStreamInfo() const { return streamInfo; }
+    const FrameSource& getSource() const { return *source; }
+    /// Recently published framesets, keyed by the FrameRef sequence; empty
+    /// unless keepHistory is set.
+    const History& getHistory() const { return history; }
+    /// Fill getHistory(). Off by default, as nothing reads it yet; open the
+    /// source with FrameSourceOptions::retainedFrames = History::capacity()
+    /// when setting it so the source pool covers the retained frames.
+    std::atomic<bool> keepHistory = false;
 
     struct Intrinsics {
         float fx = 302.02243162f;
@@ -69,7 +149,10 @@ public:
         cv::Mat getDist() const {
             return cv::Mat(1, 5, CV_32F, (void*)dist.data()).clone();
         }
-    
+
+        StreamIntrinsics toStream() const { return {fx, fy, cx, cy, width, height, dist}; }
+        /// Shared undistorted ray table for these intrinsics.
+        std::shared_ptr<const RayTable> rays() const { return RayTable::get(toStream()); }
       };
 
     Intrinsics intrinsics;
@@ -80,49 +163,128 @@ public:
     cv::Mat getDist() const;
 
     cv::Mat getExtrinsics() const {
-        // std::lock_guard lock(extrinsicsMutex);
+        std::lock_guard lock(extrinsicsMutex);
         return extrinsicsMatrix.clone();
     }
+    /// Bumped every time a new pose is published.
+    uint64_t getExtrinsicsVersion() const { return extrinsicsVersion.load(std::memory_order_acquire); }
+
+    /// AprilTag pose estimates per second, on a worker thread. 0 runs only
+    /// when requested. Sources that carry their own pose skip the worker.
+    void setExtrinsicsRate(float hz);
+    float getExtrinsicsRate() const { return extrinsicsRateHz; }
+    /// Estimate the pose from the next frame, whatever the rate.
+    void requestExtrinsicsUpdate();
+
+    /// Lock the pose once the tag poses are steady and stop detecting tags
+    /// until the tag region changes; see ExtrinsicsLock. Turn off when the
+    /// camera or the tag is expected to move.
+    std::atomic<bool> lockExtrinsics = true;
+    /// Whether the published pose is locked.
+    bool isExtrinsicsLocked() const { return extrinsicsLocked; }
+    /// Drop the locked pose and estimate it again from the next frames,
+    /// e.g. after the camera was moved on purpose.
+    void unlockExtrinsics();
+
+    /// Solve the pose from every visible tag of `bundle` rather than from
+    /// the first tag found. The pose is then the board's, in the bundle's
+    /// coordinates. Null goes back to the single tag.
+    void setTagBundle(std::shared_ptr<const TagBundle> bundle);
 
 private:
-    void createGlTexture();
+    void loadModels();
     void captureLoop();
+    /// Replace `depth` with a filtered copy from depthPool.
+    void filterCapturedDepth(FrameHandle& depth);
     void detectionLoop();
-    void updateExtrinsicsFromAprilTag();
+    /// Run the face SSD on `derived`, or only where `depth` or the cascade
+    /// proposes; `previous` are the last known faces. Boxes in frame pixels.
+    /// Returns false, with no faces, when nothing was proposed and the SSD
+    /// did not run.
+    bool detectFaces(const DerivedImages& derived, const cv::Mat& depth, const std::vector<cv::Rect>& previous,
+                     std::vector<cv::Rect>& faces);
+    void extrinsicsLoop();
+    /// Detect tags in `frame` and publish the resulting pose.
+    void updateExtrinsicsFromAprilTag(const DepthCameraFrame& frame);
+
+    /// Upper bound on how long capture and detection block waiting for a
+    /// frame, i.e. how quickly they notice shutdown.
+    static constexpr unsigned int captureTimeoutMs = 100;
 
     cv::Mat extrinsicsMatrix = cv::Mat::eye(4, 4, CV_32F);
 
     // State
     std::shared_ptr<State> state;
-    std::unique_ptr<DepthCameraInputImpl> impl;
+    std::unique_ptr<FrameSource> source;
     std::atomic<bool> running = true;
 
-    // OpenGL texture
-    GLuint textureId;
+    FrameTexture texture;
 
     // Frame data
-    mutable std::mutex frameMutex;
-    cv::Mat frame;
-    rs2::depth_frame depth_frame;
+    FrameBuffer frames;
+    History history;
+    std::unique_ptr<FramePool> framePool;
+    RgbdStreamInfo streamInfo;
+
+    // Depth post-processing, capture thread only
+    DepthFilter depthFilter;
+    std::unique_ptr<FramePool> depthPool;
+    /// Depth -> color registration for landmark lookups; null without depth.
+    std::unique_ptr<DepthAligner> depthAligner;
+    /// Undistorted color rays; null when the source has no intrinsics.
+    std::shared_ptr<const RayTable> colorRays;
+
+    // Recording, and the lockstep hand-off to detection for non-live sources
+    std::mutex recorderMutex;
+    std::unique_ptr<RecordingWriter> recorder;
+    std::atomic<uint64_t> processedSequence = 0;
 
     // Threads
     std::thread captureThread;
     std::thread detectionThread;
+    std::thread extrinsicsThread;
 
     // Face detection & landmarks
-    cv::CascadeClassifier faceDetector;
+    /// Native LBF runtime, warm-started from the last frame; facemark is
+    /// only loaded when the model cannot be read by it.
+    std::unique_ptr<LandmarkRegressor> landmarkRegressor;
     cv::Ptr<cv::face::Facemark> facemark;
-    std::mutex faceMutex;
+    mutable std::mutex faceMutex;
     std::vector<cv::Rect> faceBoxes;
     std::vector<std::vector<cv::Point2f>> landmarkPoints;
 
-    cv::dnn::Net faceNet;
+    /// Shared with every other camera that detects faces.
+    std::shared_ptr<FaceInference> faceInference;
+    /// Detection thread only.
+    FaceTracker faceTracker;
+    FacePrefilter facePrefilter;
+    /// Null without depth.
+    std::unique_ptr<DepthFaceProposer> depthFaceProposer;
+    MotionGate faceMotionGate;
+    /// Copy of faceMotionGate.metrics(), under faceMutex.
+    MotionGate::Metrics faceMotionMetrics;
 
     std::vector<cv::Point3f> landmark3D;
     std::mutex landmarkMutex;
-    std::mutex extrinsicsMutex;
+    mutable std::mutex extrinsicsMutex;
+    std::atomic<uint64_t> extrinsicsVersion = 0;
+
+    // AprilTag worker scheduling
+    std::atomic<float> extrinsicsRateHz = 2.0f;
+    std::mutex extrinsicsWakeMutex;
+    std::condition_variable extrinsicsWake;
+    bool extrinsicsRequested = false;
+    bool extrinsicsUnlockRequested = false;
+    std::atomic<bool> extrinsicsLocked = false;
+
+    std::mutex tagBundleMutex;
+    std::shared_ptr<const TagBundle> tagBundle;
 
-    AprilTags::TagDetector* tagDetector;
+    /// Extrinsics worker thread only.
+    std::unique_ptr<TagTracker> tagTracker;
+    ExtrinsicsLock extrinsicsLock;
+    /// Bundle in use, and the one the lock was configured for.
+    std::shared_ptr<const TagBundle> activeTagBundle;
 
     float tag_size_meters = 0.0736f;  // Set your actual tag size here
 };
@@ -0,0 +1,109 @@
+#include "depth_face_proposer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace UsArMirror {
+
+DepthFaceProposer::DepthFaceProposer(const RgbdStreamInfo& streams, const DepthFaceProposerOptions& options)
+    : options(options), streams(streams) {}
+
+bool DepthFaceProposer::propose(const cv::Mat& depth, std::vector<cv::Rect>& regions) {
+    auto start = std::chrono::steady_clock::now();
+    regions.clear();
+    const StreamIntrinsics& depthIntr = streams.depth;
+    const StreamIntrinsics& colorIntr = streams.color;
+    if (depth.empty() || depth.type() != CV_16UC1 || depth.cols != depthIntr.width || depth.rows != depthIntr.height ||
+        depthIntr.fx <= 0.0f || colorIntr.fx <= 0.0f) {
+        return false;
+    }
+
+    // Foreground mask: depth in meters where inside the band, 0 elsewhere.
+    const int step = std::max(options.step, 1);
+    const int cols = depth.cols / step;
+    const int rows = depth.rows / step;
+    meters.assign(static_cast<size_t>(cols) * rows, 0.0f);
+    for (int y = 0; y < rows; ++y) {
+        const uint16_t* row = depth.ptr<uint16_t>(y * step + step / 2);
+        for (int x = 0; x < cols; ++x) {
+            float z = row[x * step + step / 2] * streams.depthScale;
+            if (z >= options.minDepth && z <= options.maxDepth) meters[static_cast<size_t>(y) * cols + x] = z;
+        }
+    }
+
+    // 4-connected blobs, split where the depth jumps.
+    labels.assign(meters.size(), -1);
+    blobs.clear();
+    for (int seed = 0; seed < static_cast<int>(meters.size()); ++seed) {
+        if (meters[seed] == 0.0f || labels[seed] >= 0) continue;
+        Blob blob;
+        blob.top = seed / cols;
+        const int label = static_cast<int>(blobs.size());
+        labels[seed] = label;
+        stack.assign(1, seed);
+        while (!stack.empty()) {
+            int cell = stack.back();
+            stack.pop_back();
+            blob.cells.push_back(cell);
+            int cx = cell % cols;
+            int cy = cell / cols;
+            blob.top = std::min(blob.top, cy);
+            const int neighbours[4] = {cx > 0 ? cell - 1 : -1, cx + 1 < cols ? cell + 1 : -1,
+                                       cy > 0 ? cell - cols : -1, cy + 1 < rows ? cell + cols : -1};
+            for (int next : neighbours) {
+                if (next < 0 || labels[next] >= 0 || meters[next] == 0.0f) continue;
+                if (std::abs(meters[next] - meters[cell]) > options.maxDepthJump) continue;
+                labels[next] = label;
+                stack.push_back(next);
+            }
+        }
+        blobs.push_back(std::move(blob));
+    }
+
+    const float* r = streams.depthToColorRotation.data();
+    const float* t = streams.depthToColorTranslation.data();
+    const cv::Rect bounds(0, 0, colorIntr.width, colorIntr.height);
+    for (const Blob& blob : blobs) {
+        // Head size from the blob's median depth, then the head is the top
+        // head-height of the blob.
+        band.clear();
+        for (int cell : blob.cells) band.push_back(meters[cell]);
+        auto middle = band.begin() + band.size() / 2;
+        std::nth_element(band.begin(), middle, band.end());
+        float headCells = depthIntr.fy * options.headSize / (*middle * step);
+        if (headCells < 1.0f) continue;
+
+        band.clear();
+        float columnSum = 0.0f;
+        for (int cell : blob.cells) {
+            if (cell / cols >= blob.top + headCells) continue;
+            band.push_back(meters[cell]);
+            columnSum += static_cast<float>(cell % cols);
+        }
+        // A head is about two thirds as wide as it is tall.
+        if (band.size() < options.minHeadFill * 0.65f * headCells * headCells) continue;
+        middle = band.begin() + band.size() / 2;
+        std::nth_element(band.begin(), middle, band.end());
+        float z = *middle;
+
+        // Head centre in depth pixels, then into the color camera.
+        float u = (columnSum / static_cast<float>(band.size()) + 0.5f) * step;
+        float v = (static_cast<float>(blob.top) + 0.5f * headCells) * step;
+        float x = (u - depthIntr.cx) / depthIntr.fx * z;
+        float y = (v - depthIntr.cy) / depthIntr.fy * z;
+        float cx = r[0] * x + r[1] * y + r[2] * z + t[0];
+        float cy = r[3] * x + r[4] * y + r[5] * z + t[1];
+        float cz = r[6] * x + r[7] * y + r[8] * z + t[2];
+        if (cz <= 0.0f) continue;
+        cv::Point2f center(colorIntr.fx * cx / cz + colorIntr.cx, colorIntr.fy * cy / cz + colorIntr.cy);
+        float side = options.cropScale * colorIntr.fy * options.headSize / cz;
+        cv::Rect crop = cv::Rect(cv::Rect2f(center.x - 0.5f * side, center.y - 0.5f * side, side, side)) & bounds;
+        if (!crop.empty()) regions.push_back(crop);
+    }
+
+    lastCost = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+} // namespace UsArMirror
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <vector>
+
+#include "frame_source.hpp"
+
+namespace UsArMirror {
+
+struct DepthFaceProposerOptions {
+    /// Band in meters where a face in front of the mirror can be.
+    float minDepth = 0.4f;
+    float maxDepth = 1.5f;
+    /// Depth pixels per mask cell along each axis.
+    int step = 4;
+    /// Neighbouring cells further apart than this, in meters, belong to
+    /// different blobs: a person and whoever or whatever is behind them.
+    float maxDepthJump = 0.1f;
+    /// Crown to chin, in meters.
+    float headSize = 0.24f;
+    /// A blob must fill this share of the head-sized area at its top to
+    /// count as a head; smaller ones are noise or hands.
+    float minHeadFill = 0.3f;
+    /// Side of the crop handed to the detector, in head sizes.
+    float cropScale = 2.5f;
+};
+
+/// Proposes face regions from depth alone.
+///
+/// The Z16 frame is sampled every `step` pixels and thresholded to the
+/// depth band, giving a small foreground mask. Cells are grouped into
+/// blobs, split where the depth jumps. For each blob, the expected head
+/// size in pixels follows from its depth and fy; the top head-height of
+/// the blob is taken as the head, and a square crop cropScale heads wide
+/// around it is proposed in color pixels. The detector therefore sees
+/// only the people in the band, each at about the same scale, and nothing
+/// behind them.
+class DepthFaceProposer {
+public:
+    explicit DepthFaceProposer(const RgbdStreamInfo& streams,
+                               const DepthFaceProposerOptions& options = DepthFaceProposerOptions());
+
+    /// Crops in color pixels for Z16 `depth`. Returns false, with no
+    /// regions, when `depth` does not match the depth stream; true with no
+    /// regions means nobody is in the band.
+    bool propose(const cv::Mat& depth, std::vector<cv::Rect>& regions);
+
+    DepthFaceProposerOptions options;
+
+    /// Wall time of the last propose() call.
+    double lastCostMs() const { return lastCost; }
+
+private:
+    struct Blob {
+        int top = 0;
+        std::vector<int> cells;
+    };
+
+    RgbdStreamInfo streams;
+    double lastCost = 0.0;
+
+    // Scratch, one entry per cell.
+    std::vector<float> meters;
+    std::vector<int> labels;
+    std::vector<int> stack;
+    std::vector<Blob> blobs;
+    std::vector<float> band;
+};
+
+} // namespace UsArMirror
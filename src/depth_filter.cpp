@@ -0,0 +1,203 @@
+#include "depth_filter.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace UsArMirror {
+
+namespace {
+
+using namespace simd;
+
+/// Pixel `x` of `row`, or lanes x..x+3 for vectors. The scalar path treats
+/// pixels outside the row as holes; the vector path is only used where all
+/// lanes are inside.
+template<typename V> V loadAt(const float* row, int x, int width);
+template<> float loadAt<float>(const float* row, int x, int width) { return x < 0 || x >= width ? 0.0f : row[x]; }
+template<> f32x4 loadAt<f32x4>(const float* row, int x, int) { return load(row + x); }
+
+inline void storeAt(float* row, int x, float v) { row[x] = v; }
+inline void storeAt(float* row, int x, f32x4 v) { store(row + x, v); }
+
+void widenRow(const uint16_t* src, float* dst, int width) {
+    int x = 0;
+    for (; x + lanes <= width; x += lanes) store(dst + x, loadU16(src + x));
+    for (; x < width; ++x) dst[x] = src[x];
+}
+
+void narrowRow(const float* src, uint16_t* dst, int width) {
+    int x = 0;
+    for (; x + lanes <= width; x += lanes) storeU16(dst + x, load(src + x));
+    for (; x < width; ++x) dst[x] = static_cast<uint16_t>(src[x] + 0.5f);
+}
+
+/// Call fn(x, V{}) over a row: vectors where every lane and its horizontal
+/// neighbours are inside, scalars at the borders and for the tail.
+template<typename Fn>
+void rowLoop(int width, Fn&& fn) {
+    int x = 0;
+    if (width >= lanes + 2) {
+        fn(0, float{});
+        for (x = 1; x + lanes <= width - 1; x += lanes) fn(x, f32x4{});
+    }
+    for (; x < width; ++x) fn(x, float{});
+}
+
+/// [1 2 1] tap that drops neighbours which are holes or across an edge.
+template<typename V>
+inline V edgePreservingTap(V a, V c, V b, V delta) {
+    const V zero = splat<V>(0.0f), one = splat<V>(1.0f), two = splat<V>(2.0f);
+    V wa = select((a > zero) & (absolute(a - c) <= delta), one, zero);
+    V wb = select((b > zero) & (absolute(b - c) <= delta), one, zero);
+    V smoothed = (two * c + wa * a + wb * b) / (two + wa + wb);
+    return select(c > zero, smoothed, zero);
+}
+
+void spatialRowHorizontal(const float* src, float* dst, int width, float delta) {
+    rowLoop(width, [&](int x, auto tag) {
+        using V = decltype(tag);
+        V value = edgePreservingTap(loadAt<V>(src, x - 1, width), loadAt<V>(src, x, width),
+                                    loadAt<V>(src, x + 1, width), splat<V>(delta));
+        storeAt(dst, x, value);
+    });
+}
+
+void spatialRowVertical(const float* above, const float* row, const float* below, float* dst, int width,
+                        float delta) {
+    rowLoop(width, [&](int x, auto tag) {
+        using V = decltype(tag);
+        V value = edgePreservingTap(loadAt<V>(above, x, width), loadAt<V>(row, x, width),
+                                    loadAt<V>(below, x, width), splat<V>(delta));
+        storeAt(dst, x, value);
+    });
+}
+
+void temporalRow(float* row, float* history, float* age, int width, const DepthFilterOptions& options) {
+    rowLoop(width, [&](int x, auto tag) {
+        using V = decltype(tag);
+        const V zero = splat<V>(0.0f);
+        V current = loadAt<V>(row, x, width);
+        V previous = loadAt<V>(history, x, width);
+        V frames = loadAt<V>(age, x, width);
+
+        auto close = (current > zero) & (previous > zero) &
+                     (absolute(current - previous) <= splat<V>(options.temporalDelta));
+        V blended = previous + splat<V>(options.temporalAlpha) * (current - previous);
+        V out = select(close, blended, current);
+        auto hold = (current <= zero) & (previous > zero) &
+                    (frames < splat<V>(static_cast<float>(options.persistence)));
+        out = select(hold, previous, out);
+        V nextAge = select(current > zero, zero, minimum(frames + splat<V>(1.0f), splat<V>(65535.0f)));
+
+        storeAt(row, x, out);
+        storeAt(history, x, out);
+        storeAt(age, x, nextAge);
+    });
+}
+
+void holeFillRow(const float* above, const float* row, const float* below, float* dst, int width) {
+    rowLoop(width, [&](int x, auto tag) {
+        using V = decltype(tag);
+        V centre = loadAt<V>(row, x, width);
+        V farthest = maximum(maximum(loadAt<V>(row, x - 1, width), loadAt<V>(row, x + 1, width)),
+                             maximum(loadAt<V>(above, x, width), loadAt<V>(below, x, width)));
+        storeAt(dst, x, select(centre > splat<V>(0.0f), centre, farthest));
+    });
+}
+
+/// Apply a 3-row kernel to every row of a contiguous plane.
+template<typename Kernel>
+void forEachRow(const std::vector<float>& src, std::vector<float>& dst, const std::vector<float>& zeroRow,
+                int width, int height, Kernel&& kernel) {
+    for (int y = 0; y < height; ++y) {
+        const float* row = src.data() + static_cast<size_t>(y) * width;
+        const float* above = y > 0 ? row - width : zeroRow.data();
+        const float* below = y + 1 < height ? row + width : zeroRow.data();
+        kernel(above, row, below, dst.data() + static_cast<size_t>(y) * width);
+    }
+}
+
+} // namespace
+
+DepthFilter::DepthFilter(const DepthFilterOptions& options) : options(options) {}
+
+void DepthFilter::reset() {
+    hasHistory = false;
+}
+
+void DepthFilter::resize(int newWidth, int newHeight) {
+    width = newWidth;
+    height = newHeight;
+    size_t size = static_cast<size_t>(width) * height;
+    planeA.assign(size, 0);
+    planeB.assign(size, 0);
+    history.assign(size, 0);
+    age.assign(size, 0);
+    zeroRow.assign(width, 0);
+    hasHistory = false;
+}
+
+void DepthFilter::process(const cv::Mat& depth, cv::Mat& out) {
+    if (depth.type() != CV_16UC1 || out.type() != CV_16UC1 || depth.size() != out.size()) {
+        throw std::runtime_error("DepthFilter expects two CV_16UC1 images of the same size");
+    }
+    process(depth.ptr<uint16_t>(), depth.step, out.ptr<uint16_t>(), out.step, depth.cols, depth.rows);
+}
+
+void DepthFilter::process(const uint16_t* depth, size_t depthStep, uint16_t* out, size_t outStep, int w, int h) {
+    auto start = std::chrono::steady_clock::now();
+    if (w != width || h != height) resize(w, h);
+
+    for (int y = 0; y < height; ++y) {
+        widenRow(reinterpret_cast<const uint16_t*>(reinterpret_cast<const uint8_t*>(depth) + y * depthStep),
+                 planeA.data() + static_cast<size_t>(y) * width, width);
+    }
+
+    if (options.spatial) {
+        for (int i = 0; i < options.spatialIterations; ++i) {
+            for (int y = 0; y < height; ++y) {
+                size_t offset = static_cast<size_t>(y) * width;
+                spatialRowHorizontal(planeA.data() + offset, planeB.data() + offset, width, options.spatialDelta);
+            }
+            forEachRow(planeB, planeA, zeroRow, width, height,
+                       [&](const float* above, const float* row, const float* below, float* dst) {
+                           spatialRowVertical(above, row, below, dst, width, options.spatialDelta);
+                       });
+        }
+    }
+
+    if (options.temporal) {
+        if (!hasHistory) {
+            history = planeA;
+            std::fill(age.begin(), age.end(), 0);
+            hasHistory = true;
+        } else {
+            for (int y = 0; y < height; ++y) {
+                size_t offset = static_cast<size_t>(y) * width;
+                temporalRow(planeA.data() + offset, history.data() + offset, age.data() + offset, width, options);
+            }
+        }
+    }
+
+    if (options.holeFill) {
+        for (int i = 0; i < options.holeFillRadius; ++i) {
+            forEachRow(planeA, planeB, zeroRow, width, height,
+                       [&](const float* above, const float* row, const float* below, float* dst) {
+                           holeFillRow(above, row, below, dst, width);
+                       });
+            std::swap(planeA, planeB);
+        }
+    }
+
+    for (int y = 0; y < height; ++y) {
+        narrowRow(planeA.data() + static_cast<size_t>(y) * width,
+                  reinterpret_cast<uint16_t*>(reinterpret_cast<uint8_t*>(out) + y * outStep), width);
+    }
+    lastCost = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace UsArMirror
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace UsArMirror {
+
+struct DepthFilterOptions {
+    /// Edge-preserving 3x3 smoothing: neighbours further than `spatialDelta`
+    /// depth units from the centre pixel are left out, so depth edges
+    /// around the face stay sharp.
+    bool spatial = true;
+    int spatialIterations = 2;
+    float spatialDelta = 20.0f;
+
+    /// Exponential smoothing over time. Changes larger than `temporalDelta`
+    /// reset a pixel instead of smearing motion. A pixel that drops out
+    /// keeps its last value for `persistence` frames.
+    bool temporal = true;
+    float temporalAlpha = 0.4f;
+    float temporalDelta = 20.0f;
+    int persistence = 3;
+
+    /// Remaining holes take the farthest valid 4-neighbour, repeated
+    /// `holeFillRadius` times. Farthest rather than nearest keeps the
+    /// foreground from bleeding into the background.
+    bool holeFill = true;
+    int holeFillRadius = 4;
+};
+
+/// Cleans up Z16 depth: spatial filter, temporal filter, hole filling.
+///
+/// Rows are widened to float once, and every pass runs over whole rows with
+/// GCC/Clang vector extensions, which compile to SSE on x86 and NEON on ARM. The
+/// temporal filter keeps state between calls, so one instance must see
+/// the frames of one stream in order.
+class DepthFilter {
+public:
+    explicit DepthFilter(const DepthFilterOptions& options = DepthFilterOptions());
+
+    /// Filter CV_16UC1 `depth` into `out`, which must already have the
+    /// same size and type and must not alias `depth`.
+    void process(const cv::Mat& depth, cv::Mat& out);
+    void process(const uint16_t* depth, size_t depthStep, uint16_t* out, size_t outStep, int width, int height);
+
+    /// Forget temporal history, e.g. after a seek or a source change.
+    void reset();
+
+    const DepthFilterOptions& getOptions() const { return options; }
+    /// Wall time of the last process() call.
+    double lastCostMs() const { return lastCost; }
+
+private:
+    void resize(int width, int height);
+
+    DepthFilterOptions options;
+    int width = 0;
+    int height = 0;
+    // Contiguous float scratch planes, width * height each.
+    std::vector<float> planeA;
+    std::vector<float> planeB;
+    std::vector<float> history;
+    std::vector<float> age;
+    /// Stands in for the rows above the first and below the last.
+    std::vector<float> zeroRow;
+    bool hasHistory = false;
+    double lastCost = 0.0;
+};
+
+} // namespace UsArMirror
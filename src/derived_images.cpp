@@ -0,0 +1,112 @@
+#include "derived_images.hpp"
+
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace UsArMirror {
+
+namespace {
+
+// cv::COLOR_BGR2GRAY's fixed-point weights (Q14), so results match OpenCV.
+constexpr int grayB = 1868;
+constexpr int grayG = 9617;
+constexpr int grayR = 4899;
+constexpr int grayShift = 14;
+
+void grayRow(const uint8_t* bgr, uint8_t* gray, int width) {
+    for (int x = 0; x < width; ++x) {
+        const uint8_t* p = bgr + 3 * x;
+        gray[x] = static_cast<uint8_t>((p[0] * grayB + p[1] * grayG + p[2] * grayR + (1 << (grayShift - 1))) >>
+                                       grayShift);
+    }
+}
+
+/// One output row of a 2x2 box downsample of `cn`-channel rows.
+template<int cn>
+void halveRow(const uint8_t* row0, const uint8_t* row1, uint8_t* dst, int dstWidth) {
+    for (int x = 0; x < dstWidth; ++x) {
+        const uint8_t* a = row0 + 2 * cn * x;
+        const uint8_t* b = row1 + 2 * cn * x;
+        for (int c = 0; c < cn; ++c) {
+            dst[cn * x + c] = static_cast<uint8_t>((a[c] + a[c + cn] + b[c] + b[c + cn] + 2) >> 2);
+        }
+    }
+}
+
+void halve(const cv::Mat& src, cv::Mat& dst) {
+    dst.create(src.rows / 2, src.cols / 2, src.type());
+    for (int y = 0; y < dst.rows; ++y) {
+        const uint8_t* row0 = src.ptr<uint8_t>(2 * y);
+        const uint8_t* row1 = src.ptr<uint8_t>(2 * y + 1);
+        if (src.channels() == 3) {
+            halveRow<3>(row0, row1, dst.ptr<uint8_t>(y), dst.cols);
+        } else {
+            halveRow<1>(row0, row1, dst.ptr<uint8_t>(y), dst.cols);
+        }
+    }
+}
+
+} // namespace
+
+DerivedImages::DerivedImages(FrameHandle color) : color(std::move(color)) {
+    if (this->color.empty() || this->color.mat().type() != CV_8UC3) {
+        throw std::runtime_error("DerivedImages expects a BGR8 frame");
+    }
+}
+
+void DerivedImages::computePyramid() const {
+    // One pass over pairs of source rows while they are in cache: both
+    // gray rows, the half-size BGR row and the half-size gray row.
+    const cv::Mat& src = color.mat();
+    grayImage.create(src.rows, src.cols, CV_8UC1);
+    halfImage.create(src.rows / 2, src.cols / 2, CV_8UC3);
+    grayHalfImage.create(src.rows / 2, src.cols / 2, CV_8UC1);
+    for (int y = 0; y + 1 < src.rows; y += 2) {
+        const uint8_t* row0 = src.ptr<uint8_t>(y);
+        const uint8_t* row1 = src.ptr<uint8_t>(y + 1);
+        uint8_t* gray0 = grayImage.ptr<uint8_t>(y);
+        uint8_t* gray1 = grayImage.ptr<uint8_t>(y + 1);
+        grayRow(row0, gray0, src.cols);
+        grayRow(row1, gray1, src.cols);
+        halveRow<3>(row0, row1, halfImage.ptr<uint8_t>(y / 2), halfImage.cols);
+        halveRow<1>(gray0, gray1, grayHalfImage.ptr<uint8_t>(y / 2), grayHalfImage.cols);
+    }
+    if (src.rows % 2 != 0) {
+        grayRow(src.ptr<uint8_t>(src.rows - 1), grayImage.ptr<uint8_t>(src.rows - 1), src.cols);
+    }
+}
+
+const cv::Mat& DerivedImages::gray() const {
+    std::call_once(pyramidOnce, [this] { computePyramid(); });
+    return grayImage;
+}
+
+const cv::Mat& DerivedImages::half() const {
+    std::call_once(pyramidOnce, [this] { computePyramid(); });
+    return halfImage;
+}
+
+const cv::Mat& DerivedImages::grayHalf() const {
+    std::call_once(pyramidOnce, [this] { computePyramid(); });
+    return grayHalfImage;
+}
+
+const cv::Mat& DerivedImages::quarter() const {
+    std::call_once(quarterOnce, [this] { halve(half(), quarterImage); });
+    return quarterImage;
+}
+
+const cv::Mat& DerivedImages::grayQuarter() const {
+    std::call_once(grayQuarterOnce, [this] { halve(grayHalf(), grayQuarterImage); });
+    return grayQuarterImage;
+}
+
+const cv::Mat& DerivedImages::rgb() const {
+    std::call_once(rgbOnce, [this] { cv::cvtColor(color.mat(), rgbImage, cv::COLOR_BGR2RGB); });
+    return rgbImage;
+}
+
+} // namespace UsArMirror
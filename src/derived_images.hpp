@@ -0,0 +1,56 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <mutex>
+
+#include "frame_handle.hpp"
+
+namespace UsArMirror {
+
+/// Images derived from one BGR8 color frame, computed on first use and
+/// shared read-only by every consumer of that frame.
+///
+/// Each product is computed at most once per frame, whichever thread asks
+/// first; later callers get the cached result. gray() and half() come out
+/// of one fused pass over the source, so asking for both costs a single
+/// read of the frame.
+class DerivedImages {
+public:
+    /// `color` is kept alive until this object goes away.
+    explicit DerivedImages(FrameHandle color);
+
+    DerivedImages(const DerivedImages&) = delete;
+    DerivedImages& operator=(const DerivedImages&) = delete;
+
+    const cv::Mat& bgr() const { return color.mat(); }
+    /// CV_8UC1, same weights and rounding as cv::COLOR_BGR2GRAY.
+    const cv::Mat& gray() const;
+    /// CV_8UC3 with R and B swapped, for dlib and RGB-trained networks.
+    const cv::Mat& rgb() const;
+    /// BGR at 1/2 and 1/4 size, 2x2 box filtered per level.
+    const cv::Mat& half() const;
+    const cv::Mat& quarter() const;
+    /// Gray at 1/2 size, 2x2 box filtered.
+    const cv::Mat& grayHalf() const;
+    /// Gray at 1/4 size, 2x2 box filtered from grayHalf().
+    const cv::Mat& grayQuarter() const;
+
+private:
+    void computePyramid() const;
+
+    FrameHandle color;
+
+    mutable std::once_flag pyramidOnce;
+    mutable std::once_flag rgbOnce;
+    mutable std::once_flag quarterOnce;
+    mutable std::once_flag grayQuarterOnce;
+    mutable cv::Mat grayImage;
+    mutable cv::Mat halfImage;
+    mutable cv::Mat rgbImage;
+    mutable cv::Mat quarterImage;
+    mutable cv::Mat grayHalfImage;
+    mutable cv::Mat grayQuarterImage;
+};
+
+} // namespace UsArMirror
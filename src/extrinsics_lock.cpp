@@ -0,0 +1,201 @@
+#include "extrinsics_lock.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "derived_images.hpp"
+
+namespace UsArMirror {
+
+namespace {
+
+Eigen::Matrix4d toEigen(const cv::Mat& pose) {
+    Eigen::Matrix4d out;
+    for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 4; ++j) out(i, j) = pose.at<float>(i, j);
+    return out;
+}
+
+cv::Mat toMat(const Eigen::Matrix4d& pose) {
+    cv::Mat out(4, 4, CV_32F);
+    for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 4; ++j) out.at<float>(i, j) = static_cast<float>(pose(i, j));
+    return out;
+}
+
+/// Angle of the rotation between `a` and `b`, in degrees.
+double rotationAngleDeg(const Eigen::Matrix3d& a, const Eigen::Matrix3d& b) {
+    double c = ((a.transpose() * b).trace() - 1.0) * 0.5;
+    return std::acos(std::clamp(c, -1.0, 1.0)) * 180.0 / M_PI;
+}
+
+} // namespace
+
+ExtrinsicsLock::ExtrinsicsLock(const ExtrinsicsLockOptions& options) : options(options) {}
+
+void ExtrinsicsLock::reset() {
+    poses.clear();
+    locked = false;
+    hasPrevious = false;
+    grayReference.release();
+    depthReference.release();
+    spreadT = spreadR = 0.0;
+}
+
+Eigen::Matrix4d ExtrinsicsLock::meanPose() const {
+    Eigen::Matrix3d rotationSum = Eigen::Matrix3d::Zero();
+    Eigen::Vector3d translationSum = Eigen::Vector3d::Zero();
+    for (const auto& pose : poses) {
+        rotationSum += pose.topLeftCorner<3, 3>();
+        translationSum += pose.topRightCorner<3, 1>();
+    }
+
+    // Closest rotation to the summed matrices (chordal mean).
+    Eigen::JacobiSVD<Eigen::Matrix3d> svd(rotationSum, Eigen::ComputeFullU | Eigen::ComputeFullV);
+    Eigen::Matrix3d u = svd.matrixU();
+    Eigen::Matrix3d rotation = u * svd.matrixV().transpose();
+    if (rotation.determinant() < 0.0) {
+        u.col(2) = -u.col(2);
+        rotation = u * svd.matrixV().transpose();
+    }
+
+    Eigen::Matrix4d mean = Eigen::Matrix4d::Identity();
+    mean.topLeftCorner<3, 3>() = rotation;
+    mean.topRightCorner<3, 1>() = translationSum / static_cast<double>(poses.size());
+    return mean;
+}
+
+void ExtrinsicsLock::updateSpread(const Eigen::Matrix4d& mean) {
+    double squared = 0.0;
+    spreadR = 0.0;
+    for (const auto& pose : poses) {
+        squared += (pose.topRightCorner<3, 1>() - mean.topRightCorner<3, 1>()).squaredNorm();
+        spreadR = std::max(spreadR, rotationAngleDeg(mean.topLeftCorner<3, 3>(), pose.topLeftCorner<3, 3>()));
+    }
+    spreadT = std::sqrt(squared / static_cast<double>(poses.size()));
+}
+
+cv::Mat ExtrinsicsLock::addPose(const cv::Mat& pose, const cv::Rect& tagRegion, const DerivedImages& frame,
+                                const cv::Mat& depth) {
+    if (locked) return toMat(lockedPose);
+
+    poses.push_back(toEigen(pose));
+    while (poses.size() > std::max<size_t>(options.window, 1)) poses.pop_front();
+    Eigen::Matrix4d mean = meanPose();
+    updateSpread(mean);
+
+    if (hasPrevious && poses.size() >= options.confirmPoses) {
+        bool agree = std::all_of(poses.begin(), poses.end(), [&](const Eigen::Matrix4d& p) {
+            double moved = (p.topRightCorner<3, 1>() - previousPose.topRightCorner<3, 1>()).norm();
+            double turned = rotationAngleDeg(previousPose.topLeftCorner<3, 3>(), p.topLeftCorner<3, 3>());
+            return moved <= 2.0 * options.maxTranslationSpread && turned <= 2.0 * options.maxRotationSpread;
+        });
+        if (agree) {
+            lock(previousPose, tagRegion, frame, depth);
+            return toMat(lockedPose);
+        }
+        // The camera really moved; estimate from scratch.
+        hasPrevious = false;
+    }
+
+    if (poses.size() >= options.window && spreadT <= options.maxTranslationSpread &&
+        spreadR <= options.maxRotationSpread) {
+        lock(mean, tagRegion, frame, depth);
+        return toMat(lockedPose);
+    }
+    return toMat(mean);
+}
+
+void ExtrinsicsLock::lock(const Eigen::Matrix4d& pose, const cv::Rect& tagRegion, const DerivedImages& frame,
+                          const cv::Mat& depth) {
+    locked = true;
+    lockedPose = pose;
+    hasPrevious = false;
+
+    const cv::Mat& gray = frame.gray();
+    colorSize = gray.size();
+    int marginX = static_cast<int>(std::lround(options.regionMargin * tagRegion.width));
+    int marginY = static_cast<int>(std::lround(options.regionMargin * tagRegion.height));
+    cv::Rect region(tagRegion.x - marginX, tagRegion.y - marginY, tagRegion.width + 2 * marginX,
+                    tagRegion.height + 2 * marginY);
+    region &= cv::Rect(0, 0, colorSize.width, colorSize.height);
+
+    const cv::Mat& half = frame.grayHalf();
+    grayRegion = cv::Rect(region.x / 2, region.y / 2, region.width / 2, region.height / 2) &
+                 cv::Rect(0, 0, half.cols, half.rows);
+    grayReference = half(grayRegion).clone();
+
+    depthReference.release();
+    if (!depth.empty() && depth.type() == CV_16UC1) {
+        // The depth stream covers roughly the color view; a proportional
+        // mapping is close enough to notice the tag moving.
+        double sx = static_cast<double>(depth.cols) / colorSize.width;
+        double sy = static_cast<double>(depth.rows) / colorSize.height;
+        depthRegion = cv::Rect(static_cast<int>(region.x * sx), static_cast<int>(region.y * sy),
+                               static_cast<int>(region.width * sx), static_cast<int>(region.height * sy)) &
+                      cv::Rect(0, 0, depth.cols, depth.rows);
+        if (!depthRegion.empty()) depthReference = depth(depthRegion).clone();
+    }
+}
+
+bool ExtrinsicsLock::checkMotion(const DerivedImages& frame, const cv::Mat& depth, float depthScale) {
+    if (!locked) return false;
+    auto start = std::chrono::steady_clock::now();
+
+    bool moved = false;
+    grayChange = 0.0;
+    depthChange = 0.0;
+
+    const cv::Mat& half = frame.grayHalf();
+    if (frame.gray().size() != colorSize || grayRegion.empty() ||
+        (grayRegion & cv::Rect(0, 0, half.cols, half.rows)) != grayRegion) {
+        moved = true;
+    } else {
+        // Compare shapes, not brightness: auto exposure and room lights
+        // shift the whole patch without the camera moving.
+        cv::Mat current = half(grayRegion);
+        double referenceMean = cv::mean(grayReference)[0];
+        double currentMean = cv::mean(current)[0];
+        double offset = currentMean - referenceMean;
+        double sum = 0.0;
+        for (int y = 0; y < current.rows; ++y) {
+            const uint8_t* a = grayReference.ptr<uint8_t>(y);
+            const uint8_t* b = current.ptr<uint8_t>(y);
+            for (int x = 0; x < current.cols; ++x) sum += std::abs(b[x] - a[x] - offset);
+        }
+        grayChange = sum / static_cast<double>(current.total());
+        moved = grayChange > options.maxGrayChange;
+    }
+
+    if (!moved && !depthReference.empty() && !depth.empty() && depth.type() == CV_16UC1 &&
+        (depthRegion & cv::Rect(0, 0, depth.cols, depth.rows)) == depthRegion) {
+        cv::Mat current = depth(depthRegion);
+        uint64_t sum = 0;
+        size_t valid = 0;
+        for (int y = 0; y < current.rows; ++y) {
+            const uint16_t* a = depthReference.ptr<uint16_t>(y);
+            const uint16_t* b = current.ptr<uint16_t>(y);
+            for (int x = 0; x < current.cols; ++x) {
+                if (a[x] == 0 || b[x] == 0) continue;
+                sum += static_cast<uint64_t>(std::abs(static_cast<int>(b[x]) - static_cast<int>(a[x])));
+                ++valid;
+            }
+        }
+        if (valid > 0 && static_cast<double>(valid) >= options.minDepthCoverage * static_cast<double>(current.total())) {
+            depthChange = static_cast<double>(sum) / static_cast<double>(valid) * depthScale;
+            moved = depthChange > options.maxDepthChange;
+        }
+    }
+
+    if (moved) {
+        previousPose = lockedPose;
+        hasPrevious = true;
+        locked = false;
+        poses.clear();
+    }
+    lastCost = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return moved;
+}
+
+} // namespace UsArMirror
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <opencv2/core.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+namespace UsArMirror {
+
+class DerivedImages;
+
+struct ExtrinsicsLockOptions {
+    /// Poses averaged into the published estimate.
+    size_t window = 10;
+    /// The estimate locks once the window is full and its spread is below
+    /// both limits: RMS distance of the translations from their mean in
+    /// meters, and the largest rotation from the mean rotation in degrees.
+    double maxTranslationSpread = 0.002;
+    double maxRotationSpread = 0.5;
+
+    /// After motion was detected, this many fresh poses that agree with the
+    /// old lock (within twice the spread limits) restore it without
+    /// refilling the whole window, e.g. when someone walked past the tag.
+    size_t confirmPoses = 3;
+
+    /// Motion check, run instead of tag detection while locked. The tag's
+    /// bounding box grown by `regionMargin` times its size is compared
+    /// with a snapshot taken at lock time:
+    ///  - gray: mean absolute difference at half resolution after removing
+    ///    the change in mean brightness, in gray levels;
+    ///  - depth: mean absolute difference over pixels valid in both, in
+    ///    meters. Skipped when fewer than `minDepthCoverage` of the
+    ///    pixels are valid in both.
+    float regionMargin = 0.5f;
+    double maxGrayChange = 12.0;
+    double maxDepthChange = 0.03;
+    double minDepthCoverage = 0.25;
+};
+
+/// Averages tag poses of a static camera and locks them in.
+///
+/// The extrinsics of a bolted-down camera only change when it is bumped.
+/// While searching, every tag pose goes into a sliding window and the
+/// window mean is published. Once the window is steady the mean is locked
+/// and the caller stops detecting tags; checkMotion() instead compares a
+/// small patch of gray and depth around the tag with the lock-time
+/// snapshot, and a large change unlocks the pose so detection resumes.
+///
+/// Poses are 4x4 CV_32F camera-from-tag transforms. Not thread-safe; one
+/// instance per stream, used from the thread that estimates the pose.
+class ExtrinsicsLock {
+public:
+    explicit ExtrinsicsLock(const ExtrinsicsLockOptions& options = ExtrinsicsLockOptions());
+
+    /// Whether the caller still has to detect tags.
+    bool needsDetection() const { return !locked; }
+    bool isLocked() const { return locked; }
+
+    /// Add the pose of the tag seen at `tagRegion` (color pixels) in
+    /// `frame`; `depth` is the frame's CV_16UC1 depth, or empty. Returns the
+    /// estimate to publish: the window mean, or the locked pose.
+    cv::Mat addPose(const cv::Mat& pose, const cv::Rect& tagRegion, const DerivedImages& frame, const cv::Mat& depth);
+
+    /// While locked, compare `frame` with the lock-time snapshot. Unlocks
+    /// and returns true when the tag region changed.
+    bool checkMotion(const DerivedImages& frame, const cv::Mat& depth, float depthScale);
+
+    /// Drop the lock and the window; the next poses start a new estimate.
+    void reset();
+
+    const ExtrinsicsLockOptions& getOptions() const { return options; }
+    /// Spread of the current window, see ExtrinsicsLockOptions.
+    double translationSpread() const { return spreadT; }
+    double rotationSpreadDeg() const { return spreadR; }
+    /// Gray and depth change found by the last checkMotion() call.
+    double lastGrayChange() const { return grayChange; }
+    double lastDepthChange() const { return depthChange; }
+    /// Wall time of the last checkMotion() call.
+    double lastCostMs() const { return lastCost; }
+
+private:
+    /// Mean of the window, rotation projected back onto SO(3).
+    Eigen::Matrix4d meanPose() const;
+    void updateSpread(const Eigen::Matrix4d& mean);
+    /// Take the gray and depth snapshot the motion check compares against.
+    void lock(const Eigen::Matrix4d& pose, const cv::Rect& tagRegion, const DerivedImages& frame, const cv::Mat& depth);
+
+    ExtrinsicsLockOptions options;
+    std::deque<Eigen::Matrix4d> poses;
+    bool locked = false;
+    Eigen::Matrix4d lockedPose = Eigen::Matrix4d::Identity();
+    /// A previous lock that motion invalidated, kept for confirmPoses.
+    bool hasPrevious = false;
+    Eigen::Matrix4d previousPose = Eigen::Matrix4d::Identity();
+
+    // Lock-time snapshot
+    cv::Size colorSize;
+    cv::Rect grayRegion; // half-resolution gray pixels
+    cv::Mat grayReference;
+    cv::Rect depthRegion; // depth pixels
+    cv::Mat depthReference; // empty without depth
+
+    double spreadT = 0.0;
+    double spreadR = 0.0;
+    double grayChange = 0.0;
+    double depthChange = 0.0;
+    double lastCost = 0.0;
+};
+
+} // namespace UsArMirror
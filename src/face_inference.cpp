@@ -0,0 +1,159 @@
+#include "face_inference.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace UsArMirror {
+
+FaceInference::FaceInference(const FaceInferenceOptions& options)
+    : options(options), packer(options.inputSize, options.mean) {
+    net = cv::dnn::readNetFromCaffe(options.prototxt, options.model);
+    if (net.empty()) throw std::runtime_error("Cannot load face detector " + options.model);
+    spdlog::info("Loaded face detector {}", options.model);
+    worker = std::thread(&FaceInference::workerLoop, this);
+}
+
+FaceInference::~FaceInference() {
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    worker.join();
+}
+
+std::shared_ptr<FaceInference> FaceInference::shared() {
+    static std::shared_ptr<FaceInference> inference = std::make_shared<FaceInference>();
+    return inference;
+}
+
+std::future<std::vector<FaceInference::Detection>> FaceInference::submit(const cv::Mat& image, float minConfidence) {
+    Request request{image, minConfidence, {}};
+    std::future<std::vector<Detection>> result = request.result.get_future();
+    {
+        std::lock_guard lock(mutex);
+        if (stopping) throw std::runtime_error("FaceInference is shutting down");
+        queue.push_back(std::move(request));
+        ++requestCount;
+    }
+    wake.notify_one();
+    return result;
+}
+
+void FaceInference::setBackend(int backend, int target) {
+    std::lock_guard lock(mutex);
+    options.backend = backend;
+    options.target = target;
+    settingsChanged = true;
+}
+
+void FaceInference::setThreads(int threads) {
+    std::lock_guard lock(mutex);
+    options.threads = threads;
+    settingsChanged = true;
+}
+
+FaceInference::Metrics FaceInference::metrics() const {
+    std::lock_guard lock(mutex);
+    Metrics metrics;
+    metrics.queueDepth = queue.size();
+    metrics.requests = requestCount;
+    metrics.batches = batchCount;
+    metrics.lastBatchMs = lastBatch;
+    if (batchCount > 0) {
+        metrics.averageBatchMs = batchTotalMs / static_cast<double>(batchCount);
+        metrics.averageBatchSize = static_cast<double>(processedCount) / static_cast<double>(batchCount);
+    }
+    return metrics;
+}
+
+void FaceInference::workerLoop() {
+    while (true) {
+        std::vector<Request> batch;
+        bool applySettings = false;
+        int backend = 0, target = 0, threads = 0;
+        {
+            std::unique_lock lock(mutex);
+            wake.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (stopping) break;
+            size_t maxBatch = std::max<size_t>(options.maxBatch, 1);
+            if (options.batchWindow.count() > 0 && queue.size() < maxBatch) {
+                wake.wait_for(lock, options.batchWindow,
+                              [this, maxBatch] { return stopping || queue.size() >= maxBatch; });
+                if (stopping) break;
+            }
+
+            while (!queue.empty() && batch.size() < maxBatch) {
+                batch.push_back(std::move(queue.front()));
+                queue.pop_front();
+            }
+
+            applySettings = std::exchange(settingsChanged, false);
+            backend = options.backend;
+            target = options.target;
+            threads = options.threads;
+        }
+
+        if (applySettings) {
+            net.setPreferableBackend(backend);
+            net.setPreferableTarget(target);
+            if (threads > 0) cv::setNumThreads(threads);
+        }
+        runBatch(batch);
+    }
+
+    std::lock_guard lock(mutex);
+    for (Request& request : queue) {
+        request.result.set_exception(std::make_exception_ptr(std::runtime_error("FaceInference stopped")));
+    }
+    queue.clear();
+}
+
+void FaceInference::runBatch(std::vector<Request>& batch) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::vector<Detection>> results(batch.size());
+    try {
+        placements.resize(batch.size());
+        for (size_t i = 0; i < batch.size(); ++i) {
+            placements[i] = packer.pack(i, batch[i].image, options.letterbox);
+        }
+        net.setInput(packer.batch(batch.size()));
+        net.forward(outputs);
+
+        // DetectionOutput: one row per detection over the whole batch,
+        // [image, class, confidence, x1, y1, x2, y2], corners normalised
+        // to the network input.
+        const cv::Mat& output = outputs.front();
+        const float* rows = output.ptr<float>();
+        const size_t count = output.total() / 7;
+        const float width = static_cast<float>(options.inputSize.width);
+        const float height = static_cast<float>(options.inputSize.height);
+        for (size_t i = 0; i < count; ++i) {
+            const float* row = rows + i * 7;
+            int image = static_cast<int>(row[0]);
+            if (image < 0 || image >= static_cast<int>(batch.size())) continue;
+            if (row[2] <= batch[image].minConfidence) continue;
+            const BlobPacker::Placement& placement = placements[image];
+            results[image].push_back({placement.toImage(cv::Point2f(row[3] * width, row[4] * height)),
+                                      placement.toImage(cv::Point2f(row[5] * width, row[6] * height)), row[2]});
+        }
+    } catch (...) {
+        for (Request& request : batch) request.result.set_exception(std::current_exception());
+        return;
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    {
+        std::lock_guard lock(mutex);
+        ++batchCount;
+        processedCount += batch.size();
+        lastBatch = ms;
+        batchTotalMs += ms;
+    }
+    for (size_t i = 0; i < batch.size(); ++i) batch[i].result.set_value(std::move(results[i]));
+}
+
+} // namespace UsArMirror
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/dnn.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "blob_packer.hpp"
+
+namespace UsArMirror {
+
+struct FaceInferenceOptions {
+    std::string prototxt = "deploy.prototxt";
+    std::string model = "res10_300x300_ssd_iter_140000.caffemodel";
+    /// Network input and the mean subtracted from it, BGR.
+    cv::Size inputSize = cv::Size(300, 300);
+    cv::Scalar mean = cv::Scalar(104.0, 177.0, 123.0);
+    /// Keep the aspect ratio of submitted images, padding with the mean,
+    /// rather than stretching them to the input size.
+    bool letterbox = true;
+    int backend = cv::dnn::DNN_BACKEND_DEFAULT;
+    int target = cv::dnn::DNN_TARGET_CPU;
+    /// OpenCV worker threads for the forward pass; 0 keeps OpenCV's
+    /// default. This is cv::setNumThreads(), so it is process-wide.
+    int threads = 0;
+    /// Most images per forward() call.
+    size_t maxBatch = 4;
+    /// After the first request arrives, wait this long for requests from
+    /// other cameras to share the batch. 0 batches only what is queued.
+    std::chrono::microseconds batchWindow{0};
+};
+
+/// The res10 SSD face detector, loaded once and shared by every camera.
+///
+/// submit() queues an image and returns a future; a worker thread packs
+/// the queued images into one preallocated input blob (BlobPacker), runs
+/// one forward() call and fulfils each future with that image's
+/// detections. Images are CV_8UC3 BGR of any size; for speed, pass the
+/// smallest pyramid level still larger than the input, e.g.
+/// DerivedImages::half() for VGA frames.
+class FaceInference {
+public:
+    struct Detection {
+        /// Corners in pixels of the submitted image.
+        cv::Point2f topLeft;
+        cv::Point2f bottomRight;
+        float confidence = 0.0f;
+    };
+
+    struct Metrics {
+        /// Requests waiting for a batch right now.
+        size_t queueDepth = 0;
+        uint64_t requests = 0;
+        uint64_t batches = 0;
+        /// Wall time of the last batch, packing and forward() together.
+        double lastBatchMs = 0.0;
+        double averageBatchMs = 0.0;
+        double averageBatchSize = 0.0;
+    };
+
+    explicit FaceInference(const FaceInferenceOptions& options = FaceInferenceOptions());
+    ~FaceInference();
+
+    FaceInference(const FaceInference&) = delete;
+    FaceInference& operator=(const FaceInference&) = delete;
+
+    /// Process-wide detector with default options, created on first use.
+    static std::shared_ptr<FaceInference> shared();
+
+    /// Queue `image` for detection; the future holds the detections above
+    /// `minConfidence`, or the exception the forward pass threw. `image`
+    /// must stay unchanged until the future is ready.
+    std::future<std::vector<Detection>> submit(const cv::Mat& image, float minConfidence);
+
+    /// Applied before the next batch.
+    void setBackend(int backend, int target);
+    void setThreads(int threads);
+
+    Metrics metrics() const;
+    cv::Size getInputSize() const { return options.inputSize; }
+
+private:
+    struct Request {
+        cv::Mat image;
+        float minConfidence;
+        std::promise<std::vector<Detection>> result;
+    };
+
+    void workerLoop();
+    void runBatch(std::vector<Request>& batch);
+
+    FaceInferenceOptions options;
+    cv::dnn::Net net;
+
+    // Worker thread only; reused by every batch.
+    BlobPacker packer;
+    std::vector<BlobPacker::Placement> placements;
+    std::vector<cv::Mat> outputs;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Request> queue;
+    bool stopping = false;
+    bool settingsChanged = true;
+
+    // Metrics, under `mutex`
+    uint64_t requestCount = 0;
+    uint64_t batchCount = 0;
+    uint64_t processedCount = 0;
+    double lastBatch = 0.0;
+    double batchTotalMs = 0.0;
+
+    std::thread worker;
+};
+
+} // namespace UsArMirror
@@ -0,0 +1,97 @@
+#include "face_prefilter.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+
+#include "derived_images.hpp"
+
+namespace UsArMirror {
+
+void mergeOverlapping(std::vector<cv::Rect>& regions) {
+    regions.erase(std::remove_if(regions.begin(), regions.end(), [](const cv::Rect& r) { return r.area() == 0; }),
+                  regions.end());
+    for (bool merged = true; merged;) {
+        merged = false;
+        for (size_t i = 0; i < regions.size() && !merged; ++i) {
+            for (size_t j = i + 1; j < regions.size(); ++j) {
+                if ((regions[i] & regions[j]).area() == 0) continue;
+                regions[i] |= regions[j];
+                regions.erase(regions.begin() + static_cast<std::ptrdiff_t>(j));
+                merged = true;
+                break;
+            }
+        }
+    }
+}
+
+FacePrefilter::FacePrefilter(const FacePrefilterOptions& options) : options(options) {}
+
+bool FacePrefilter::load() {
+    if (!cascade.load(options.cascade)) {
+        spdlog::warn("Cannot load face cascade {}; the SSD will search whole frames", options.cascade);
+        return false;
+    }
+    spdlog::info("Loaded face cascade {}", options.cascade);
+    return true;
+}
+
+FacePrefilter::Search FacePrefilter::propose(const DerivedImages& frame, const std::vector<cv::Rect>& previous,
+                                             std::vector<cv::Rect>& regions) {
+    auto start = std::chrono::steady_clock::now();
+    ++callCount;
+    regions.clear();
+    if (!loaded()) return Search::FullFrame;
+
+    const cv::Mat& gray = frame.grayQuarter();
+    cascade.detectMultiScale(gray, candidates, options.scaleFactor, options.minNeighbors, 0,
+                             cv::Size(options.minSize, options.minSize));
+
+    const cv::Size size = frame.bgr().size();
+    const cv::Rect bounds(0, 0, size.width, size.height);
+    const float scaleX = static_cast<float>(size.width) / gray.cols;
+    const float scaleY = static_cast<float>(size.height) / gray.rows;
+    auto pad = [&](const cv::Rect2f& box) {
+        float dx = options.padding * box.width;
+        float dy = options.padding * box.height;
+        return cv::Rect(cv::Rect2f(box.x - dx, box.y - dy, box.width + 2 * dx, box.height + 2 * dy)) & bounds;
+    };
+    for (const cv::Rect& candidate : candidates) {
+        regions.push_back(pad(cv::Rect2f(candidate.x * scaleX, candidate.y * scaleY, candidate.width * scaleX,
+                                         candidate.height * scaleY)));
+    }
+    for (const cv::Rect& face : previous) regions.push_back(pad(cv::Rect2f(face)));
+
+    // Overlapping crops would show the SSD the same face twice.
+    mergeOverlapping(regions);
+
+    Search search;
+    int area = 0;
+    for (const cv::Rect& region : regions) area += region.area();
+    if (regions.empty()) {
+        ++idleFrames;
+        if (options.fullFrameInterval > 0 && idleFrames >= options.fullFrameInterval) {
+            idleFrames = 0;
+            search = Search::FullFrame;
+        } else {
+            ++skipCount;
+            search = Search::None;
+        }
+    } else if (2 * area > bounds.area()) {
+        // Crops covering most of the frame cost more than one full pass.
+        idleFrames = 0;
+        regions.clear();
+        search = Search::FullFrame;
+    } else {
+        idleFrames = 0;
+        ++regionCount;
+        search = Search::Regions;
+    }
+
+    lastCost = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return search;
+}
+
+} // namespace UsArMirror
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/objdetect.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace UsArMirror {
+
+class DerivedImages;
+
+struct FacePrefilterOptions {
+    std::string cascade = "haarcascade_frontalface_default.xml";
+    /// detectMultiScale() settings on the quarter-size gray image. Few
+    /// neighbours, since a false candidate only costs one SSD crop.
+    double scaleFactor = 1.2;
+    int minNeighbors = 2;
+    /// Smallest candidate in quarter-size pixels; 12 is a 48 px face in VGA.
+    int minSize = 12;
+    /// Grow each candidate by this share of its size on every side before
+    /// cropping, so the SSD sees the whole head.
+    float padding = 0.5f;
+    /// With no candidates, still run the SSD on the whole frame every this
+    /// many frames, for faces the frontal cascade misses (turned heads,
+    /// poor light). 0 never does.
+    int fullFrameInterval = 30;
+};
+
+/// Replace rectangles that overlap by their bounding box until none do;
+/// empty ones are dropped.
+void mergeOverlapping(std::vector<cv::Rect>& regions);
+
+/// Cheap first tier of face detection: proposes where the SSD should look.
+///
+/// A Haar cascade runs on DerivedImages::grayQuarter(); its hits and the
+/// last detected faces, padded and merged where they overlap, are the
+/// regions to run the SSD on. With nothing to propose the SSD is skipped,
+/// except for a full-frame run every fullFrameInterval frames.
+class FacePrefilter {
+public:
+    enum class Search {
+        /// Nothing to look at: skip the SSD.
+        None,
+        /// Run the SSD on the proposed regions only.
+        Regions,
+        /// Run the SSD on the whole frame.
+        FullFrame,
+    };
+
+    explicit FacePrefilter(const FacePrefilterOptions& options = FacePrefilterOptions());
+
+    /// Load the cascade; false, and a warning, if it cannot be read.
+    bool load();
+    bool loaded() const { return !cascade.empty(); }
+
+    /// Decide where to look in `frame`. `previous` are the faces found last
+    /// time, in frame pixels, and are always proposed again; `regions`
+    /// receives frame-pixel rectangles when the answer is Regions.
+    Search propose(const DerivedImages& frame, const std::vector<cv::Rect>& previous, std::vector<cv::Rect>& regions);
+
+    void setFullFrameInterval(int frames) { options.fullFrameInterval = frames; }
+    const FacePrefilterOptions& getOptions() const { return options; }
+
+    /// Wall time of the last propose() call.
+    double lastCostMs() const { return lastCost; }
+    /// propose() calls so far, and how many of those skipped the SSD or
+    /// narrowed it to regions.
+    uint64_t calls() const { return callCount; }
+    uint64_t skipped() const { return skipCount; }
+    uint64_t narrowed() const { return regionCount; }
+
+private:
+    FacePrefilterOptions options;
+    cv::CascadeClassifier cascade;
+    int idleFrames = 0;
+    double lastCost = 0.0;
+
+    uint64_t callCount = 0;
+    uint64_t skipCount = 0;
+    uint64_t regionCount = 0;
+
+    // Scratch
+    std::vector<cv::Rect> candidates;
+};
+
+} // namespace UsArMirror
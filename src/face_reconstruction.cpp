@@ -9,6 +9,8 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <spdlog/spdlog.h>
 
+#include "ray_table.hpp"
+
 namespace UsArMirror {
 
 using namespace eos;
@@ -154,27 +156,13 @@ void FaceReconstruction::fitAndRender(
 
     // Step 2: Convert to eos landmarks
     eos::core::LandmarkCollection<Eigen::Vector2f> landmarks;
-    std::vector<Eigen::Vector3f> depth_points;
+    std::vector<cv::Point2f> pixels;
+    std::vector<float> depths;
     for (int i = 0; i < shape.num_parts(); ++i) {
         float x = static_cast<float>(shape.part(i).x());
         float y = static_cast<float>(shape.part(i).y());
-        float depth = depthFrame.get_distance((int)x, (int)y);
-
-        // Backproject using intrinsics (from pixel to 3D)
-        float point3D[3];
-        float pixel[2] = { x, y };
-        cv::Point2f pixel_uv; // (u, v)
-
-        float fx = cameraIntrinsics.at<float>(0, 0);
-        float fy = cameraIntrinsics.at<float>(1, 1);
-        float cx = cameraIntrinsics.at<float>(0, 2);
-        float cy = cameraIntrinsics.at<float>(1, 2);
-
-        point3D[0] = (pixel_uv.x - cx) * depth / fx;
-        point3D[1] = (pixel_uv.y - cy) * depth / fy;
-        point3D[2] = depth;
-
-        depth_points.emplace_back(point3D[0], point3D[1], point3D[2]);
+        pixels.emplace_back(x, y);
+        depths.push_back(depthFrame.get_distance((int)x, (int)y));
 
         eos::core::Landmark<Eigen::Vector2f> lm;
         lm.name = std::to_string(i + 1);
@@ -182,6 +170,19 @@ void FaceReconstruction::fitAndRender(
         landmarks.push_back(lm);
 
     }
+
+    // Backproject using intrinsics (from pixel to 3D), all landmarks at once
+    StreamIntrinsics colorIntrinsics;
+    colorIntrinsics.fx = cameraIntrinsics.at<float>(0, 0);
+    colorIntrinsics.fy = cameraIntrinsics.at<float>(1, 1);
+    colorIntrinsics.cx = cameraIntrinsics.at<float>(0, 2);
+    colorIntrinsics.cy = cameraIntrinsics.at<float>(1, 2);
+    colorIntrinsics.width = colorImage.cols;
+    colorIntrinsics.height = colorImage.rows;
+    std::vector<cv::Point3f> points(pixels.size());
+    RayTable::get(colorIntrinsics)->backProject(pixels.data(), depths.data(), pixels.size(), points.data());
+    std::vector<Eigen::Vector3f> depth_points;
+    for (const cv::Point3f& p : points) depth_points.emplace_back(p.x, p.y, p.z);
     spdlog::info("[fitAndRender] Converted to eos::LandmarkCollection.");
 
     // Step 3: Fit shape and pose
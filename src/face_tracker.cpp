@@ -0,0 +1,148 @@
+#include "face_tracker.hpp"
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/video/tracking.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "derived_images.hpp"
+
+namespace UsArMirror {
+
+namespace {
+
+float median(std::vector<float>& values) {
+    auto middle = values.begin() + values.size() / 2;
+    std::nth_element(values.begin(), middle, values.end());
+    return *middle;
+}
+
+} // namespace
+
+FaceTracker::FaceTracker(const FaceTrackerOptions& options)
+    : options(options), scale(options.halfResolution ? 0.5f : 1.0f) {}
+
+void FaceTracker::reset() {
+    tracks.clear();
+    previous.release();
+    framesSinceDetection = 0;
+    lost = true;
+    lastConfidence = 0.0f;
+}
+
+const cv::Mat& FaceTracker::trackingImage(const DerivedImages& frame) const {
+    return options.halfResolution ? frame.grayHalf() : frame.gray();
+}
+
+bool FaceTracker::needsDetection() const {
+    return lost || tracks.empty() || framesSinceDetection + 1 >= std::max(options.detectInterval, 1);
+}
+
+void FaceTracker::setDetections(const DerivedImages& frame, const std::vector<cv::Rect>& faces,
+                                std::optional<double> detectMs) {
+    if (detectMs) {
+        ++detectCount;
+        detectTotalMs += *detectMs;
+    }
+
+    const cv::Mat& gray = trackingImage(frame);
+    const cv::Rect bounds(0, 0, gray.cols, gray.rows);
+    tracks.clear();
+    for (const cv::Rect& face : faces) {
+        Track track;
+        track.box = cv::Rect2f(face.x * scale, face.y * scale, face.width * scale, face.height * scale);
+        // Corners from the inner part of the box: its edges are mostly
+        // background, which does not move with the face.
+        cv::Rect2f inner(track.box.x + 0.15f * track.box.width, track.box.y + 0.1f * track.box.height,
+                         0.7f * track.box.width, 0.8f * track.box.height);
+        cv::Rect roi = cv::Rect(inner) & bounds;
+        if (roi.width < 8 || roi.height < 8) continue;
+        cv::goodFeaturesToTrack(gray(roi), track.points, options.maxCorners, options.cornerQuality,
+                                options.minCornerDistance);
+        for (auto& point : track.points) point += cv::Point2f(static_cast<float>(roi.x), static_cast<float>(roi.y));
+        track.initialPoints = track.points.size();
+        if (track.initialPoints >= 4) tracks.push_back(std::move(track));
+    }
+    previous = gray;
+    framesSinceDetection = 0;
+    lost = tracks.size() != faces.size();
+    lastConfidence = lost ? 0.0f : 1.0f;
+}
+
+bool FaceTracker::track(const DerivedImages& frame, std::vector<cv::Rect>& faces) {
+    auto start = std::chrono::steady_clock::now();
+    faces.clear();
+    const cv::Mat& gray = trackingImage(frame);
+    if (tracks.empty() || previous.empty() || previous.size() != gray.size()) {
+        lost = true;
+        lastConfidence = 0.0f;
+        return false;
+    }
+
+    std::vector<float> dx, dy, ratios;
+    float confidence = 1.0f;
+    for (Track& track : tracks) {
+        cv::calcOpticalFlowPyrLK(previous, gray, track.points, next, status, error, options.window,
+                                 options.pyramidLevels);
+        cv::calcOpticalFlowPyrLK(gray, previous, next, back, backStatus, error, options.window,
+                                 options.pyramidLevels);
+
+        std::vector<cv::Point2f> kept, from;
+        dx.clear();
+        dy.clear();
+        for (size_t i = 0; i < track.points.size(); ++i) {
+            if (!status[i] || !backStatus[i]) continue;
+            cv::Point2f roundTrip = back[i] - track.points[i];
+            if (std::hypot(roundTrip.x, roundTrip.y) > options.maxForwardBackwardError) continue;
+            from.push_back(track.points[i]);
+            kept.push_back(next[i]);
+            dx.push_back(next[i].x - track.points[i].x);
+            dy.push_back(next[i].y - track.points[i].y);
+        }
+        confidence = std::min(confidence, static_cast<float>(kept.size()) / static_cast<float>(track.initialPoints));
+        if (kept.size() < 4) {
+            confidence = 0.0f;
+            break;
+        }
+
+        // Scale change: median ratio of distances between corner pairs.
+        ratios.clear();
+        for (size_t i = 0; i < kept.size(); ++i) {
+            for (size_t j = i + 1; j < kept.size(); ++j) {
+                float before = std::hypot(from[i].x - from[j].x, from[i].y - from[j].y);
+                if (before < 1.0f) continue;
+                ratios.push_back(std::hypot(kept[i].x - kept[j].x, kept[i].y - kept[j].y) / before);
+            }
+        }
+        float growth = ratios.empty() ? 1.0f : median(ratios);
+        cv::Point2f center(track.box.x + 0.5f * track.box.width + median(dx),
+                           track.box.y + 0.5f * track.box.height + median(dy));
+        track.box.width *= growth;
+        track.box.height *= growth;
+        track.box.x = center.x - 0.5f * track.box.width;
+        track.box.y = center.y - 0.5f * track.box.height;
+        track.points = std::move(kept);
+    }
+
+    previous = gray;
+    ++framesSinceDetection;
+    lastConfidence = confidence;
+    lost = confidence < options.minConfidence;
+    if (!lost) {
+        for (const Track& track : tracks) {
+            faces.emplace_back(static_cast<int>(std::lround(track.box.x / scale)),
+                               static_cast<int>(std::lround(track.box.y / scale)),
+                               static_cast<int>(std::lround(track.box.width / scale)),
+                               static_cast<int>(std::lround(track.box.height / scale)));
+        }
+    }
+
+    lastCost = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    trackTotalMs += lastCost;
+    if (!lost) ++trackCount;
+    return !lost;
+}
+
+} // namespace UsArMirror
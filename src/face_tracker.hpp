@@ -0,0 +1,112 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace UsArMirror {
+
+class DerivedImages;
+
+struct FaceTrackerOptions {
+    /// Run the face detector at least every `detectInterval` frames and
+    /// track the boxes in between; 1 detects on every frame.
+    int detectInterval = 5;
+    /// Detect again as soon as the share of corners still tracked falls
+    /// below this.
+    float minConfidence = 0.6f;
+
+    /// Corners picked inside each face box for KLT.
+    int maxCorners = 40;
+    double cornerQuality = 0.01;
+    double minCornerDistance = 4.0;
+    /// Track on the half-size gray image: a quarter of the pixels, and
+    /// faces are large enough that boxes barely lose precision.
+    bool halfResolution = true;
+    cv::Size window = cv::Size(15, 15);
+    int pyramidLevels = 2;
+    /// Corners that do not come back to within this many pixels when
+    /// tracked backwards are dropped.
+    float maxForwardBackwardError = 1.0f;
+};
+
+/// Carries face boxes from one detector run to the next.
+///
+/// After a detection, corners inside each box are tracked frame to frame
+/// with pyramidal Lucas-Kanade, checked forwards and backwards, and each
+/// box follows the median shift and median scale change of its corners
+/// (median flow). Confidence is the share of the box's corners that
+/// survived since the detection.
+class FaceTracker {
+public:
+    explicit FaceTracker(const FaceTrackerOptions& options = FaceTrackerOptions());
+
+    /// Whether the next frame needs the detector: nothing tracked,
+    /// confidence too low, or detectInterval frames since the last run.
+    bool needsDetection() const;
+
+    /// Restart tracking from detector output; `faces` in frame pixels,
+    /// `detectMs` the detector's cost, kept for the savings estimate.
+    /// Without `detectMs` the detector did not run (e.g. nobody in the
+    /// depth band) and the call is not counted as a detection.
+    void setDetections(const DerivedImages& frame, const std::vector<cv::Rect>& faces,
+                       std::optional<double> detectMs);
+
+    /// Move the boxes into `frame`. Returns false, and clears `faces`,
+    /// when any face was lost or confidence fell below minConfidence.
+    bool track(const DerivedImages& frame, std::vector<cv::Rect>& faces);
+
+    void reset();
+
+    /// Adjust scheduling without losing the tracks.
+    void setDetectInterval(int frames) { options.detectInterval = frames; }
+    void setMinConfidence(float confidence) { options.minConfidence = confidence; }
+    const FaceTrackerOptions& getOptions() const { return options; }
+
+    /// Lowest confidence over the tracked faces.
+    float confidence() const { return lastConfidence; }
+    /// Wall time of the last track() call.
+    double lastCostMs() const { return lastCost; }
+
+    /// Detector runs and frames served by tracking alone so far.
+    uint64_t detections() const { return detectCount; }
+    uint64_t trackedFrames() const { return trackCount; }
+    double averageDetectMs() const { return detectCount ? detectTotalMs / detectCount : 0.0; }
+    /// Detector time the tracked frames did not spend, less the time spent
+    /// tracking, including attempts that lost the face.
+    double savedMs() const { return trackCount * averageDetectMs() - trackTotalMs; }
+
+private:
+    struct Track {
+        cv::Rect2f box;
+        std::vector<cv::Point2f> points;
+        size_t initialPoints = 0;
+    };
+
+    const cv::Mat& trackingImage(const DerivedImages& frame) const;
+
+    FaceTrackerOptions options;
+    float scale = 1.0f;
+    cv::Mat previous;
+    std::vector<Track> tracks;
+    int framesSinceDetection = 0;
+    bool lost = true;
+    float lastConfidence = 0.0f;
+    double lastCost = 0.0;
+
+    uint64_t detectCount = 0;
+    uint64_t trackCount = 0;
+    double detectTotalMs = 0.0;
+    double trackTotalMs = 0.0;
+
+    // Scratch
+    std::vector<cv::Point2f> next;
+    std::vector<cv::Point2f> back;
+    std::vector<uint8_t> status;
+    std::vector<uint8_t> backStatus;
+    std::vector<float> error;
+};
+
+} // namespace UsArMirror
@@ -0,0 +1,133 @@
+#include "frame_handle.hpp"
+
+#include <cstdlib>
+#include <new>
+#include <unistd.h>
+
+namespace UsArMirror {
+
+namespace {
+size_t pageSize() {
+    static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+size_t roundUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+} // namespace
+
+struct FramePool::Blocks {
+    std::mutex mutex;
+    std::vector<void*> all;
+    std::vector<void*> free;
+    size_t blockSize = 0;
+    std::atomic<uint64_t> misses{0};
+
+    ~Blocks() {
+        for (void* block : all) std::free(block);
+    }
+};
+
+FrameHandle FrameHandle::fromSensor(const rs2::video_frame& frame, int type) {
+    FrameHandle handle;
+    handle.sensorFrame = frame;
+    handle.view = cv::Mat(frame.get_height(), frame.get_width(), type,
+                          const_cast<void*>(frame.get_data()), frame.get_stride_in_bytes());
+    handle.setTiming(frame.get_timestamp(), frame.get_frame_number(), Clock::now());
+    return handle;
+}
+
+FrameHandle FrameHandle::fromMat(const cv::Mat& mat) {
+    FrameHandle handle;
+    handle.view = mat;
+    return handle;
+}
+
+FrameHandle FrameHandle::fromBuffer(const cv::Mat& view, std::shared_ptr<void> owner) {
+    FrameHandle handle;
+    handle.storage = std::move(owner);
+    handle.view = view;
+    return handle;
+}
+
+void FrameHandle::setTiming(double timestampMs, uint64_t frameNumber, Clock::time_point arrivalTime) {
+    this->timestampMs = timestampMs;
+    number = frameNumber;
+    arrival = arrivalTime;
+}
+
+FrameHandle FrameHandle::detach(FramePool& pool) const {
+    if (empty()) return FrameHandle();
+    FrameHandle copy = pool.copy(view);
+    copy.setTiming(timestampMs, number, arrival);
+    return copy;
+}
+
+FramePool::FramePool(size_t blockSize, size_t blockCount) : blocks(std::make_shared<Blocks>()) {
+    blocks->blockSize = roundUp(blockSize, pageSize());
+    if (blocks->blockSize == 0) return;
+    blocks->all.reserve(blockCount);
+    blocks->free.reserve(blockCount);
+    for (size_t i = 0; i < blockCount; ++i) {
+        void* block = std::aligned_alloc(pageSize(), blocks->blockSize);
+        if (!block) throw std::bad_alloc();
+        blocks->all.push_back(block);
+        blocks->free.push_back(block);
+    }
+}
+
+FramePool::~FramePool() = default;
+
+FrameHandle FramePool::allocate(int rows, int cols, int type) {
+    size_t bytes = static_cast<size_t>(rows) * cols * CV_ELEM_SIZE(type);
+    void* block = nullptr;
+    if (bytes <= blocks->blockSize) {
+        std::lock_guard lock(blocks->mutex);
+        if (!blocks->free.empty()) {
+            block = blocks->free.back();
+            blocks->free.pop_back();
+        }
+    }
+
+    FrameHandle handle;
+    if (!block) {
+        blocks->misses.fetch_add(1, std::memory_order_relaxed);
+        handle.view = cv::Mat(rows, cols, type);
+        return handle;
+    }
+
+    // The deleter keeps the block list alive, so handles may outlive the pool.
+    std::shared_ptr<Blocks> owner = blocks;
+    handle.storage = std::shared_ptr<void>(block, [owner](void* ptr) {
+        std::lock_guard lock(owner->mutex);
+        owner->free.push_back(ptr);
+    });
+    handle.view = cv::Mat(rows, cols, type, block);
+    return handle;
+}
+
+FrameHandle FramePool::copy(const cv::Mat& src) {
+    FrameHandle handle = allocate(src.rows, src.cols, src.type());
+    src.copyTo(handle.view);
+    return handle;
+}
+
+size_t FramePool::blockSize() const {
+    return blocks->blockSize;
+}
+
+size_t FramePool::blockCount() const {
+    return blocks->all.size();
+}
+
+size_t FramePool::available() const {
+    std::lock_guard lock(blocks->mutex);
+    return blocks->free.size();
+}
+
+uint64_t FramePool::misses() const {
+    return blocks->misses.load(std::memory_order_relaxed);
+}
+
+} // namespace UsArMirror
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <librealsense2/rs.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace UsArMirror {
+
+class FramePool;
+class DerivedImages;
+
+/// Cheap, copyable handle to an image buffer.
+///
+/// The pixels are owned by whatever backs the handle: a librealsense frame
+/// (kept alive through its own refcount), a block borrowed from a FramePool,
+/// or a regular refcounted cv::Mat. Copying a handle never copies pixels, and
+/// `mat()` is a view that stays valid for as long as any copy of the handle
+/// is alive.
+class FrameHandle {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    FrameHandle() = default;
+
+    /// Wrap a librealsense video frame without copying it. Timing is taken
+    /// from the frame and the arrival time is set to now.
+    static FrameHandle fromSensor(const rs2::video_frame& frame, int type);
+    /// Share an existing cv::Mat buffer.
+    static FrameHandle fromMat(const cv::Mat& mat);
+    /// View into memory kept alive by `owner` (e.g. a file mapping).
+    static FrameHandle fromBuffer(const cv::Mat& view, std::shared_ptr<void> owner);
+
+    bool empty() const { return view.empty(); }
+    explicit operator bool() const { return !empty(); }
+
+    const cv::Mat& mat() const { return view; }
+    /// Writable view, for the producer filling a freshly allocated handle.
+    cv::Mat& mat() { return view; }
+
+    const uint8_t* data() const { return view.data; }
+    size_t sizeBytes() const { return view.empty() ? 0 : view.step[0] * view.rows; }
+
+    /// Capture time in milliseconds on the device clock (librealsense
+    /// get_timestamp(), V4L2 buffer time for webcams), 0 if unknown.
+    double timestamp() const { return timestampMs; }
+    /// Device frame counter, 0 if unknown.
+    uint64_t frameNumber() const { return number; }
+    /// Host time at which the capture thread received the frame.
+    Clock::time_point arrivalTime() const { return arrival; }
+    void setTiming(double timestampMs, uint64_t frameNumber, Clock::time_point arrivalTime);
+
+    /// The librealsense frame backing this handle, empty if not sensor backed.
+    const rs2::frame& sensor() const { return sensorFrame; }
+    bool isSensorBacked() const { return static_cast<bool>(sensorFrame); }
+
+    /// Copy the pixels (and timing) into `pool` and drop the reference on the
+    /// backing buffer, e.g. to hand a sensor frame back to librealsense early.
+    FrameHandle detach(FramePool& pool) const;
+
+private:
+    friend class FramePool;
+
+    rs2::frame sensorFrame;
+    std::shared_ptr<void> storage;
+    cv::Mat view;
+
+    double timestampMs = 0.0;
+    uint64_t number = 0;
+    Clock::time_point arrival;
+};
+
+/// Color and depth taken from the same frameset.
+struct DepthCameraFrame {
+    FrameHandle color;
+    FrameHandle depth;
+    /// 4x4 CV_32F camera extrinsics known at capture time, usually empty.
+    cv::Mat pose;
+    /// Gray, RGB and downscaled versions of `color`, built on first use
+    /// and shared by every consumer of this frame. Null if not attached.
+    std::shared_ptr<const DerivedImages> derived;
+};
+
+/// Fixed set of preallocated, page-aligned pixel buffers.
+///
+/// Blocks are recycled when the last FrameHandle referencing them goes away,
+/// so steady-state capture does not touch the heap. Requests that do not fit
+/// a block, or arrive while every block is in use, fall back to a regular
+/// allocation and are counted as misses.
+class FramePool {
+public:
+    FramePool(size_t blockSize, size_t blockCount);
+    ~FramePool();
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    /// Uninitialised frame backed by a pooled block when possible.
+    FrameHandle allocate(int rows, int cols, int type);
+    /// Deep copy of `src` into a pooled block.
+    FrameHandle copy(const cv::Mat& src);
+
+    size_t blockSize() const;
+    size_t blockCount() const;
+    size_t available() const;
+    uint64_t misses() const;
+
+private:
+    struct Blocks;
+    std::shared_ptr<Blocks> blocks;
+};
+
+} // namespace UsArMirror
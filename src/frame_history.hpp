@@ -0,0 +1,185 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace UsArMirror {
+
+/// Fixed-capacity history of the last N frames of one source.
+///
+/// Works like TripleBuffer, but keeps every slot addressable by sequence
+/// number instead of only the latest one. Readers pin a slot through a
+/// ReadHandle and read it in place, so holding an old frame costs no copy.
+/// The producer never waits for readers: it overwrites the oldest slot that
+/// nobody has pinned, and drops the frame (counted) if every slot is
+/// pinned. Memory is bounded by N payloads.
+template <typename T, std::size_t N>
+class FrameHistory {
+    static_assert(N >= 2, "FrameHistory needs at least two slots");
+
+    struct Slot {
+        T value{};
+        std::atomic<int> readers{0};
+        /// 0 while empty or being rewritten.
+        std::atomic<uint64_t> sequence{0};
+        double timestampMs = 0.0;
+    };
+
+public:
+    class ReadHandle {
+    public:
+        ReadHandle() = default;
+        ReadHandle(const ReadHandle&) = delete;
+        ReadHandle& operator=(const ReadHandle&) = delete;
+        ReadHandle(ReadHandle&& other) noexcept
+            : slot(std::exchange(other.slot, nullptr)), seq(std::exchange(other.seq, 0)) {}
+        ReadHandle& operator=(ReadHandle&& other) noexcept {
+            if (this != &other) {
+                release();
+                slot = std::exchange(other.slot, nullptr);
+                seq = std::exchange(other.seq, 0);
+            }
+            return *this;
+        }
+        ~ReadHandle() { release(); }
+
+        explicit operator bool() const { return slot != nullptr; }
+        const T& operator*() const { return slot->value; }
+        const T* operator->() const { return &slot->value; }
+        /// Sequence number of the held frame, 0 if the handle is empty.
+        uint64_t sequence() const { return seq; }
+        /// Timestamp given to push(), in milliseconds.
+        double timestamp() const { return slot ? slot->timestampMs : 0.0; }
+
+        void release() {
+            if (slot) {
+                slot->readers.fetch_sub(1, std::memory_order_release);
+                slot = nullptr;
+                seq = 0;
+            }
+        }
+
+    private:
+        friend class FrameHistory;
+        ReadHandle(Slot* slot, uint64_t seq) : slot(slot), seq(seq) {}
+        Slot* slot = nullptr;
+        uint64_t seq = 0;
+    };
+
+    FrameHistory() = default;
+    FrameHistory(const FrameHistory&) = delete;
+    FrameHistory& operator=(const FrameHistory&) = delete;
+
+    static constexpr std::size_t capacity() { return N; }
+
+    /// Store `value` as frame `sequence` (non-zero, increasing). Producer
+    /// thread only. Returns false if every slot was pinned.
+    bool push(uint64_t sequence, double timestampMs, T value) {
+        // Try the oldest slot first, then the next oldest, and so on.
+        std::array<bool, N> tried{};
+        for (std::size_t attempt = 0; attempt < N; ++attempt) {
+            Slot* victim = nullptr;
+            std::size_t victimIndex = 0;
+            for (std::size_t i = 0; i < N; ++i) {
+                if (tried[i] || slots[i].readers.load(std::memory_order_acquire) != 0) continue;
+                if (!victim || slots[i].sequence.load(std::memory_order_relaxed) <
+                                   victim->sequence.load(std::memory_order_relaxed)) {
+                    victim = &slots[i];
+                    victimIndex = i;
+                }
+            }
+            if (!victim) break;
+            tried[victimIndex] = true;
+
+            // Invalidate, then make sure no reader pinned the slot before it
+            // saw the invalidation.
+            uint64_t old = victim->sequence.exchange(0, std::memory_order_seq_cst);
+            if (victim->readers.load(std::memory_order_seq_cst) != 0) {
+                victim->sequence.store(old, std::memory_order_seq_cst);
+                continue;
+            }
+            if (old != 0) overwritten.fetch_add(1, std::memory_order_relaxed);
+            victim->value = std::move(value);
+            victim->timestampMs = timestampMs;
+            victim->sequence.store(sequence, std::memory_order_seq_cst);
+            newestSequence.store(sequence, std::memory_order_release);
+            return true;
+        }
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    /// Pin frame `sequence` if it is still held.
+    ReadHandle find(uint64_t sequence) const {
+        if (sequence != 0) {
+            for (Slot& slot : slots) {
+                if (ReadHandle handle = pin(slot, sequence)) {
+                    hitCount.fetch_add(1, std::memory_order_relaxed);
+                    return handle;
+                }
+            }
+        }
+        missCount.fetch_add(1, std::memory_order_relaxed);
+        return {};
+    }
+
+    /// Pin the frame `age` sequence numbers before the newest one.
+    ReadHandle latest(std::size_t age = 0) const {
+        uint64_t newest = newestSequence.load(std::memory_order_acquire);
+        return find(newest > age ? newest - age : 0);
+    }
+
+    /// Pin the held frame whose timestamp is closest to `timestampMs`.
+    ReadHandle nearest(double timestampMs) const {
+        ReadHandle best;
+        double bestDistance = 0.0;
+        for (Slot& slot : slots) {
+            ReadHandle handle = pin(slot, 0);
+            if (!handle) continue;
+            double distance = std::abs(handle.timestamp() - timestampMs);
+            if (!best || distance < bestDistance) {
+                best = std::move(handle);
+                bestDistance = distance;
+            }
+        }
+        (best ? hitCount : missCount).fetch_add(1, std::memory_order_relaxed);
+        return best;
+    }
+
+    /// Sequence number of the newest frame, 0 if none yet.
+    uint64_t newest() const { return newestSequence.load(std::memory_order_acquire); }
+
+    /// Lookups that found / did not find their frame.
+    uint64_t hits() const { return hitCount.load(std::memory_order_relaxed); }
+    uint64_t misses() const { return missCount.load(std::memory_order_relaxed); }
+    /// Frames evicted to make room for newer ones.
+    uint64_t overwrites() const { return overwritten.load(std::memory_order_relaxed); }
+    /// Frames not stored because readers had pinned every slot.
+    uint64_t droppedFrames() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    /// Pin `slot` if it holds `sequence`, or any frame when `sequence` is 0.
+    static ReadHandle pin(Slot& slot, uint64_t sequence) {
+        if (slot.sequence.load(std::memory_order_acquire) == 0) return {};
+        slot.readers.fetch_add(1, std::memory_order_seq_cst);
+        // The producer invalidates a slot before rewriting it, so a pinned
+        // slot that still carries a sequence number is complete.
+        uint64_t held = slot.sequence.load(std::memory_order_seq_cst);
+        if (held != 0 && (sequence == 0 || held == sequence)) return ReadHandle(&slot, held);
+        slot.readers.fetch_sub(1, std::memory_order_release);
+        return {};
+    }
+
+    mutable std::array<Slot, N> slots;
+    std::atomic<uint64_t> newestSequence{0};
+    std::atomic<uint64_t> overwritten{0};
+    std::atomic<uint64_t> dropped{0};
+    mutable std::atomic<uint64_t> hitCount{0};
+    mutable std::atomic<uint64_t> missCount{0};
+};
+
+} // namespace UsArMirror
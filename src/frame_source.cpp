@@ -0,0 +1,79 @@
+#include "frame_source.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <stdexcept>
+#include <thread>
+
+#include "image_sequence_source.hpp"
+#include "realsense_source.hpp"
+#include "recording.hpp"
+#include "scene_source.hpp"
+#include "synthetic_source.hpp"
+#include "v4l2_source.hpp"
+#include "video_source.hpp"
+
+namespace UsArMirror {
+
+namespace {
+bool startsWith(const std::string& text, const std::string& prefix) {
+    return text.compare(0, prefix.size(), prefix) == 0;
+}
+} // namespace
+
+std::unique_ptr<FrameSource> openFrameSource(const std::string& spec, const FrameSourceOptions& options) {
+    std::unique_ptr<FrameSource> source;
+    if (spec == "realsense") {
+        source = std::make_unique<RealSenseSource>(options);
+    } else if (startsWith(spec, "v4l2:")) {
+        int index = std::stoi(spec.substr(5));
+        if (options.fourcc == "MJPG") {
+            try {
+                source = std::make_unique<V4l2MjpegSource>(index, options);
+            } catch (const std::runtime_error& e) {
+                spdlog::warn("Native MJPEG capture unavailable ({}), using cv::VideoCapture", e.what());
+            }
+        }
+        if (!source) source = std::make_unique<VideoCaptureSource>(index, options);
+    } else if (startsWith(spec, "opencv:")) {
+        source = std::make_unique<VideoCaptureSource>(std::stoi(spec.substr(7)), options);
+    } else if (startsWith(spec, "video:")) {
+        source = std::make_unique<VideoCaptureSource>(spec.substr(6), options);
+    } else if (startsWith(spec, "images:")) {
+        source = std::make_unique<ImageSequenceSource>(spec.substr(7), options);
+    } else if (startsWith(spec, "recording:")) {
+        source = std::make_unique<RecordingSource>(spec.substr(10), options);
+    } else if (startsWith(spec, "scene:")) {
+        source = std::make_unique<SceneSource>(spec.substr(6), options);
+    } else if (spec == "synthetic") {
+        source = std::make_unique<SyntheticSource>(options);
+    } else {
+        throw std::runtime_error("Unknown frame source: " + spec);
+    }
+
+    const SourceCapabilities& caps = source->capabilities();
+    spdlog::info("Opened frame source {}: {}x{} @ {:.1f} fps, depth={}, live={}", source->name(),
+                 caps.streams.color.width, caps.streams.color.height, caps.fps, caps.hasDepth, caps.live);
+    return source;
+}
+
+size_t poolBlockCount(const FrameSourceOptions& options, size_t inFlight, size_t streams) {
+    constexpr size_t consumerSlots = 3 + 1;
+    constexpr size_t spareHandles = 4;
+    return streams * (consumerSlots + inFlight + options.retainedFrames) + spareHandles;
+}
+
+void FramePacer::wait(double timestampMs) {
+    if (!started) {
+        started = true;
+        firstTimestamp = timestampMs;
+        start = std::chrono::steady_clock::now();
+        return;
+    }
+    if (mode != SourcePace::RealTime) return;
+
+    auto offset = std::chrono::duration<double, std::milli>(timestampMs - firstTimestamp);
+    std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(offset));
+}
+
+} // namespace UsArMirror
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "frame_handle.hpp"
+
+namespace UsArMirror {
+
+/// Pinhole model of one stream, Brown-Conrady distortion.
+struct StreamIntrinsics {
+    float fx = 0.0f;
+    float fy = 0.0f;
+    float cx = 0.0f;
+    float cy = 0.0f;
+    int width = 0;
+    int height = 0;
+    std::array<float, 5> dist = {};
+};
+
+/// Geometry of a color + Z16 depth stream pair.
+struct RgbdStreamInfo {
+    StreamIntrinsics color;
+    StreamIntrinsics depth;
+    /// Meters per Z16 unit.
+    float depthScale = 0.001f;
+    /// Rigid transform from depth to color camera coordinates: row-major
+    /// rotation, translation in meters. Identity for registered sources.
+    std::array<float, 9> depthToColorRotation = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+    std::array<float, 3> depthToColorTranslation = {};
+};
+
+/// How a non-live source hands out frames.
+enum class SourcePace {
+    RealTime,    // honour the recorded / nominal frame spacing
+    Unthrottled, // deliver as fast as frames can be produced; slow readers skip frames
+    Lockstep,    // like Unthrottled, but the consumer waits until detection took each frame
+};
+
+/// What a FrameSource delivers.
+struct SourceCapabilities {
+    bool hasDepth = false;
+    /// Frames come from hardware as they happen.
+    bool live = false;
+    /// Frames carry the camera extrinsics (recordings).
+    bool hasPose = false;
+    double fps = 30.0;
+    RgbdStreamInfo streams;
+};
+
+/// Everything a backend may need to open its stream. Backends ignore the
+/// fields that do not apply to them.
+struct FrameSourceOptions {
+    int width = 640;
+    int height = 480;
+    double fps = 30.0;
+    SourcePace pace = SourcePace::RealTime;
+    bool loop = true;
+    /// cv::RotateFlags applied to every color frame.
+    std::optional<int> rotateCode;
+    /// V4L2 pixel format requested from webcams. MJPG selects the native
+    /// V4L2 backend with parallel decoding.
+    std::string fourcc = "MJPG";
+    /// Native MJPEG capture: decode workers, and a 1/2/4/8 downscale applied
+    /// during decoding for consumers that only run detection.
+    int decodeThreads = 2;
+    int decodeScale = 1;
+    /// Image sequences: decode every file up front so disk and PNG decode
+    /// stay out of throughput measurements.
+    bool preload = false;
+    /// Frames the consumer keeps beyond its buffer slots, e.g. in a
+    /// FrameHistory. Pooled backends add them to their pool size.
+    size_t retainedFrames = 0;
+};
+
+/// FramePool blocks a pooled backend needs so that steady capture never
+/// falls back to the heap: per stream, the consumer's TripleBuffer slots
+/// plus the frame it is reading, `inFlight` frames inside the backend and
+/// options.retainedFrames; plus a few handles held elsewhere, e.g. by
+/// FrameSynchronizer.
+size_t poolBlockCount(const FrameSourceOptions& options, size_t inFlight, size_t streams = 1);
+
+/// A stream of color (and optionally depth) frames.
+///
+/// Implementations own their device or file and produce zero-copy
+/// FrameHandles with device timestamps and host arrival times. read() is
+/// only ever called from one thread.
+class FrameSource {
+public:
+    virtual ~FrameSource() = default;
+
+    virtual std::string name() const = 0;
+    virtual const SourceCapabilities& capabilities() const = 0;
+
+    /// Block until the next frame is ready. Returns false on timeout, on a
+    /// device error or at the end of a finite stream.
+    virtual bool read(DepthCameraFrame& frame, std::chrono::milliseconds timeout) = 0;
+
+    /// True once a non-looping source has delivered its last frame.
+    virtual bool finished() const { return false; }
+    virtual SourcePace pace() const { return SourcePace::RealTime; }
+};
+
+/// Open a source from a spec string:
+///   realsense              RealSense color + depth
+///   v4l2:<index>           webcam; native MJPEG capture, else cv::VideoCapture
+///   opencv:<index>         webcam through cv::VideoCapture only
+///   video:<path>           video file, e.g. video:video.mp4
+///   images:<glob>          image sequence, e.g. images:captured_images/rs/*.png
+///   recording:<path>       file written by RecordingWriter
+///   synthetic              generated color + depth test pattern
+///   scene:<path>           glTF model rendered to color + depth with
+///                          ground-truth pose, e.g. scene:face_masks.glb
+/// Throws std::runtime_error for unknown specs or sources that fail to open.
+std::unique_ptr<FrameSource> openFrameSource(const std::string& spec, const FrameSourceOptions& options);
+
+/// Sleeps a non-live source so that frames come out at their recorded pace.
+class FramePacer {
+public:
+    explicit FramePacer(SourcePace pace) : mode(pace) {}
+
+    /// Wait until the frame stamped `timestampMs` is due. The first frame
+    /// after construction or restart() is due immediately.
+    void wait(double timestampMs);
+    void restart() { started = false; }
+
+private:
+    SourcePace mode;
+    bool started = false;
+    double firstTimestamp = 0.0;
+    std::chrono::steady_clock::time_point start;
+};
+
+} // namespace UsArMirror
@@ -0,0 +1,108 @@
+#include "frame_sync.hpp"
+
+#include <cmath>
+#include <spdlog/spdlog.h>
+
+namespace UsArMirror {
+
+namespace {
+double millisBetween(FrameHandle::Clock::time_point from, FrameHandle::Clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+} // namespace
+
+FrameSynchronizer::FrameSynchronizer(const std::shared_ptr<DepthCameraInput>& primary,
+                                     const std::shared_ptr<CameraInput>& secondary)
+    : FrameSynchronizer(primary, secondary, Options()) {}
+
+FrameSynchronizer::FrameSynchronizer(const std::shared_ptr<DepthCameraInput>& primary,
+                                     const std::shared_ptr<CameraInput>& secondary, const Options& options)
+    : primary(primary), secondary(secondary), options(options) {
+    spdlog::info("Frame synchronizer started: tolerance={:.1f} ms, history={}", options.toleranceMs,
+                 options.history);
+    syncThread = std::thread(&FrameSynchronizer::syncLoop, this);
+}
+
+FrameSynchronizer::~FrameSynchronizer() {
+    running = false;
+    if (syncThread.joinable()) syncThread.join();
+}
+
+FrameSynchronizer::BundleRef FrameSynchronizer::acquireBundle() const {
+    return bundles.acquire();
+}
+
+FrameSynchronizer::BundleRef FrameSynchronizer::waitForBundle(uint64_t after,
+                                                              std::chrono::milliseconds timeout) const {
+    return bundles.waitNewer(after, timeout);
+}
+
+void FrameSynchronizer::pullSecondary() {
+    CameraInput::FrameRef ref = secondary->acquireFrame();
+    if (!ref || ref.sequence() == lastSecondarySequence) return;
+    lastSecondarySequence = ref.sequence();
+    secondaryHistory.push_back(*ref);
+    while (secondaryHistory.size() > options.history) secondaryHistory.pop_front();
+}
+
+const FrameHandle* FrameSynchronizer::closestSecondary(const FrameHandle& color, double& skewMs) const {
+    const FrameHandle* best = nullptr;
+    for (const FrameHandle& candidate : secondaryHistory) {
+        double skew = millisBetween(color.arrivalTime(), candidate.arrivalTime());
+        if (!best || std::abs(skew) < std::abs(skewMs)) {
+            best = &candidate;
+            skewMs = skew;
+        }
+    }
+    return best;
+}
+
+void FrameSynchronizer::syncLoop() {
+    auto tolerance = std::chrono::duration<double, std::milli>(options.toleranceMs);
+    uint64_t lastPrimarySequence = 0;
+
+    while (running) {
+        DepthCameraFrame frame;
+        {
+            DepthCameraInput::FrameRef ref = primary->waitForFrame(lastPrimarySequence, std::chrono::milliseconds(100));
+            if (!ref) continue;
+            lastPrimarySequence = ref.sequence();
+            frame = *ref;
+        }
+
+        pullSecondary();
+        double skew = 0.0;
+        const FrameHandle* partner = closestSecondary(frame.color, skew);
+
+        // The webcam frame for this instant may still be in flight; give it
+        // until the end of the tolerance window.
+        if (!partner || (std::abs(skew) > options.toleranceMs && skew < 0)) {
+            auto deadline = frame.color.arrivalTime() +
+                            std::chrono::duration_cast<FrameHandle::Clock::duration>(tolerance);
+            auto remaining = deadline - FrameHandle::Clock::now();
+            if (remaining > FrameHandle::Clock::duration::zero()) {
+                auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(remaining) + std::chrono::milliseconds(1);
+                secondary->waitForFrame(lastSecondarySequence, wait);
+                pullSecondary();
+                partner = closestSecondary(frame.color, skew);
+            }
+        }
+
+        if (!partner || std::abs(skew) > options.toleranceMs) {
+            ++unmatched;
+            continue;
+        }
+
+        bundles.publish([&](FrameBundle& bundle) {
+            bundle.color = frame.color;
+            bundle.depth = frame.depth;
+            bundle.secondary = *partner;
+            bundle.skewMs = skew;
+            return true;
+        });
+        ++matched;
+        lastSkew = skew;
+    }
+}
+
+} // namespace UsArMirror
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <thread>
+
+#include "depth_camera.hpp"
+#include "frame_handle.hpp"
+#include "second_cam.hpp"
+#include "triple_buffer.hpp"
+
+namespace UsArMirror {
+
+/// Frames from both cameras captured at (nearly) the same time.
+struct FrameBundle {
+    FrameHandle color;     // DepthCameraInput color
+    FrameHandle depth;     // DepthCameraInput Z16, may be empty
+    FrameHandle secondary; // CameraInput color
+    /// secondary minus color capture time, in milliseconds.
+    double skewMs = 0.0;
+};
+
+/// Pairs DepthCameraInput and CameraInput frames by capture time.
+///
+/// The two devices run on unrelated clocks, so frames are compared by their
+/// host arrival time. Every new depth-camera frameset is matched against the
+/// last few webcam frames; if the closest one is outside the tolerance and
+/// the webcam is behind, the synchronizer waits up to the tolerance for its
+/// next frame. Pairs that still do not match are dropped and counted.
+class FrameSynchronizer {
+public:
+    struct Options {
+        double toleranceMs = 16.0;
+        /// Webcam frames kept for matching.
+        size_t history = 3;
+    };
+
+    using BundleBuffer = TripleBuffer<FrameBundle>;
+    using BundleRef = BundleBuffer::ReadHandle;
+
+    FrameSynchronizer(const std::shared_ptr<DepthCameraInput>& primary,
+                      const std::shared_ptr<CameraInput>& secondary);
+    FrameSynchronizer(const std::shared_ptr<DepthCameraInput>& primary,
+                      const std::shared_ptr<CameraInput>& secondary, const Options& options);
+    ~FrameSynchronizer();
+
+    /// Pin the latest matched bundle.
+    BundleRef acquireBundle() const;
+    /// Block until a bundle newer than sequence `after` is matched.
+    BundleRef waitForBundle(uint64_t after, std::chrono::milliseconds timeout) const;
+
+    uint64_t matchedCount() const { return matched.load(); }
+    uint64_t unmatchedCount() const { return unmatched.load(); }
+    double lastSkewMs() const { return lastSkew.load(); }
+
+private:
+    void syncLoop();
+    void pullSecondary();
+    const FrameHandle* closestSecondary(const FrameHandle& color, double& skewMs) const;
+
+    std::shared_ptr<DepthCameraInput> primary;
+    std::shared_ptr<CameraInput> secondary;
+    Options options;
+
+    std::deque<FrameHandle> secondaryHistory;
+    uint64_t lastSecondarySequence = 0;
+
+    BundleBuffer bundles;
+    std::atomic<uint64_t> matched = 0;
+    std::atomic<uint64_t> unmatched = 0;
+    std::atomic<double> lastSkew = 0.0;
+
+    std::atomic<bool> running = true;
+    std::thread syncThread;
+};
+
+} // namespace UsArMirror
@@ -0,0 +1,45 @@
+#include "frame_texture.hpp"
+
+namespace UsArMirror {
+
+void FrameTexture::upload(const cv::Mat& bgr) {
+    if (bgr.empty()) return;
+    if (textureId == 0) {
+        glGenTextures(1, &textureId);
+        glBindTexture(GL_TEXTURE_2D, textureId);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, textureId);
+    // Frames may be ROI views with padded rows and odd widths.
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, static_cast<GLint>(bgr.step / bgr.elemSize()));
+    if (bgr.cols != width || bgr.rows != height) {
+        width = bgr.cols;
+        height = bgr.rows;
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, bgr.data);
+    } else {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_BGR, GL_UNSIGNED_BYTE, bgr.data);
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void FrameTexture::draw(float left, float right) const {
+    if (textureId == 0) return;
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, textureId);
+
+    glColor3f(1.0f, 1.0f, 1.0f);
+    glBegin(GL_QUADS);
+    glTexCoord2f(0.0f, 1.0f); glVertex2f(left, -1.0f);
+    glTexCoord2f(1.0f, 1.0f); glVertex2f(right, -1.0f);
+    glTexCoord2f(1.0f, 0.0f); glVertex2f(right, 1.0f);
+    glTexCoord2f(0.0f, 0.0f); glVertex2f(left, 1.0f);
+    glEnd();
+}
+
+} // namespace UsArMirror
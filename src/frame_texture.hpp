@@ -0,0 +1,27 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <opencv2/core.hpp>
+
+namespace UsArMirror {
+
+/// GL texture holding the latest BGR camera frame, drawn as a textured
+/// quad spanning the full window height.
+///
+/// The texture is created on first upload so cameras can be constructed
+/// before, or entirely without, a GL context. It is not deleted on
+/// destruction: cameras outlive the window and its context.
+class FrameTexture {
+public:
+    void upload(const cv::Mat& bgr);
+    /// Draw the last upload between x = `left` and x = `right` in clip
+    /// space; pass left > right to mirror horizontally.
+    void draw(float left, float right) const;
+
+private:
+    GLuint textureId = 0;
+    int width = 0;
+    int height = 0;
+};
+
+} // namespace UsArMirror
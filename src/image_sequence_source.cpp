@@ -0,0 +1,72 @@
+#include "image_sequence_source.hpp"
+
+#include <opencv2/opencv.hpp>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace UsArMirror {
+
+ImageSequenceSource::ImageSequenceSource(const std::string& pattern, const FrameSourceOptions& options)
+    : pattern(pattern), options(options), pacer(options.pace) {
+    std::vector<cv::String> matches;
+    cv::glob(pattern, matches, false);
+    files.assign(matches.begin(), matches.end());
+    std::sort(files.begin(), files.end());
+    if (files.empty()) {
+        throw std::runtime_error("No images match " + pattern);
+    }
+
+    FrameHandle first = load(0);
+    if (first.empty()) {
+        throw std::runtime_error("Could not read image " + files[0]);
+    }
+    caps.fps = options.fps;
+    caps.streams.color.width = first.mat().cols;
+    caps.streams.color.height = first.mat().rows;
+
+    if (options.preload) {
+        preloaded.reserve(files.size());
+        preloaded.push_back(std::move(first));
+        for (size_t i = 1; i < files.size(); ++i) preloaded.push_back(load(i));
+        spdlog::info("Preloaded {} images from {}", files.size(), pattern);
+    }
+}
+
+FrameHandle ImageSequenceSource::load(size_t i) const {
+    cv::Mat image = cv::imread(files[i], cv::IMREAD_COLOR);
+    if (image.empty()) {
+        spdlog::warn("Could not read image {}", files[i]);
+        return FrameHandle();
+    }
+    return FrameHandle::fromMat(image);
+}
+
+bool ImageSequenceSource::read(DepthCameraFrame& frame, std::chrono::milliseconds) {
+    if (done) return false;
+    if (index == files.size()) {
+        if (!options.loop) {
+            done = true;
+            return false;
+        }
+        index = 0;
+        pacer.restart();
+    }
+
+    size_t current = index++;
+    FrameHandle image = options.preload ? preloaded[current] : load(current);
+    if (image.empty()) return false;
+
+    // Images carry no capture time; space them at the nominal rate.
+    double timestamp = static_cast<double>(frameCounter) * 1000.0 / caps.fps;
+    pacer.wait(timestamp);
+    image.setTiming(timestamp, ++frameCounter, FrameHandle::Clock::now());
+
+    frame.color = std::move(image);
+    frame.depth = FrameHandle();
+    frame.pose = cv::Mat();
+    return true;
+}
+
+} // namespace UsArMirror
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "frame_source.hpp"
+
+namespace UsArMirror {
+
+/// Color frames from a sorted list of image files, e.g. the PNGs under
+/// captured_images/. Frames are stamped at the nominal frame rate.
+class ImageSequenceSource : public FrameSource {
+public:
+    /// Throws std::runtime_error if `pattern` matches no files.
+    ImageSequenceSource(const std::string& pattern, const FrameSourceOptions& options);
+
+    std::string name() const override { return "images:" + pattern; }
+    const SourceCapabilities& capabilities() const override { return caps; }
+    bool read(DepthCameraFrame& frame, std::chrono::milliseconds timeout) override;
+    bool finished() const override { return done; }
+    SourcePace pace() const override { return options.pace; }
+
+private:
+    FrameHandle load(size_t index) const;
+
+    std::string pattern;
+    FrameSourceOptions options;
+    std::vector<std::string> files;
+    std::vector<FrameHandle> preloaded;
+    SourceCapabilities caps;
+    FramePacer pacer;
+    size_t index = 0;
+    uint64_t frameCounter = 0;
+    bool done = false;
+};
+
+} // namespace UsArMirror
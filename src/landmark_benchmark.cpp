@@ -0,0 +1,128 @@
+// Compares cv::face::FacemarkLBF with LandmarkRegressor on the same model.
+//
+//   landmark_benchmark [image glob] [iterations] [model]
+//
+// Defaults to captured_images/rs/*.png and lbfmodel.yaml. Faces are found
+// with the Haar cascade; the largest face of each image is fitted by
+// FacemarkLBF, by LandmarkRegressor from the mean shape (cold) and by
+// LandmarkRegressor from its own cold shape moved 3 px with the box, as
+// when tracking (warm). Prints the time per fit of each and how far the
+// shapes are apart, in inter-ocular distances.
+
+#include <opencv2/face.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/objdetect.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "landmark_regressor.hpp"
+
+namespace {
+
+double medianMs(int iterations, const std::function<void()>& run) {
+    std::vector<double> times;
+    run(); // warm-up
+    for (int i = 0; i < iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+/// Mean point distance over the outer eye corner distance of `a`.
+double shapeError(const std::vector<cv::Point2f>& a, const std::vector<cv::Point2f>& b) {
+    if (a.size() != b.size() || a.size() != 68) return NAN;
+    double sum = 0.0;
+    for (size_t i = 0; i < a.size(); ++i) sum += std::hypot(a[i].x - b[i].x, a[i].y - b[i].y);
+    double interOcular = std::hypot(a[36].x - a[45].x, a[36].y - a[45].y);
+    return sum / a.size() / interOcular;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string pattern = argc > 1 ? argv[1] : "captured_images/rs/*.png";
+    int iterations = argc > 2 ? std::max(1, std::atoi(argv[2])) : 20;
+    std::string model = argc > 3 ? argv[3] : "lbfmodel.yaml";
+
+    std::vector<cv::String> paths;
+    cv::glob(pattern, paths);
+    if (paths.empty()) {
+        std::fprintf(stderr, "No images match %s\n", pattern.c_str());
+        return 1;
+    }
+    cv::CascadeClassifier cascade;
+    if (!cascade.load("haarcascade_frontalface_default.xml")) {
+        std::fprintf(stderr, "Cannot read haarcascade_frontalface_default.xml\n");
+        return 1;
+    }
+
+    auto loadStart = std::chrono::steady_clock::now();
+    cv::Ptr<cv::face::FacemarkLBF> facemark = cv::face::FacemarkLBF::create();
+    facemark->loadModel(model);
+    auto loadMid = std::chrono::steady_clock::now();
+    UsArMirror::LandmarkRegressor regressor(model);
+    auto loadEnd = std::chrono::steady_clock::now();
+    std::printf("%s: FacemarkLBF loads in %.0f ms, LandmarkRegressor in %.0f ms; %d stages, warm start at stage %d\n",
+                model.c_str(), std::chrono::duration<double, std::milli>(loadMid - loadStart).count(),
+                std::chrono::duration<double, std::milli>(loadEnd - loadMid).count(), regressor.stageCount(),
+                regressor.options.warmStartStage);
+    std::printf("%-32s %10s %10s %10s %12s %12s\n", "image", "LBF ms", "cold ms", "warm ms", "cold vs LBF",
+                "warm vs cold");
+
+    double totalLbf = 0.0, totalCold = 0.0, totalWarm = 0.0, totalColdError = 0.0, totalWarmError = 0.0;
+    int fitted = 0;
+    for (const cv::String& path : paths) {
+        cv::Mat gray = cv::imread(path, cv::IMREAD_GRAYSCALE);
+        if (gray.empty()) continue;
+        std::vector<cv::Rect> faces;
+        cascade.detectMultiScale(gray, faces, 1.1, 3, 0, cv::Size(60, 60));
+        if (faces.empty()) {
+            std::printf("%-32s no face\n", path.c_str());
+            continue;
+        }
+        cv::Rect face = *std::max_element(faces.begin(), faces.end(),
+                                          [](const cv::Rect& a, const cv::Rect& b) { return a.area() < b.area(); });
+        std::vector<cv::Rect> boxes = {face};
+
+        std::vector<std::vector<cv::Point2f>> reference;
+        double lbfMs = medianMs(iterations, [&] { facemark->fit(gray, boxes, reference); });
+        std::vector<cv::Point2f> cold;
+        double coldMs = medianMs(iterations, [&] { regressor.fitFace(gray, face, cold); });
+
+        cv::Rect moved = face + cv::Point(3, 3);
+        std::vector<cv::Point2f> initial = cold;
+        for (cv::Point2f& p : initial) p += cv::Point2f(3.0f, 3.0f);
+        std::vector<cv::Point2f> warm;
+        double warmMs = medianMs(iterations, [&] {
+            regressor.fitFace(gray, moved, warm, &initial, regressor.options.warmStartStage);
+        });
+        for (cv::Point2f& p : warm) p -= cv::Point2f(3.0f, 3.0f);
+
+        double coldError = reference.empty() ? NAN : shapeError(reference[0], cold);
+        double warmError = shapeError(cold, warm);
+        std::printf("%-32s %10.3f %10.3f %10.3f %12.4f %12.4f\n", path.c_str(), lbfMs, coldMs, warmMs, coldError,
+                    warmError);
+        totalLbf += lbfMs;
+        totalCold += coldMs;
+        totalWarm += warmMs;
+        totalColdError += coldError;
+        totalWarmError += warmError;
+        ++fitted;
+    }
+    if (fitted == 0) return 1;
+    std::printf("%-32s %10.3f %10.3f %10.3f %12.4f %12.4f\n", "mean", totalLbf / fitted, totalCold / fitted,
+                totalWarm / fitted, totalColdError / fitted, totalWarmError / fitted);
+    std::printf("LandmarkRegressor is %.1fx faster cold, %.1fx warm\n", totalLbf / totalCold, totalLbf / totalWarm);
+    return 0;
+}
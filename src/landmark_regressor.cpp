@@ -0,0 +1,329 @@
+#include "landmark_regressor.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <tuple>
+
+#include "simd.hpp"
+
+namespace UsArMirror {
+
+namespace {
+
+using simd::f32x4;
+
+template<typename V> constexpr int laneCount = 1;
+template<> constexpr int laneCount<f32x4> = simd::lanes;
+
+template<typename V> V fromLanes(const float* values);
+template<> inline float fromLanes<float>(const float* values) { return values[0]; }
+template<> inline f32x4 fromLanes<f32x4>(const float* values) { return simd::load(values); }
+
+inline void toLanes(float v, float* out) { out[0] = v; }
+inline void toLanes(f32x4 v, float* out) { simd::store(out, v); }
+
+/// What the tree walk needs to know about the image and the current shape.
+struct Sampling {
+    const uint8_t* pixels;
+    size_t stride;
+    float maxX;
+    float maxY;
+    /// Mean-shape offsets to pixels: scale, rotation and box size together.
+    float m00, m01, m10, m11;
+    /// Current shape in pixels, interleaved x, y.
+    const float* shape;
+};
+
+/// Walk trees [tree, tree + lanes) of one stage to their leaves, all
+/// levels in lock step. Returns each tree's leaf code in `codes`.
+template<typename V>
+void walkTrees(const Sampling& s, const float* offsets, const int* thresholds, int tree, int treesPerLandmark,
+               int depth, int splits, int leaves, int* codes) {
+    constexpr int n = laneCount<V>;
+    int node[n];
+    float anchor[2][n];
+    for (int l = 0; l < n; ++l) {
+        node[l] = 1;
+        int landmark = (tree + l) / treesPerLandmark;
+        anchor[0][l] = s.shape[2 * landmark];
+        anchor[1][l] = s.shape[2 * landmark + 1];
+    }
+    const V anchorX = fromLanes<V>(anchor[0]);
+    const V anchorY = fromLanes<V>(anchor[1]);
+    const V zero = simd::splat<V>(0.0f);
+    const V maxX = simd::splat<V>(s.maxX);
+    const V maxY = simd::splat<V>(s.maxY);
+
+    for (int level = 1; level < depth; ++level) {
+        float feature[4][n];
+        for (int l = 0; l < n; ++l) {
+            const float* f = offsets + (static_cast<size_t>(tree + l) * splits + node[l] - 1) * 4;
+            for (int c = 0; c < 4; ++c) feature[c][l] = f[c];
+        }
+        V x1 = fromLanes<V>(feature[0]), y1 = fromLanes<V>(feature[1]);
+        V x2 = fromLanes<V>(feature[2]), y2 = fromLanes<V>(feature[3]);
+        float point[4][n];
+        toLanes(simd::minimum(simd::maximum(x1 * s.m00 + y1 * s.m01 + anchorX, zero), maxX), point[0]);
+        toLanes(simd::minimum(simd::maximum(x1 * s.m10 + y1 * s.m11 + anchorY, zero), maxY), point[1]);
+        toLanes(simd::minimum(simd::maximum(x2 * s.m00 + y2 * s.m01 + anchorX, zero), maxX), point[2]);
+        toLanes(simd::minimum(simd::maximum(x2 * s.m10 + y2 * s.m11 + anchorY, zero), maxY), point[3]);
+        for (int l = 0; l < n; ++l) {
+            int a = s.pixels[static_cast<size_t>(point[1][l]) * s.stride + static_cast<size_t>(point[0][l])];
+            int b = s.pixels[static_cast<size_t>(point[3][l]) * s.stride + static_cast<size_t>(point[2][l])];
+            int threshold = thresholds[static_cast<size_t>(tree + l) * splits + node[l] - 1];
+            node[l] = 2 * node[l] + (a - b >= threshold ? 1 : 0);
+        }
+    }
+    for (int l = 0; l < n; ++l) codes[tree + l] = (tree + l) * leaves + node[l] - leaves;
+}
+
+/// Scale and rotation taking `mean` onto `shape`, both interleaved x, y
+/// and compared about their centroids.
+void similarity(const float* shape, const float* mean, int count, float& scale, float& c, float& s) {
+    float sx = 0, sy = 0, mx = 0, my = 0;
+    for (int i = 0; i < count; ++i) {
+        sx += shape[2 * i];
+        sy += shape[2 * i + 1];
+        mx += mean[2 * i];
+        my += mean[2 * i + 1];
+    }
+    sx /= count;
+    sy /= count;
+    mx /= count;
+    my /= count;
+    float shapeNorm = 0, meanNorm = 0, dot = 0, cross = 0;
+    for (int i = 0; i < count; ++i) {
+        float ax = shape[2 * i] - sx, ay = shape[2 * i + 1] - sy;
+        float bx = mean[2 * i] - mx, by = mean[2 * i + 1] - my;
+        shapeNorm += ax * ax + ay * ay;
+        meanNorm += bx * bx + by * by;
+        dot += ax * bx + ay * by;
+        cross += ay * bx - ax * by;
+    }
+    scale = meanNorm > 0.0f ? std::sqrt(shapeNorm / meanNorm) : 1.0f;
+    float norm = std::hypot(dot, cross);
+    c = norm > 0.0f ? dot / norm : 1.0f;
+    s = norm > 0.0f ? cross / norm : 0.0f;
+}
+
+float overlap(const cv::Rect& a, const cv::Rect& b) {
+    float intersection = static_cast<float>((a & b).area());
+    float total = static_cast<float>(a.area() + b.area()) - intersection;
+    return total > 0.0f ? intersection / total : 0.0f;
+}
+
+} // namespace
+
+LandmarkRegressor::LandmarkRegressor(const std::string& path, const LandmarkRegressorOptions& options)
+    : options(options) {
+    cv::FileStorage fs(path, cv::FileStorage::READ);
+    if (!fs.isOpened()) throw std::runtime_error("Cannot open landmark model " + path);
+    stages = static_cast<int>(fs["stages_n"]);
+    treesPerLandmark = static_cast<int>(fs["tree_n"]);
+    depth = static_cast<int>(fs["tree_depth"]);
+    // FacemarkLBF writes n_landmarks; landmark_n is accepted for older files.
+    cv::FileNode landmarkCount = fs["n_landmarks"];
+    landmarks = static_cast<int>(landmarkCount.empty() ? fs["landmark_n"] : landmarkCount);
+    if (stages <= 0 || treesPerLandmark <= 0 || depth < 2 || depth > 16 || landmarks <= 0) {
+        throw std::runtime_error("Not an LBF landmark model: " + path);
+    }
+    leaves = 1 << (depth - 1);
+    splits = leaves - 1;
+    trees = landmarks * treesPerLandmark;
+    const size_t shapeSize = static_cast<size_t>(2) * landmarks;
+
+    cv::Mat mean;
+    fs["mean_shape"] >> mean;
+    if (mean.rows != landmarks || mean.cols != 2) throw std::runtime_error("Bad mean shape in " + path);
+    mean.convertTo(mean, CV_32F);
+    meanShape.assign(mean.ptr<float>(), mean.ptr<float>() + shapeSize);
+
+    offsets.resize(static_cast<size_t>(stages) * trees * splits * 4);
+    thresholds.resize(static_cast<size_t>(stages) * trees * splits);
+    weights.resize(static_cast<size_t>(stages) * trees * leaves * shapeSize);
+    cv::Mat feats, stageWeights;
+    std::vector<int> treeThresholds;
+    for (int k = 0; k < stages; ++k) {
+        for (int tree = 0; tree < trees; ++tree) {
+            const std::string suffix = std::to_string(k) + "_" + std::to_string(tree / treesPerLandmark) + "_" +
+                                       std::to_string(tree % treesPerLandmark);
+            // Nodes are 1-based; node 0 is unused.
+            cv::FileNode node = fs["tree_" + suffix];
+            if (node.isMap()) {
+                node["feats"] >> feats;
+                node["thresholds"] >> treeThresholds;
+            } else {
+                node >> feats;
+                fs["thresholds_" + suffix] >> treeThresholds;
+            }
+            if (feats.rows <= splits || feats.cols != 4 || static_cast<int>(treeThresholds.size()) <= splits) {
+                throw std::runtime_error("Bad tree " + suffix + " in " + path);
+            }
+            feats.convertTo(feats, CV_32F);
+            size_t first = static_cast<size_t>(k) * trees + tree;
+            for (int split = 0; split < splits; ++split) {
+                std::copy_n(feats.ptr<float>(split + 1), 4, offsets.begin() + (first * splits + split) * 4);
+                thresholds[first * splits + split] = treeThresholds[split + 1];
+            }
+        }
+
+        fs["weights_" + std::to_string(k)] >> stageWeights;
+        if (stageWeights.rows != static_cast<int>(shapeSize) || stageWeights.cols != trees * leaves) {
+            throw std::runtime_error("Bad regression weights for stage " + std::to_string(k) + " in " + path);
+        }
+        stageWeights.convertTo(stageWeights, CV_32F);
+        float* out = weights.data() + static_cast<size_t>(k) * trees * leaves * shapeSize;
+        for (size_t row = 0; row < shapeSize; ++row) {
+            const float* in = stageWeights.ptr<float>(static_cast<int>(row));
+            for (int leaf = 0; leaf < trees * leaves; ++leaf) out[leaf * shapeSize + row] = in[leaf];
+        }
+    }
+}
+
+void LandmarkRegressor::extractCodes(const cv::Mat& gray, int stage, const float* shape, float boxScaleX,
+                                     float boxScaleY, float scale, const float rotation[4]) {
+    Sampling s;
+    s.pixels = gray.ptr<uint8_t>();
+    s.stride = gray.step;
+    s.maxX = static_cast<float>(gray.cols - 1);
+    s.maxY = static_cast<float>(gray.rows - 1);
+    s.m00 = scale * rotation[0] * boxScaleX;
+    s.m01 = scale * rotation[1] * boxScaleX;
+    s.m10 = scale * rotation[2] * boxScaleY;
+    s.m11 = scale * rotation[3] * boxScaleY;
+    s.shape = shape;
+
+    const float* stageOffsets = offsets.data() + static_cast<size_t>(stage) * trees * splits * 4;
+    const int* stageThresholds = thresholds.data() + static_cast<size_t>(stage) * trees * splits;
+    codes.resize(trees);
+    int tree = 0;
+    for (; tree + simd::lanes <= trees; tree += simd::lanes) {
+        walkTrees<f32x4>(s, stageOffsets, stageThresholds, tree, treesPerLandmark, depth, splits, leaves,
+                         codes.data());
+    }
+    for (; tree < trees; ++tree) {
+        walkTrees<float>(s, stageOffsets, stageThresholds, tree, treesPerLandmark, depth, splits, leaves,
+                         codes.data());
+    }
+}
+
+void LandmarkRegressor::fitFace(const cv::Mat& gray, const cv::Rect& face, std::vector<cv::Point2f>& shape,
+                                const std::vector<cv::Point2f>* initial, int firstStage) {
+    if (gray.type() != CV_8UC1 || gray.empty()) throw std::runtime_error("LandmarkRegressor needs a CV_8UC1 image");
+    const int size = 2 * landmarks;
+    const float centerX = face.x + 0.5f * face.width;
+    const float centerY = face.y + 0.5f * face.height;
+    const float boxScaleX = 0.5f * face.width;
+    const float boxScaleY = 0.5f * face.height;
+
+    // `current` is in pixels, `projected` in box coordinates like the
+    // mean shape.
+    current.resize(size);
+    projected.resize(size);
+    if (initial && static_cast<int>(initial->size()) == landmarks) {
+        for (int i = 0; i < landmarks; ++i) {
+            current[2 * i] = (*initial)[i].x;
+            current[2 * i + 1] = (*initial)[i].y;
+        }
+    } else {
+        firstStage = 0;
+        for (int i = 0; i < landmarks; ++i) {
+            current[2 * i] = meanShape[2 * i] * boxScaleX + centerX;
+            current[2 * i + 1] = meanShape[2 * i + 1] * boxScaleY + centerY;
+        }
+    }
+
+    delta.resize(size);
+    const size_t leafCount = static_cast<size_t>(trees) * leaves;
+    for (int stage = std::clamp(firstStage, 0, stages); stage < stages; ++stage) {
+        for (int i = 0; i < landmarks; ++i) {
+            projected[2 * i] = (current[2 * i] - centerX) / boxScaleX;
+            projected[2 * i + 1] = (current[2 * i + 1] - centerY) / boxScaleY;
+        }
+        float scale, c, s;
+        similarity(projected.data(), meanShape.data(), landmarks, scale, c, s);
+        const float rotation[4] = {c, -s, s, c};
+        extractCodes(gray, stage, current.data(), boxScaleX, boxScaleY, scale, rotation);
+
+        // Sum the shape delta of every reached leaf: one contiguous row each.
+        std::fill(delta.begin(), delta.end(), 0.0f);
+        const float* stageWeights = weights.data() + static_cast<size_t>(stage) * leafCount * size;
+        for (int code : codes) {
+            const float* row = stageWeights + static_cast<size_t>(code) * size;
+            int i = 0;
+            for (; i + simd::lanes <= size; i += simd::lanes) {
+                simd::store(delta.data() + i, simd::load(delta.data() + i) + simd::load(row + i));
+            }
+            for (; i < size; ++i) delta[i] += row[i];
+        }
+
+        // The delta is in mean-shape axes; rotate and scale it onto the face.
+        for (int i = 0; i < landmarks; ++i) {
+            float dx = delta[2 * i], dy = delta[2 * i + 1];
+            current[2 * i] = (projected[2 * i] + scale * (c * dx - s * dy)) * boxScaleX + centerX;
+            current[2 * i + 1] = (projected[2 * i + 1] + scale * (s * dx + c * dy)) * boxScaleY + centerY;
+        }
+    }
+
+    shape.resize(landmarks);
+    for (int i = 0; i < landmarks; ++i) shape[i] = cv::Point2f(current[2 * i], current[2 * i + 1]);
+}
+
+bool LandmarkRegressor::fit(const cv::Mat& gray, const std::vector<cv::Rect>& faces,
+                            std::vector<std::vector<cv::Point2f>>& result) {
+    auto start = std::chrono::steady_clock::now();
+    result.resize(faces.size());
+    std::vector<Previous> next(faces.size());
+    std::vector<cv::Point2f> initial;
+
+    // Each previous shape seeds at most one face: pair them greedily,
+    // best overlap first.
+    std::vector<std::tuple<float, size_t, size_t>> pairs;
+    for (size_t f = 0; f < faces.size(); ++f) {
+        for (size_t p = 0; p < previous.size(); ++p) {
+            float o = overlap(faces[f], previous[p].box);
+            if (o >= options.minOverlap) pairs.emplace_back(o, f, p);
+        }
+    }
+    std::sort(pairs.begin(), pairs.end(), [](const auto& a, const auto& b) { return std::get<0>(a) > std::get<0>(b); });
+    std::vector<const Previous*> matches(faces.size(), nullptr);
+    std::vector<bool> used(previous.size(), false);
+    for (const auto& [o, f, p] : pairs) {
+        if (matches[f] || used[p]) continue;
+        matches[f] = &previous[p];
+        used[p] = true;
+    }
+
+    for (size_t f = 0; f < faces.size(); ++f) {
+        const cv::Rect& face = faces[f];
+        const Previous* match = matches[f];
+        next[f].box = face;
+        if (match && match->age + 1 < options.coldInterval) {
+            // Carry the last shape along with its box.
+            float sx = static_cast<float>(face.width) / match->box.width;
+            float sy = static_cast<float>(face.height) / match->box.height;
+            cv::Point2f from(match->box.x + 0.5f * match->box.width, match->box.y + 0.5f * match->box.height);
+            cv::Point2f to(face.x + 0.5f * face.width, face.y + 0.5f * face.height);
+            initial.resize(match->shape.size());
+            for (size_t i = 0; i < initial.size(); ++i) {
+                initial[i] = cv::Point2f((match->shape[i].x - from.x) * sx + to.x,
+                                         (match->shape[i].y - from.y) * sy + to.y);
+            }
+            fitFace(gray, face, result[f], &initial, options.warmStartStage);
+            next[f].age = match->age + 1;
+            ++warmCount;
+        } else {
+            fitFace(gray, face, result[f]);
+            next[f].age = 0;
+            ++coldCount;
+        }
+        next[f].shape = result[f];
+    }
+    previous = std::move(next);
+    lastCost = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return !faces.empty();
+}
+
+} // namespace UsArMirror
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace UsArMirror {
+
+struct LandmarkRegressorOptions {
+    /// Warm-started faces skip the cascade stages before this one: the
+    /// early stages make the coarse moves from the mean shape, which the
+    /// previous frame's shape no longer needs.
+    int warmStartStage = 2;
+    /// Fit from the mean shape at least every this many frames per face,
+    /// so errors cannot accumulate through warm starts. 1 never warm
+    /// starts.
+    int coldInterval = 10;
+    /// A face warm starts only if its box overlaps the previous one by at
+    /// least this intersection over union.
+    float minOverlap = 0.3f;
+};
+
+/// Native runtime for the OpenCV FacemarkLBF model (lbfmodel.yaml):
+/// a cascade of random forests over pixel-difference features, each stage
+/// followed by a global linear regression of the shape update.
+///
+/// The model is flattened at load time. Each tree is one contiguous run
+/// of its split nodes, with the feature offsets as floats. The regression
+/// weights are transposed so that every leaf owns one contiguous row of
+/// shape deltas. A stage then costs one pass over the trees and one
+/// vector add per reached leaf, instead of FacemarkLBF's strided gathers
+/// per landmark coordinate. Trees are walked four at a time, with the
+/// sample positions of the four computed in one f32x4.
+///
+/// fit() keeps each face's shape and, when the next box overlaps the last
+/// one, starts from it at warmStartStage instead of from the mean shape.
+class LandmarkRegressor {
+public:
+    /// Load an lbfmodel.yaml; throws std::runtime_error if it cannot be
+    /// read or is not an LBF model.
+    explicit LandmarkRegressor(const std::string& path,
+                               const LandmarkRegressorOptions& options = LandmarkRegressorOptions());
+
+    /// Same contract as cv::face::Facemark::fit(): one shape per face box,
+    /// in the pixels of `gray` (CV_8UC1). Returns false for no faces.
+    bool fit(const cv::Mat& gray, const std::vector<cv::Rect>& faces,
+             std::vector<std::vector<cv::Point2f>>& landmarks);
+
+    /// Fit one face; `initial`, in pixels of `gray`, replaces the mean
+    /// shape and the stages before `firstStage` are skipped.
+    void fitFace(const cv::Mat& gray, const cv::Rect& face, std::vector<cv::Point2f>& shape,
+                 const std::vector<cv::Point2f>* initial = nullptr, int firstStage = 0);
+
+    /// Forget the previous shapes; the next fit() starts cold.
+    void reset() { previous.clear(); }
+
+    int landmarkCount() const { return landmarks; }
+    int stageCount() const { return stages; }
+
+    /// Wall time of the last fit() call.
+    double lastCostMs() const { return lastCost; }
+    /// Faces fitted from the previous shape and from the mean shape.
+    uint64_t warmStarts() const { return warmCount; }
+    uint64_t coldStarts() const { return coldCount; }
+
+    LandmarkRegressorOptions options;
+
+private:
+    struct Previous {
+        cv::Rect box;
+        std::vector<cv::Point2f> shape;
+        int age = 0;
+    };
+
+    /// Leaf codes, one per tree, of `stage` for `shape` (pixels).
+    void extractCodes(const cv::Mat& gray, int stage, const float* shape, float boxScaleX, float boxScaleY,
+                      float scale, const float rotation[4]);
+
+    int stages = 0;
+    int treesPerLandmark = 0;
+    int depth = 0;
+    int landmarks = 0;
+    int splits = 0;
+    int leaves = 0;
+    int trees = 0;
+
+    /// Interleaved x, y, in box coordinates ([-1, 1] across the box).
+    std::vector<float> meanShape;
+    /// Per stage, tree, split node: x1, y1, x2, y2 in mean-shape units.
+    std::vector<float> offsets;
+    /// Per stage, tree, split node.
+    std::vector<int> thresholds;
+    /// Per stage, leaf over all trees: the 2 * landmarks shape delta.
+    std::vector<float> weights;
+
+    std::vector<Previous> previous;
+    double lastCost = 0.0;
+    uint64_t warmCount = 0;
+    uint64_t coldCount = 0;
+
+    // Scratch
+    std::vector<int> codes;
+    std::vector<float> current;
+    std::vector<float> projected;
+    std::vector<float> delta;
+};
+
+} // namespace UsArMirror
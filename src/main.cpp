@@ -153,8 +153,10 @@
 
 // } // namespace UsArMirror
 
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <type_traits>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -168,6 +170,7 @@
 #include "common.hpp"
 // #include "face_reconstruction.hpp"
 #include "second_cam.hpp"
+#include "frame_sync.hpp"
 #include "model_renderer.hpp"
 
 // #include <imgui.h>
@@ -624,9 +627,129 @@
 // }
 
 
+namespace {
+void printUsage(const char *program) {
+  std::cerr << "Usage: " << program << " [options] [model.gltf]\n"
+            << "  --record PATH                 record the depth camera to PATH\n"
+            << "  --replay PATH                 replay a recording as the depth camera\n"
+            << "  --depth-source SPEC           depth camera frame source, see openFrameSource()\n"
+            << "  --secondary-source SPEC       webcam frame source\n"
+            << "  --pace realtime|unthrottled|lockstep\n"
+            << "  --tag-rate HZ                 AprilTag pose updates per second, 0 on request only\n"
+            << "  --no-tag-lock                 keep estimating the pose once it is steady\n"
+            << "  --tag-bundle PATH             tag layout, see TagBundle::load()\n"
+            << "  --face-interval N             face SSD every N frames, tracked in between\n"
+            << "  --face-confidence C           re-detect below this tracking confidence\n"
+            << "  --no-face-prefilter           no Haar cascade in front of the face SSD\n"
+            << "  --face-full-frame N           whole-frame face search every N frames, 0 never\n"
+            << "  --no-face-depth               no depth proposals for the face SSD\n"
+            << "  --face-depth-band MIN MAX     depth band for face proposals, meters\n"
+            << "  --face-motion LEVELS          skip face work below this mean gray change\n"
+            << "  --face-max-stale N            but for at most N frames in a row\n"
+            << "  --dnn-target TARGET           cpu, opencl, opencl-fp16, cuda or cuda-fp16\n"
+            << "  --dnn-threads N               OpenCV threads for the face SSD, 0 default\n";
+}
+
+// Value of a numeric flag; prints the usage and exits on anything that is
+// not entirely a number.
+template <typename T>
+T parseNumber(const char *program, const std::string &flag, const std::string &value) {
+  try {
+    size_t used = 0;
+    T number;
+    if constexpr (std::is_integral_v<T>) number = std::stoi(value, &used);
+    else number = std::stof(value, &used);
+    if (used == value.size()) return number;
+  } catch (const std::exception &) {
+  }
+  std::cerr << "Invalid value for " << flag << ": " << value << std::endl;
+  printUsage(program);
+  std::exit(EXIT_FAILURE);
+}
+} // namespace
+
 int main(int argc, char **argv) {
   std::string filename = "models/Cube/Cube.gltf";
-  if (argc > 1) filename = argv[1];
+  // Frame source specs, see openFrameSource(); e.g. "recording:session.rec",
+  // "images:captured_images/rs/*.png", "video:video.mp4" or "synthetic".
+  std::string recordPath, depthSource, secondarySource;
+  UsArMirror::SourcePace pace = UsArMirror::SourcePace::RealTime;
+  // AprilTag pose updates per second; 0 disables periodic updates.
+  float tagRate = 2.0f;
+  // Keep estimating the pose instead of locking it once it is steady.
+  bool tagLock = true;
+  // Tag layout to solve the pose from, see TagBundle::load().
+  std::string tagBundlePath;
+  // Face SSD every N frames, tracked in between; 1 detects every frame.
+  int faceInterval = 5;
+  float faceConfidence = 0.6f;
+  // Haar cascade deciding where the face SSD looks; with no candidates,
+  // the SSD still searches the whole frame every N frames (0 never).
+  bool facePrefilter = true;
+  int faceFullFrame = 30;
+  // With depth, search for faces only around people in this band, meters.
+  bool faceDepth = true;
+  float faceMinDepth = 0.4f, faceMaxDepth = 1.5f;
+  // Skip face work while the scene moves less than this many gray levels,
+  // for at most N frames in a row; 0 runs on every frame.
+  float faceMotion = 2.0f;
+  int faceMaxStale = 30;
+  // Face SSD device: cpu, opencl, opencl-fp16, cuda or cuda-fp16; and
+  // OpenCV threads for it, 0 for OpenCV's default.
+  std::string dnnTarget = "cpu";
+  int dnnThreads = 0;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--record" && i + 1 < argc) {
+      recordPath = argv[++i];
+    } else if (arg == "--replay" && i + 1 < argc) {
+      depthSource = std::string("recording:") + argv[++i];
+    } else if (arg == "--depth-source" && i + 1 < argc) {
+      depthSource = argv[++i];
+    } else if (arg == "--secondary-source" && i + 1 < argc) {
+      secondarySource = argv[++i];
+    } else if (arg == "--pace" && i + 1 < argc) {
+      std::string value = argv[++i];
+      if (value == "unthrottled") pace = UsArMirror::SourcePace::Unthrottled;
+      else if (value == "lockstep") pace = UsArMirror::SourcePace::Lockstep;
+      else pace = UsArMirror::SourcePace::RealTime;
+    } else if (arg == "--tag-rate" && i + 1 < argc) {
+      tagRate = parseNumber<float>(argv[0], arg, argv[++i]);
+    } else if (arg == "--no-tag-lock") {
+      tagLock = false;
+    } else if (arg == "--tag-bundle" && i + 1 < argc) {
+      tagBundlePath = argv[++i];
+    } else if (arg == "--face-interval" && i + 1 < argc) {
+      faceInterval = parseNumber<int>(argv[0], arg, argv[++i]);
+    } else if (arg == "--face-confidence" && i + 1 < argc) {
+      faceConfidence = parseNumber<float>(argv[0], arg, argv[++i]);
+    } else if (arg == "--no-face-prefilter") {
+      facePrefilter = false;
+    } else if (arg == "--face-full-frame" && i + 1 < argc) {
+      faceFullFrame = parseNumber<int>(argv[0], arg, argv[++i]);
+    } else if (arg == "--no-face-depth") {
+      faceDepth = false;
+    } else if (arg == "--face-depth-band" && i + 2 < argc) {
+      faceMinDepth = parseNumber<float>(argv[0], arg, argv[++i]);
+      faceMaxDepth = parseNumber<float>(argv[0], arg, argv[++i]);
+    } else if (arg == "--face-motion" && i + 1 < argc) {
+      faceMotion = parseNumber<float>(argv[0], arg, argv[++i]);
+    } else if (arg == "--face-max-stale" && i + 1 < argc) {
+      faceMaxStale = parseNumber<int>(argv[0], arg, argv[++i]);
+    } else if (arg == "--dnn-target" && i + 1 < argc) {
+      dnnTarget = argv[++i];
+      if (dnnTarget != "cpu" && dnnTarget != "opencl" && dnnTarget != "opencl-fp16" && dnnTarget != "cuda" &&
+          dnnTarget != "cuda-fp16") {
+        std::cerr << "Unknown --dnn-target: " << dnnTarget << std::endl;
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+      }
+    } else if (arg == "--dnn-threads" && i + 1 < argc) {
+      dnnThreads = parseNumber<int>(argv[0], arg, argv[++i]);
+    } else {
+      filename = arg;
+    }
+  }
 
   if (!glfwInit()) return -1;
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -665,8 +788,56 @@ int main(int argc, char **argv) {
   auto w=800;
   auto h=600;
 
-  auto depthCameraInput = std::make_shared<UsArMirror::DepthCameraInput>(state, 0);
-  auto secondaryCam = std::make_shared<UsArMirror::CameraInput>(state, 6);
+  UsArMirror::FrameSourceOptions sourceOptions;
+  sourceOptions.width = state->viewportWidth;
+  sourceOptions.height = state->viewportHeight;
+  sourceOptions.pace = pace;
+
+  auto faceInference = UsArMirror::FaceInference::shared();
+  if (dnnTarget == "opencl") {
+    faceInference->setBackend(cv::dnn::DNN_BACKEND_OPENCV, cv::dnn::DNN_TARGET_OPENCL);
+  } else if (dnnTarget == "opencl-fp16") {
+    faceInference->setBackend(cv::dnn::DNN_BACKEND_OPENCV, cv::dnn::DNN_TARGET_OPENCL_FP16);
+  } else if (dnnTarget == "cuda") {
+    faceInference->setBackend(cv::dnn::DNN_BACKEND_CUDA, cv::dnn::DNN_TARGET_CUDA);
+  } else if (dnnTarget == "cuda-fp16") {
+    faceInference->setBackend(cv::dnn::DNN_BACKEND_CUDA, cv::dnn::DNN_TARGET_CUDA_FP16);
+  }
+  if (dnnThreads > 0) faceInference->setThreads(dnnThreads);
+
+  std::shared_ptr<UsArMirror::DepthCameraInput> depthCameraInput;
+  if (!depthSource.empty()) {
+    UsArMirror::FrameSourceOptions depthOptions = sourceOptions;
+    depthCameraInput = std::make_shared<UsArMirror::DepthCameraInput>(
+        state, UsArMirror::openFrameSource(depthSource, depthOptions));
+  } else {
+    depthCameraInput = std::make_shared<UsArMirror::DepthCameraInput>(state, 0);
+  }
+  depthCameraInput->lockExtrinsics = tagLock;
+  depthCameraInput->faceDetectInterval = faceInterval;
+  depthCameraInput->faceTrackConfidence = faceConfidence;
+  depthCameraInput->faceCascadePrefilter = facePrefilter;
+  depthCameraInput->faceFullFrameInterval = faceFullFrame;
+  depthCameraInput->faceDepthProposals = faceDepth;
+  depthCameraInput->faceMinDepth = faceMinDepth;
+  depthCameraInput->faceMaxDepth = faceMaxDepth;
+  depthCameraInput->faceMotionThreshold = faceMotion;
+  depthCameraInput->faceMaxStaleFrames = faceMaxStale;
+  if (!tagBundlePath.empty()) {
+    depthCameraInput->setTagBundle(
+        std::make_shared<UsArMirror::TagBundle>(UsArMirror::TagBundle::load(tagBundlePath)));
+  }
+  depthCameraInput->setExtrinsicsRate(tagRate);
+  if (!recordPath.empty()) depthCameraInput->startRecording(recordPath);
+  std::shared_ptr<UsArMirror::CameraInput> secondaryCam;
+  if (!secondarySource.empty()) {
+    UsArMirror::FrameSourceOptions secondaryOptions = sourceOptions;
+    secondaryCam = std::make_shared<UsArMirror::CameraInput>(
+        state, UsArMirror::openFrameSource(secondarySource, secondaryOptions));
+  } else {
+    secondaryCam = std::make_shared<UsArMirror::CameraInput>(state, 6);
+  }
+  auto frameSync = std::make_shared<UsArMirror::FrameSynchronizer>(depthCameraInput, secondaryCam);
   // auto faceRecon = std::make_shared<UsArMirror::FaceReconstruction>("share/");
   auto modelRenderer = std::make_shared<UsArMirror::ModelRenderer>(filename);
   // Shaders shader;
@@ -685,26 +856,24 @@ int main(int argc, char **argv) {
   // glm::vec3 model_pos(-3, 0, -3), sun_position(3.0f, 10.0f, -5.0f), sun_color(1.0f);
 
 
+  cv::Mat stitchedImage;
   while (!window.Close()) {
       window.Resize();
       glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   
-      cv::Mat color, secColor, stitchedImage;
-      rs2::frame depth;
+      auto bundle = frameSync->acquireBundle();
 
-      if (secondaryCam->getFrame(secColor) && depthCameraInput->getFrame(color)) {
+      if (bundle) {
           // Resize to same height (optional)
           // if (secondaryColor.size() != depthColor.size()) {
           //     cv::resize(depthColor, depthColor, secondaryColor.size());
           // }
-          cv::imwrite("depth.png", color);
-          cv::imwrite("secondary.png", secColor);
+          cv::imwrite("depth.png", bundle->color.mat());
+          cv::imwrite("secondary.png", bundle->secondary.mat());
 
-          depth = depthCameraInput->getDepth();
-
-      
           // Stitch side-by-side
-          cv::hconcat(secColor, color, stitchedImage);
+          cv::hconcat(bundle->secondary.mat(), bundle->color.mat(), stitchedImage);
+          bundle.release();
       
           // Convert BGR to RGB
           cv::cvtColor(stitchedImage, stitchedImage, cv::COLOR_BGR2RGB);
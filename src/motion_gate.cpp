@@ -0,0 +1,77 @@
+#include "motion_gate.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+#include "derived_images.hpp"
+
+namespace UsArMirror {
+
+namespace {
+
+/// Mean absolute difference of two same-size CV_8UC1 images inside `roi`.
+float meanAbsDiff(const cv::Mat& a, const cv::Mat& b, const cv::Rect& roi) {
+    uint64_t sum = 0;
+    for (int y = roi.y; y < roi.y + roi.height; ++y) {
+        const uint8_t* rowA = a.ptr<uint8_t>(y) + roi.x;
+        const uint8_t* rowB = b.ptr<uint8_t>(y) + roi.x;
+        uint32_t rowSum = 0;
+        for (int x = 0; x < roi.width; ++x) rowSum += static_cast<uint32_t>(std::abs(rowA[x] - rowB[x]));
+        sum += rowSum;
+    }
+    return static_cast<float>(sum) / static_cast<float>(roi.area());
+}
+
+} // namespace
+
+MotionGate::MotionGate(const MotionGateOptions& options) : options(options) {}
+
+void MotionGate::reset() {
+    reference.release();
+    staleFrames = 0;
+}
+
+bool MotionGate::check(const DerivedImages& frame, const std::vector<cv::Rect>& faces) {
+    auto start = std::chrono::steady_clock::now();
+    ++frameCount;
+    const cv::Mat& gray = frame.grayQuarter();
+
+    bool process = true;
+    if (!reference.empty() && reference.size() == gray.size() && options.threshold > 0.0f) {
+        const cv::Rect bounds(0, 0, gray.cols, gray.rows);
+        const float scaleX = static_cast<float>(gray.cols) / frame.bgr().cols;
+        const float scaleY = static_cast<float>(gray.rows) / frame.bgr().rows;
+        float score = meanAbsDiff(gray, reference, bounds);
+        for (const cv::Rect& face : faces) {
+            cv::Rect roi = cv::Rect(cv::Rect2f(face.x * scaleX, face.y * scaleY, face.width * scaleX,
+                                               face.height * scaleY)) & bounds;
+            if (!roi.empty()) score = std::max(score, meanAbsDiff(gray, reference, roi));
+        }
+        lastScore = score;
+        process = score > options.threshold || staleFrames + 1 >= std::max(options.maxStaleFrames, 1);
+    }
+
+    if (process) {
+        // The pyramid level is immutable, so sharing it is enough.
+        reference = gray;
+        staleFrames = 0;
+    } else {
+        ++staleFrames;
+        ++skipCount;
+    }
+    lastCost = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return process;
+}
+
+MotionGate::Metrics MotionGate::metrics() const {
+    Metrics metrics;
+    metrics.score = lastScore;
+    metrics.frames = frameCount;
+    metrics.skipped = skipCount;
+    metrics.skipRate = frameCount ? static_cast<double>(skipCount) / static_cast<double>(frameCount) : 0.0;
+    metrics.lastCostMs = lastCost;
+    return metrics;
+}
+
+} // namespace UsArMirror
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace UsArMirror {
+
+class DerivedImages;
+
+struct MotionGateOptions {
+    /// Mean absolute gray difference, in gray levels, above which a frame
+    /// counts as moving. 0 lets every frame through.
+    float threshold = 2.0f;
+    /// Let a frame through at least this many frames after the last one,
+    /// however still the scene is. 1 lets every frame through.
+    int maxStaleFrames = 30;
+};
+
+/// Decides whether a frame is worth running face detection and landmarks
+/// on, or whether the last results still hold.
+///
+/// The motion score is the mean absolute difference between the frame's
+/// quarter-size gray image and that of the last frame let through, over
+/// the whole image and inside each known face box; the score is the
+/// largest of those, so a head turn counts even when the face is small.
+/// Comparing against the last processed frame rather than the previous
+/// one means slow drift still adds up to a rerun.
+class MotionGate {
+public:
+    struct Metrics {
+        /// Score of the last frame checked.
+        float score = 0.0f;
+        uint64_t frames = 0;
+        uint64_t skipped = 0;
+        double skipRate = 0.0;
+        /// Wall time of the last check.
+        double lastCostMs = 0.0;
+    };
+
+    explicit MotionGate(const MotionGateOptions& options = MotionGateOptions());
+
+    /// Whether `frame` needs processing; `faces` are the last known face
+    /// boxes, in frame pixels. A frame let through becomes the reference.
+    bool check(const DerivedImages& frame, const std::vector<cv::Rect>& faces);
+
+    /// Let the next frame through.
+    void reset();
+
+    void setThreshold(float threshold) { options.threshold = threshold; }
+    void setMaxStaleFrames(int frames) { options.maxStaleFrames = frames; }
+    const MotionGateOptions& getOptions() const { return options; }
+
+    Metrics metrics() const;
+
+private:
+    MotionGateOptions options;
+    cv::Mat reference;
+    int staleFrames = 0;
+
+    float lastScore = 0.0f;
+    double lastCost = 0.0;
+    uint64_t frameCount = 0;
+    uint64_t skipCount = 0;
+};
+
+} // namespace UsArMirror
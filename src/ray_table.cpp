@@ -0,0 +1,204 @@
+#include "ray_table.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+
+namespace UsArMirror {
+
+namespace {
+
+bool sameIntrinsics(const StreamIntrinsics& a, const StreamIntrinsics& b) {
+    return a.fx == b.fx && a.fy == b.fy && a.cx == b.cx && a.cy == b.cy && a.width == b.width &&
+           a.height == b.height && a.dist == b.dist;
+}
+
+const cv::Point3f invalidPoint(std::numeric_limits<float>::quiet_NaN(), std::numeric_limits<float>::quiet_NaN(),
+                               std::numeric_limits<float>::quiet_NaN());
+
+} // namespace
+
+RayTable::RayTable(const StreamIntrinsics& intr) : intr(intr) {
+    if (intr.width <= 0 || intr.height <= 0 || intr.fx <= 0.0f || intr.fy <= 0.0f) {
+        throw std::runtime_error("RayTable needs valid intrinsics");
+    }
+    distorted = std::any_of(intr.dist.begin(), intr.dist.end(), [](float k) { return k != 0.0f; });
+    if (distorted) {
+        // Calibrated polynomials often fold back outside the calibrated
+        // area: past the radius where r * f(r^2) stops growing, pixels have
+        // no preimage. Rays are kept inside that radius.
+        const std::array<float, 5>& k = intr.dist;
+        for (float r = 0.0f; r < 4.0f; r += 1e-3f) {
+            float r2 = r * r;
+            if (1.0f + r2 * (3.0f * k[0] + r2 * (5.0f * k[1] + r2 * 7.0f * k[4])) <= 0.0f) {
+                maxRadius = r;
+                break;
+            }
+        }
+    }
+
+    size_t count = static_cast<size_t>(intr.width) * intr.height;
+    rayX.resize(count);
+    rayY.resize(count);
+    for (int y = 0; y < intr.height; ++y) {
+        float* rx = rayX.data() + static_cast<size_t>(y) * intr.width;
+        float* ry = rayY.data() + static_cast<size_t>(y) * intr.width;
+        for (int x = 0; x < intr.width; ++x) {
+            cv::Point2f r = computeRay(static_cast<float>(x), static_cast<float>(y));
+            rx[x] = r.x;
+            ry[x] = r.y;
+        }
+    }
+}
+
+std::shared_ptr<const RayTable> RayTable::get(const StreamIntrinsics& intr) {
+    static std::mutex mutex;
+    static std::vector<std::weak_ptr<const RayTable>> tables;
+
+    std::lock_guard lock(mutex);
+    tables.erase(std::remove_if(tables.begin(), tables.end(), [](const auto& t) { return t.expired(); }),
+                 tables.end());
+    for (const auto& weak : tables) {
+        auto table = weak.lock();
+        if (table && sameIntrinsics(table->intr, intr)) return table;
+    }
+    auto table = std::make_shared<const RayTable>(intr);
+    tables.push_back(table);
+    return table;
+}
+
+void RayTable::clampRadius(float& x, float& y) const {
+    float r2 = x * x + y * y;
+    if (r2 > maxRadius * maxRadius) {
+        float scale = maxRadius / std::sqrt(r2);
+        x *= scale;
+        y *= scale;
+    }
+}
+
+cv::Point2f RayTable::computeRay(float x, float y) const {
+    float nx = (x - intr.cx) / intr.fx;
+    float ny = (y - intr.cy) / intr.fy;
+    if (!distorted) return {nx, ny};
+
+    // Invert Brown-Conrady (k1, k2, p1, p2, k3): a few fixed-point steps
+    // for a starting point, then Newton, which also converges in the
+    // strongly distorted corners where fixed-point iteration does not.
+    const std::array<float, 5>& k = intr.dist;
+    const float x0 = nx, y0 = ny;
+    for (int i = 0; i < 5; ++i) {
+        float r2 = nx * nx + ny * ny;
+        float icdist = 1.0f / (1.0f + r2 * (k[0] + r2 * (k[1] + r2 * k[4])));
+        float dx = 2.0f * k[2] * nx * ny + k[3] * (r2 + 2.0f * nx * nx);
+        float dy = k[2] * (r2 + 2.0f * ny * ny) + 2.0f * k[3] * nx * ny;
+        nx = (x0 - dx) * icdist;
+        ny = (y0 - dy) * icdist;
+        clampRadius(nx, ny);
+    }
+    for (int i = 0; i < 10; ++i) {
+        float r2 = nx * nx + ny * ny;
+        float f = 1.0f + r2 * (k[0] + r2 * (k[1] + r2 * k[4]));
+        float df = k[0] + r2 * (2.0f * k[1] + 3.0f * r2 * k[4]);
+        float ex = nx * f + 2.0f * k[2] * nx * ny + k[3] * (r2 + 2.0f * nx * nx) - x0;
+        float ey = ny * f + k[2] * (r2 + 2.0f * ny * ny) + 2.0f * k[3] * nx * ny - y0;
+        float jxx = f + 2.0f * nx * nx * df + 2.0f * k[2] * ny + 6.0f * k[3] * nx;
+        float jxy = 2.0f * nx * ny * df + 2.0f * k[2] * nx + 2.0f * k[3] * ny;
+        float jyy = f + 2.0f * ny * ny * df + 6.0f * k[2] * ny + 2.0f * k[3] * nx;
+        float det = jxx * jyy - jxy * jxy;
+        if (std::abs(det) < 1e-12f) break;
+        float stepX = (jyy * ex - jxy * ey) / det;
+        float stepY = (jxx * ey - jxy * ex) / det;
+        nx -= stepX;
+        ny -= stepY;
+        clampRadius(nx, ny);
+        if (std::abs(stepX) + std::abs(stepY) < 1e-7f) break;
+    }
+    return {nx, ny};
+}
+
+cv::Point2f RayTable::ray(int x, int y) const {
+    if (x < 0 || y < 0 || x >= intr.width || y >= intr.height) {
+        return computeRay(static_cast<float>(x), static_cast<float>(y));
+    }
+    size_t i = static_cast<size_t>(y) * intr.width + x;
+    return {rayX[i], rayY[i]};
+}
+
+cv::Point2f RayTable::ray(const cv::Point2f& pixel) const {
+    if (!(pixel.x >= 0.0f && pixel.y >= 0.0f && pixel.x <= intr.width - 1 && pixel.y <= intr.height - 1)) {
+        return computeRay(pixel.x, pixel.y);
+    }
+    int x0 = std::min(static_cast<int>(pixel.x), std::max(intr.width - 2, 0));
+    int y0 = std::min(static_cast<int>(pixel.y), std::max(intr.height - 2, 0));
+    int x1 = std::min(x0 + 1, intr.width - 1);
+    int y1 = std::min(y0 + 1, intr.height - 1);
+    float fx = pixel.x - x0, fy = pixel.y - y0;
+
+    auto lerp2 = [&](const std::vector<float>& table) {
+        const float* top = table.data() + static_cast<size_t>(y0) * intr.width;
+        const float* bottom = table.data() + static_cast<size_t>(y1) * intr.width;
+        float t = top[x0] + (top[x1] - top[x0]) * fx;
+        float b = bottom[x0] + (bottom[x1] - bottom[x0]) * fx;
+        return t + (b - t) * fy;
+    };
+    return {lerp2(rayX), lerp2(rayY)};
+}
+
+cv::Point3f RayTable::unitRay(const cv::Point2f& pixel) const {
+    cv::Point2f r = ray(pixel);
+    float inv = 1.0f / std::sqrt(r.x * r.x + r.y * r.y + 1.0f);
+    return {r.x * inv, r.y * inv, inv};
+}
+
+cv::Point3f RayTable::backProject(const cv::Point2f& pixel, float depth) const {
+    if (!(depth > 0.0f)) return invalidPoint;
+    cv::Point2f r = ray(pixel);
+    return {r.x * depth, r.y * depth, depth};
+}
+
+void RayTable::backProject(const cv::Point2f* pixels, const float* depths, size_t count, cv::Point3f* points) const {
+    for (size_t i = 0; i < count; ++i) points[i] = backProject(pixels[i], depths[i]);
+}
+
+void RayTable::backProject(const cv::Point2f* pixels, size_t count, const cv::Mat& depth, float depthScale,
+                           cv::Point3f* points) const {
+    if (depth.type() != CV_16UC1) {
+        throw std::runtime_error("RayTable::backProject expects CV_16UC1 depth");
+    }
+    for (size_t i = 0; i < count; ++i) {
+        // Depth is sampled at the pixel the point falls in; the ray keeps
+        // the sub-pixel position.
+        int x = static_cast<int>(std::floor(pixels[i].x));
+        int y = static_cast<int>(std::floor(pixels[i].y));
+        if (x < 0 || y < 0 || x >= depth.cols || y >= depth.rows) {
+            points[i] = invalidPoint;
+            continue;
+        }
+        points[i] = backProject(pixels[i], depth.ptr<uint16_t>(y)[x] * depthScale);
+    }
+}
+
+void RayTable::backProject(const cv::Mat& depth, float depthScale, cv::Mat& points) const {
+    if (depth.type() != CV_16UC1 || depth.cols != intr.width || depth.rows != intr.height) {
+        throw std::runtime_error("RayTable::backProject: depth does not match the table");
+    }
+    points.create(depth.rows, depth.cols, CV_32FC3);
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    for (int y = 0; y < depth.rows; ++y) {
+        const uint16_t* d = depth.ptr<uint16_t>(y);
+        const float* rx = rowX(y);
+        const float* ry = rowY(y);
+        float* out = points.ptr<float>(y);
+        for (int x = 0; x < depth.cols; ++x) {
+            float z = d[x] * depthScale;
+            bool valid = d[x] != 0;
+            out[3 * x + 0] = valid ? rx[x] * z : nan;
+            out[3 * x + 1] = valid ? ry[x] * z : nan;
+            out[3 * x + 2] = valid ? z : nan;
+        }
+    }
+}
+
+} // namespace UsArMirror
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "frame_source.hpp"
+
+namespace UsArMirror {
+
+/// Undistorted viewing rays for every pixel of one camera.
+///
+/// Rays are stored normalised to z = 1, i.e. (x/z, y/z), which is what
+/// back-projecting Z16 depth needs: the point is simply ray * depth. The
+/// Brown-Conrady inversion is done once when the table is built, so every
+/// back-projection afterwards is a table fetch and a multiply.
+class RayTable {
+public:
+    /// Build the table for `intr`. Prefer get(), which shares tables.
+    explicit RayTable(const StreamIntrinsics& intr);
+
+    /// Shared table for `intr`, built on first use. Thread-safe; the table
+    /// is freed once nobody holds it.
+    static std::shared_ptr<const RayTable> get(const StreamIntrinsics& intr);
+
+    const StreamIntrinsics& intrinsics() const { return intr; }
+    int width() const { return intr.width; }
+    int height() const { return intr.height; }
+
+    /// Normalised ray components of one table row.
+    const float* rowX(int y) const { return rayX.data() + static_cast<size_t>(y) * intr.width; }
+    const float* rowY(int y) const { return rayY.data() + static_cast<size_t>(y) * intr.width; }
+
+    /// Normalised ray through pixel centre (x, y).
+    cv::Point2f ray(int x, int y) const;
+    /// Normalised ray at a sub-pixel position, bilinearly interpolated
+    /// inside the image and computed exactly outside it.
+    cv::Point2f ray(const cv::Point2f& pixel) const;
+    /// Same ray scaled to unit length.
+    cv::Point3f unitRay(const cv::Point2f& pixel) const;
+
+    /// Camera-space point (meters) at `pixel` with Z = `depth` meters.
+    cv::Point3f backProject(const cv::Point2f& pixel, float depth) const;
+    /// Back-project `count` pixels with depths in meters. Points without
+    /// depth (<= 0) come out as NaN.
+    void backProject(const cv::Point2f* pixels, const float* depths, size_t count, cv::Point3f* points) const;
+    /// Back-project `count` pixels, looking their depth up in a CV_16UC1
+    /// image registered to this camera. Pixels outside it or on a hole
+    /// come out as NaN.
+    void backProject(const cv::Point2f* pixels, size_t count, const cv::Mat& depth, float depthScale,
+                     cv::Point3f* points) const;
+    /// Whole CV_16UC1 image to a CV_32FC3 point cloud; holes become NaN.
+    void backProject(const cv::Mat& depth, float depthScale, cv::Mat& points) const;
+
+private:
+    cv::Point2f computeRay(float x, float y) const;
+    void clampRadius(float& x, float& y) const;
+
+    StreamIntrinsics intr;
+    bool distorted = false;
+    /// Largest undistorted radius the distortion model is invertible at.
+    float maxRadius = std::numeric_limits<float>::infinity();
+    std::vector<float> rayX;
+    std::vector<float> rayY;
+};
+
+} // namespace UsArMirror
@@ -0,0 +1,104 @@
+#include "realsense_source.hpp"
+
+#include <librealsense2/rs.hpp>
+#include <opencv2/core.hpp>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace UsArMirror {
+
+namespace {
+StreamIntrinsics toStreamIntrinsics(const rs2::stream_profile& profile) {
+    rs2_intrinsics intr = profile.as<rs2::video_stream_profile>().get_intrinsics();
+    StreamIntrinsics out;
+    out.fx = intr.fx;
+    out.fy = intr.fy;
+    out.cx = intr.ppx;
+    out.cy = intr.ppy;
+    out.width = intr.width;
+    out.height = intr.height;
+    switch (intr.model) {
+    case RS2_DISTORTION_NONE:
+    case RS2_DISTORTION_BROWN_CONRADY:
+        std::copy(std::begin(intr.coeffs), std::end(intr.coeffs), out.dist.begin());
+        break;
+    default:
+        // StreamIntrinsics is forward Brown-Conrady, which RayTable and
+        // DepthAligner invert. Other models (D4xx color reports inverse
+        // Brown-Conrady) would be bent the wrong way; treat them as
+        // undistorted instead.
+        spdlog::warn("RealSense {} stream uses distortion model {}; ignoring its coefficients",
+                     rs2_stream_to_string(profile.stream_type()), rs2_distortion_to_string(intr.model));
+        break;
+    }
+    return out;
+}
+} // namespace
+
+struct RealSenseSource::Impl {
+    rs2::pipeline pipe;
+    rs2::frameset frames;
+};
+
+RealSenseSource::RealSenseSource(const FrameSourceOptions& options) : impl(std::make_unique<Impl>()) {
+    try {
+        int fps = static_cast<int>(options.fps);
+        rs2::config cfg;
+        cfg.enable_stream(RS2_STREAM_COLOR, options.width, options.height, RS2_FORMAT_BGR8, fps);
+        cfg.enable_stream(RS2_STREAM_DEPTH, options.width, options.height, RS2_FORMAT_Z16, fps);
+        spdlog::info("Trying to start RealSense pipeline...");
+        rs2::pipeline_profile profile = impl->pipe.start(cfg);
+
+        caps.hasDepth = true;
+        caps.live = true;
+        caps.fps = fps;
+        caps.streams.color = toStreamIntrinsics(profile.get_stream(RS2_STREAM_COLOR));
+        caps.streams.depth = toStreamIntrinsics(profile.get_stream(RS2_STREAM_DEPTH));
+        rs2_extrinsics extr =
+            profile.get_stream(RS2_STREAM_DEPTH).get_extrinsics_to(profile.get_stream(RS2_STREAM_COLOR));
+        // librealsense stores the rotation column-major.
+        for (int r = 0; r < 3; ++r) {
+            for (int c = 0; c < 3; ++c) caps.streams.depthToColorRotation[r * 3 + c] = extr.rotation[c * 3 + r];
+        }
+        std::copy(std::begin(extr.translation), std::end(extr.translation),
+                  caps.streams.depthToColorTranslation.begin());
+        if (auto sensor = profile.get_device().first<rs2::depth_sensor>()) {
+            caps.streams.depthScale = sensor.get_depth_scale();
+        }
+    } catch (const rs2::error& e) {
+        throw std::runtime_error(std::string("RealSense error: ") + e.what());
+    }
+}
+
+RealSenseSource::~RealSenseSource() {
+    try {
+        impl->pipe.stop();
+    } catch (const rs2::error& e) {
+        spdlog::warn("Stopping RealSense pipeline failed: {}", e.what());
+    }
+}
+
+bool RealSenseSource::read(DepthCameraFrame& frame, std::chrono::milliseconds timeout) {
+    try {
+        // Block until librealsense delivers the next synchronised frameset;
+        // the timeout only bounds how long shutdown can take.
+        if (!impl->pipe.try_wait_for_frames(&impl->frames, static_cast<unsigned int>(timeout.count()))) {
+            return false;
+        }
+        rs2::video_frame color = impl->frames.get_color_frame();
+        rs2::depth_frame depth = impl->frames.get_depth_frame();
+        if (!color) return false;
+
+        frame.color = FrameHandle::fromSensor(color, CV_8UC3);
+        frame.depth = depth ? FrameHandle::fromSensor(depth, CV_16UC1) : FrameHandle();
+        frame.pose = cv::Mat();
+        return true;
+    } catch (const rs2::error& e) {
+        spdlog::error("RealSense error: {}", e.what());
+        return false;
+    }
+}
+
+} // namespace UsArMirror
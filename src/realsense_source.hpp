@@ -0,0 +1,29 @@
+#pragma once
+
+#include <memory>
+
+#include "frame_source.hpp"
+
+namespace UsArMirror {
+
+/// Color (BGR8) and depth (Z16) streams from the first RealSense device,
+/// each in its own camera's geometry; DepthAligner maps depth into color.
+/// Frames are handed out as librealsense buffers without copying.
+class RealSenseSource : public FrameSource {
+public:
+    /// Throws std::runtime_error if the pipeline cannot be started.
+    explicit RealSenseSource(const FrameSourceOptions& options);
+    ~RealSenseSource() override;
+
+    std::string name() const override { return "realsense"; }
+    const SourceCapabilities& capabilities() const override { return caps; }
+    bool read(DepthCameraFrame& frame, std::chrono::milliseconds timeout) override;
+
+private:
+    struct Impl;
+
+    std::unique_ptr<Impl> impl;
+    SourceCapabilities caps;
+};
+
+} // namespace UsArMirror
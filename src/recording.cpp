@@ -0,0 +1,387 @@
+#include "recording.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace UsArMirror {
+
+namespace {
+
+constexpr char recordingMagic[8] = {'U', 'A', 'R', 'R', 'E', 'C', '0', '1'};
+constexpr uint32_t recordingVersion = 1;
+constexpr size_t fileAlignment = 4096;
+
+enum RecordFlags : uint32_t {
+    HasDepth = 1u << 0,
+    HasPose = 1u << 1,
+};
+
+struct DiskIntrinsics {
+    float fx, fy, cx, cy;
+    int32_t width, height;
+    float dist[5];
+    float reserved;
+};
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t recordSize;
+    uint64_t frameCount;
+    DiskIntrinsics color;
+    DiskIntrinsics depth;
+    float depthScale;
+    uint32_t reserved;
+    /// Zero in files written before extrinsics were recorded.
+    float depthToColorRotation[9];
+    float depthToColorTranslation[3];
+};
+
+struct RecordHeader {
+    uint64_t sequence;
+    double colorTimestampMs;
+    double depthTimestampMs;
+    uint64_t colorFrameNumber;
+    uint64_t depthFrameNumber;
+    int64_t arrivalNs;
+    uint32_t flags;
+    uint32_t reserved;
+    float pose[16];
+};
+
+static_assert(std::is_trivially_copyable_v<FileHeader>);
+static_assert(std::is_trivially_copyable_v<RecordHeader>);
+static_assert(sizeof(FileHeader) <= fileAlignment);
+
+size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+/// Byte layout of one record: color first so it starts page aligned, then
+/// depth, then the record header.
+struct RecordLayout {
+    size_t colorBytes = 0;
+    size_t depthOffset = 0;
+    size_t depthBytes = 0;
+    size_t headerOffset = 0;
+    size_t recordSize = 0;
+
+    explicit RecordLayout(const RgbdStreamInfo& info) {
+        colorBytes = static_cast<size_t>(info.color.width) * info.color.height * 3;
+        depthOffset = alignUp(colorBytes, 64);
+        depthBytes = static_cast<size_t>(info.depth.width) * info.depth.height * 2;
+        headerOffset = alignUp(depthOffset + depthBytes, 64);
+        recordSize = alignUp(headerOffset + sizeof(RecordHeader), fileAlignment);
+    }
+};
+
+DiskIntrinsics toDisk(const StreamIntrinsics& in) {
+    DiskIntrinsics out{};
+    out.fx = in.fx;
+    out.fy = in.fy;
+    out.cx = in.cx;
+    out.cy = in.cy;
+    out.width = in.width;
+    out.height = in.height;
+    std::copy(in.dist.begin(), in.dist.end(), out.dist);
+    return out;
+}
+
+StreamIntrinsics fromDisk(const DiskIntrinsics& in) {
+    StreamIntrinsics out;
+    out.fx = in.fx;
+    out.fy = in.fy;
+    out.cx = in.cx;
+    out.cy = in.cy;
+    out.width = in.width;
+    out.height = in.height;
+    std::copy(std::begin(in.dist), std::end(in.dist), out.dist.begin());
+    return out;
+}
+
+void copyRows(const cv::Mat& src, uint8_t* dst, size_t rowBytes) {
+    for (int y = 0; y < src.rows; ++y) {
+        std::memcpy(dst + y * rowBytes, src.ptr(y), rowBytes);
+    }
+}
+
+bool writeAll(int fd, const void* data, size_t size, off_t offset) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        ssize_t n = pwrite(fd, bytes, size, offset);
+        if (n <= 0) return false;
+        bytes += n;
+        size -= static_cast<size_t>(n);
+        offset += n;
+    }
+    return true;
+}
+
+} // namespace
+
+RecordingWriter::RecordingWriter(const std::string& path, const RgbdStreamInfo& info)
+    : path(path), info(info) {
+    fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open recording for writing: " + path);
+    }
+    staging.resize(RecordLayout(info).recordSize);
+    writeHeader();
+    spdlog::info("Recording to {} ({}x{} color, {}x{} depth)", path, info.color.width, info.color.height,
+                 info.depth.width, info.depth.height);
+    writeThread = std::thread(&RecordingWriter::writeLoop, this);
+}
+
+RecordingWriter::~RecordingWriter() {
+    {
+        std::lock_guard lock(queueMutex);
+        running = false;
+    }
+    queueCondition.notify_all();
+    if (writeThread.joinable()) writeThread.join();
+
+    writeHeader();
+    close(fd);
+    spdlog::info("Recording {} closed: {} frames written, {} dropped", path, written.load(), dropped.load());
+}
+
+bool RecordingWriter::append(const DepthCameraFrame& frame, const cv::Mat& pose) {
+    const cv::Mat& color = frame.color.mat();
+    if (color.cols != info.color.width || color.rows != info.color.height || color.type() != CV_8UC3) {
+        ++dropped;
+        return false;
+    }
+    {
+        std::lock_guard lock(queueMutex);
+        if (queue.size() >= maxQueued) {
+            ++dropped;
+            return false;
+        }
+        queue.push_back({frame, pose});
+    }
+    queueCondition.notify_one();
+    return true;
+}
+
+void RecordingWriter::writeLoop() {
+    while (true) {
+        Pending pending;
+        {
+            std::unique_lock lock(queueMutex);
+            queueCondition.wait(lock, [&] { return !queue.empty() || !running; });
+            if (queue.empty()) return;
+            pending = std::move(queue.front());
+            queue.pop_front();
+        }
+        writeRecord(pending);
+    }
+}
+
+void RecordingWriter::writeRecord(const Pending& pending) {
+    RecordLayout layout(info);
+    const cv::Mat& color = pending.frame.color.mat();
+    const cv::Mat& depth = pending.frame.depth.mat();
+
+    RecordHeader header{};
+    header.sequence = written.load();
+    header.colorTimestampMs = pending.frame.color.timestamp();
+    header.colorFrameNumber = pending.frame.color.frameNumber();
+    header.arrivalNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           pending.frame.color.arrivalTime().time_since_epoch()).count();
+
+    copyRows(color, staging.data(), static_cast<size_t>(info.color.width) * 3);
+    if (!depth.empty() && depth.cols == info.depth.width && depth.rows == info.depth.height &&
+        depth.type() == CV_16UC1) {
+        copyRows(depth, staging.data() + layout.depthOffset, static_cast<size_t>(info.depth.width) * 2);
+        header.depthTimestampMs = pending.frame.depth.timestamp();
+        header.depthFrameNumber = pending.frame.depth.frameNumber();
+        header.flags |= HasDepth;
+    }
+    if (pending.pose.rows == 4 && pending.pose.cols == 4) {
+        cv::Mat pose;
+        pending.pose.convertTo(pose, CV_32F);
+        for (int i = 0; i < 16; ++i) header.pose[i] = pose.at<float>(i / 4, i % 4);
+        header.flags |= HasPose;
+    }
+    std::memcpy(staging.data() + layout.headerOffset, &header, sizeof(header));
+
+    off_t offset = static_cast<off_t>(fileAlignment + written.load() * layout.recordSize);
+    if (!writeAll(fd, staging.data(), layout.recordSize, offset)) {
+        spdlog::error("Failed to write frame {} to {}", written.load(), path);
+        ++dropped;
+        return;
+    }
+    ++written;
+}
+
+void RecordingWriter::writeHeader() {
+    FileHeader header{};
+    std::memcpy(header.magic, recordingMagic, sizeof(header.magic));
+    header.version = recordingVersion;
+    header.headerSize = fileAlignment;
+    header.recordSize = RecordLayout(info).recordSize;
+    header.frameCount = written.load();
+    header.color = toDisk(info.color);
+    header.depth = toDisk(info.depth);
+    header.depthScale = info.depthScale;
+    std::copy(info.depthToColorRotation.begin(), info.depthToColorRotation.end(), header.depthToColorRotation);
+    std::copy(info.depthToColorTranslation.begin(), info.depthToColorTranslation.end(),
+              header.depthToColorTranslation);
+
+    std::vector<uint8_t> block(fileAlignment, 0);
+    std::memcpy(block.data(), &header, sizeof(header));
+    if (!writeAll(fd, block.data(), block.size(), 0)) {
+        spdlog::error("Failed to write recording header to {}", path);
+    }
+}
+
+struct RecordingReader::Mapping {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+    ~Mapping() {
+        if (data) munmap(const_cast<uint8_t*>(data), size);
+    }
+};
+
+RecordingReader::RecordingReader(const std::string& path) : mapping(std::make_shared<Mapping>()) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open recording: " + path);
+    }
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < fileAlignment) {
+        close(fd);
+        throw std::runtime_error("Recording is truncated: " + path);
+    }
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error("Could not map recording: " + path);
+    }
+    mapping->data = static_cast<const uint8_t*>(data);
+    mapping->size = st.st_size;
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    FileHeader header;
+    std::memcpy(&header, mapping->data, sizeof(header));
+    if (std::memcmp(header.magic, recordingMagic, sizeof(header.magic)) != 0 ||
+        header.version != recordingVersion) {
+        throw std::runtime_error("Not a recording file: " + path);
+    }
+    // Records start at fileAlignment; a header claiming otherwise is corrupt.
+    if (header.headerSize != fileAlignment || header.headerSize > mapping->size) {
+        throw std::runtime_error("Recording has an unexpected header size: " + path);
+    }
+    streamInfo.color = fromDisk(header.color);
+    streamInfo.depth = fromDisk(header.depth);
+    streamInfo.depthScale = header.depthScale;
+    if (std::any_of(std::begin(header.depthToColorRotation), std::end(header.depthToColorRotation),
+                    [](float v) { return v != 0.0f; })) {
+        std::copy(std::begin(header.depthToColorRotation), std::end(header.depthToColorRotation),
+                  streamInfo.depthToColorRotation.begin());
+        std::copy(std::begin(header.depthToColorTranslation), std::end(header.depthToColorTranslation),
+                  streamInfo.depthToColorTranslation.begin());
+    }
+    if (RecordLayout(streamInfo).recordSize != header.recordSize) {
+        throw std::runtime_error("Recording has an unexpected record layout: " + path);
+    }
+
+    // Derive the count from the file size so recordings that were not
+    // closed cleanly are still readable up to the last complete record.
+    count = (mapping->size - fileAlignment) / header.recordSize;
+    spdlog::info("Opened recording {}: {} frames, {}x{} color", path, count, streamInfo.color.width,
+                 streamInfo.color.height);
+}
+
+const uint8_t* RecordingReader::record(size_t index) const {
+    return mapping->data + fileAlignment + index * RecordLayout(streamInfo).recordSize;
+}
+
+DepthCameraFrame RecordingReader::frame(size_t index) const {
+    RecordLayout layout(streamInfo);
+    const uint8_t* base = record(index);
+    RecordHeader header;
+    std::memcpy(&header, base + layout.headerOffset, sizeof(header));
+    auto arrival = FrameHandle::Clock::time_point(std::chrono::nanoseconds(header.arrivalNs));
+
+    DepthCameraFrame out;
+    cv::Mat color(streamInfo.color.height, streamInfo.color.width, CV_8UC3, const_cast<uint8_t*>(base));
+    out.color = FrameHandle::fromBuffer(color, mapping);
+    out.color.setTiming(header.colorTimestampMs, header.colorFrameNumber, arrival);
+
+    if (header.flags & HasDepth) {
+        cv::Mat depth(streamInfo.depth.height, streamInfo.depth.width, CV_16UC1,
+                      const_cast<uint8_t*>(base + layout.depthOffset));
+        out.depth = FrameHandle::fromBuffer(depth, mapping);
+        out.depth.setTiming(header.depthTimestampMs, header.depthFrameNumber, arrival);
+    }
+    if (header.flags & HasPose) {
+        out.pose = cv::Mat(4, 4, CV_32F);
+        for (int i = 0; i < 16; ++i) out.pose.at<float>(i / 4, i % 4) = header.pose[i];
+    }
+    return out;
+}
+
+double RecordingReader::timestamp(size_t index) const {
+    RecordHeader header;
+    std::memcpy(&header, record(index) + RecordLayout(streamInfo).headerOffset, sizeof(header));
+    return header.colorTimestampMs;
+}
+
+size_t RecordingReader::seek(double timestampMs) const {
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (timestamp(mid) < timestampMs) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+RecordingSource::RecordingSource(const std::string& path, const FrameSourceOptions& options)
+    : path(path), options(options), reader(path), pacer(options.pace) {
+    caps.hasDepth = true;
+    caps.hasPose = true;
+    caps.streams = reader.info();
+    if (reader.frameCount() > 1) {
+        double span = reader.timestamp(reader.frameCount() - 1) - reader.timestamp(0);
+        if (span > 0) caps.fps = 1000.0 * (reader.frameCount() - 1) / span;
+    }
+}
+
+bool RecordingSource::read(DepthCameraFrame& frame, std::chrono::milliseconds) {
+    if (done) return false;
+    if (index == reader.frameCount()) {
+        if (!options.loop || index == 0) {
+            done = true;
+            return false;
+        }
+        index = 0;
+        pacer.restart();
+    }
+
+    frame = reader.frame(index++);
+    pacer.wait(frame.color.timestamp());
+
+    // Consumers measure latency against arrival, so stamp it at playback.
+    auto arrival = FrameHandle::Clock::now();
+    frame.color.setTiming(frame.color.timestamp(), frame.color.frameNumber(), arrival);
+    if (frame.depth) frame.depth.setTiming(frame.depth.timestamp(), frame.depth.frameNumber(), arrival);
+    return true;
+}
+
+} // namespace UsArMirror
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frame_handle.hpp"
+#include "frame_source.hpp"
+
+namespace UsArMirror {
+
+/// Appends color, depth, timestamps and pose to a recording file.
+///
+/// The container is a fixed header followed by fixed-size, page-aligned
+/// records, so any frame can be located by index and read through a memory
+/// mapping without parsing. Writes happen on a background thread; append()
+/// never blocks the caller and drops frames when the queue is full.
+class RecordingWriter {
+public:
+    RecordingWriter(const std::string& path, const RgbdStreamInfo& info);
+    ~RecordingWriter();
+
+    RecordingWriter(const RecordingWriter&) = delete;
+    RecordingWriter& operator=(const RecordingWriter&) = delete;
+
+    /// Queue `frame` together with `pose` (4x4 extrinsics, may be empty).
+    bool append(const DepthCameraFrame& frame, const cv::Mat& pose);
+
+    uint64_t framesWritten() const { return written.load(); }
+    uint64_t framesDropped() const { return dropped.load(); }
+
+private:
+    struct Pending {
+        DepthCameraFrame frame;
+        cv::Mat pose;
+    };
+
+    void writeLoop();
+    void writeRecord(const Pending& pending);
+    void writeHeader();
+
+    std::string path;
+    RgbdStreamInfo info;
+    int fd = -1;
+    std::vector<uint8_t> staging;
+
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    std::deque<Pending> queue;
+    static constexpr size_t maxQueued = 4;
+
+    std::atomic<uint64_t> written = 0;
+    std::atomic<uint64_t> dropped = 0;
+    std::atomic<bool> running = true;
+    std::thread writeThread;
+};
+
+/// Read-only, memory-mapped view of a recording.
+class RecordingReader {
+public:
+    /// Throws std::runtime_error if the file is missing or not a recording.
+    explicit RecordingReader(const std::string& path);
+
+    const RgbdStreamInfo& info() const { return streamInfo; }
+    size_t frameCount() const { return count; }
+
+    /// Frames are views into the mapping; they stay valid after the reader
+    /// is destroyed for as long as any handle is alive. The recorded
+    /// extrinsics, if any, are returned in `pose`.
+    DepthCameraFrame frame(size_t index) const;
+    /// Color capture time of frame `index` in milliseconds.
+    double timestamp(size_t index) const;
+    /// Index of the first frame captured at or after `timestampMs`.
+    size_t seek(double timestampMs) const;
+
+private:
+    struct Mapping;
+
+    const uint8_t* record(size_t index) const;
+
+    std::shared_ptr<Mapping> mapping;
+    RgbdStreamInfo streamInfo;
+    size_t count = 0;
+};
+
+/// FrameSource replaying a recording.
+class RecordingSource : public FrameSource {
+public:
+    RecordingSource(const std::string& path, const FrameSourceOptions& options);
+
+    std::string name() const override { return "recording:" + path; }
+    const SourceCapabilities& capabilities() const override { return caps; }
+    bool read(DepthCameraFrame& frame, std::chrono::milliseconds timeout) override;
+    bool finished() const override { return done; }
+    SourcePace pace() const override { return options.pace; }
+
+private:
+    std::string path;
+    FrameSourceOptions options;
+    RecordingReader reader;
+    SourceCapabilities caps;
+    FramePacer pacer;
+    size_t index = 0;
+    bool done = false;
+};
+
+} // namespace UsArMirror
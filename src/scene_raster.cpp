@@ -0,0 +1,335 @@
+#include "scene_raster.hpp"
+
+#include <Eigen/Geometry>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+
+#include "tiny_gltf.h"
+
+namespace UsArMirror {
+
+namespace {
+
+constexpr float nearPlane = 0.05f;
+
+bool endsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/// Read element `i` of a float / normalised integer accessor as floats.
+template<int N>
+Eigen::Matrix<float, N, 1> readVector(const tinygltf::Model& model, const tinygltf::Accessor& accessor, size_t i) {
+    const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
+    const tinygltf::Buffer& buffer = model.buffers[view.buffer];
+    size_t stride = accessor.ByteStride(view);
+    const uint8_t* element = buffer.data.data() + view.byteOffset + accessor.byteOffset + i * stride;
+
+    Eigen::Matrix<float, N, 1> out;
+    for (int c = 0; c < N; ++c) {
+        switch (accessor.componentType) {
+        case TINYGLTF_COMPONENT_TYPE_FLOAT: {
+            float value;
+            std::memcpy(&value, element + c * sizeof(float), sizeof(float));
+            out[c] = value;
+            break;
+        }
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+            uint16_t value;
+            std::memcpy(&value, element + c * sizeof(uint16_t), sizeof(uint16_t));
+            out[c] = value / 65535.0f;
+            break;
+        }
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+            out[c] = element[c] / 255.0f;
+            break;
+        default:
+            out[c] = 0.0f;
+        }
+    }
+    return out;
+}
+
+uint32_t readIndex(const tinygltf::Model& model, const tinygltf::Accessor& accessor, size_t i) {
+    const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
+    const tinygltf::Buffer& buffer = model.buffers[view.buffer];
+    size_t stride = accessor.ByteStride(view);
+    const uint8_t* element = buffer.data.data() + view.byteOffset + accessor.byteOffset + i * stride;
+    switch (accessor.componentType) {
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+        return element[0];
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+        uint16_t value;
+        std::memcpy(&value, element, sizeof(value));
+        return value;
+    }
+    default: {
+        uint32_t value;
+        std::memcpy(&value, element, sizeof(value));
+        return value;
+    }
+    }
+}
+
+bool accessorValid(const tinygltf::Model& model, int index) {
+    if (index < 0 || index >= static_cast<int>(model.accessors.size())) return false;
+    const tinygltf::Accessor& accessor = model.accessors[index];
+    if (accessor.bufferView < 0 || accessor.bufferView >= static_cast<int>(model.bufferViews.size())) return false;
+    const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
+    if (view.buffer < 0 || view.buffer >= static_cast<int>(model.buffers.size())) return false;
+    int stride = accessor.ByteStride(view);
+    if (stride <= 0) return false;
+    size_t end = view.byteOffset + accessor.byteOffset + (accessor.count ? (accessor.count - 1) * stride : 0);
+    return end <= model.buffers[view.buffer].data.size();
+}
+
+Eigen::Matrix4f nodeTransform(const tinygltf::Node& node) {
+    Eigen::Matrix4f out = Eigen::Matrix4f::Identity();
+    if (node.matrix.size() == 16) {
+        for (int i = 0; i < 16; ++i) out(i % 4, i / 4) = static_cast<float>(node.matrix[i]);
+        return out;
+    }
+    Eigen::Affine3f transform = Eigen::Affine3f::Identity();
+    if (node.translation.size() == 3) {
+        transform.translate(Eigen::Vector3f(node.translation[0], node.translation[1], node.translation[2]));
+    }
+    if (node.rotation.size() == 4) {
+        transform.rotate(Eigen::Quaternionf(node.rotation[3], node.rotation[0], node.rotation[1], node.rotation[2]));
+    }
+    if (node.scale.size() == 3) {
+        transform.scale(Eigen::Vector3f(node.scale[0], node.scale[1], node.scale[2]));
+    }
+    return transform.matrix();
+}
+
+} // namespace
+
+SceneRasterizer::SceneRasterizer(const std::string& path, float size) {
+    tinygltf::Model model;
+    tinygltf::TinyGLTF loader;
+    std::string err, warn;
+    bool loaded = endsWith(path, ".glb") ? loader.LoadBinaryFromFile(&model, &err, &warn, path)
+                                         : loader.LoadASCIIFromFile(&model, &err, &warn, path);
+    if (!warn.empty()) spdlog::warn("glTF {}: {}", path, warn);
+    if (!loaded) {
+        throw std::runtime_error("Could not load glTF " + path + ": " + err);
+    }
+
+    for (const tinygltf::Image& image : model.images) {
+        Texture texture;
+        if (image.bits == 8 && image.component >= 3 && !image.image.empty()) {
+            texture.width = image.width;
+            texture.height = image.height;
+            texture.components = image.component;
+            texture.pixels = image.image;
+        }
+        textures.push_back(std::move(texture));
+    }
+    for (const tinygltf::Material& source : model.materials) {
+        Material material;
+        const auto& pbr = source.pbrMetallicRoughness;
+        for (int c = 0; c < 4 && c < static_cast<int>(pbr.baseColorFactor.size()); ++c) {
+            material.baseColor[c] = static_cast<float>(pbr.baseColorFactor[c]);
+        }
+        int textureIndex = pbr.baseColorTexture.index;
+        if (textureIndex >= 0 && textureIndex < static_cast<int>(model.textures.size())) {
+            int imageIndex = model.textures[textureIndex].source;
+            if (imageIndex >= 0 && imageIndex < static_cast<int>(textures.size()) &&
+                !textures[imageIndex].pixels.empty()) {
+                material.texture = imageIndex;
+            }
+        }
+        materials.push_back(material);
+    }
+    // Primitives without a material use the glTF default, opaque white.
+    int defaultMaterial = static_cast<int>(materials.size());
+    materials.emplace_back();
+
+    auto appendMesh = [&](const tinygltf::Mesh& mesh, const Eigen::Matrix4f& transform) {
+        for (const tinygltf::Primitive& primitive : mesh.primitives) {
+            if (primitive.mode != -1 && primitive.mode != TINYGLTF_MODE_TRIANGLES) continue;
+            auto position = primitive.attributes.find("POSITION");
+            if (position == primitive.attributes.end() || !accessorValid(model, position->second)) continue;
+            const tinygltf::Accessor& positionAccessor = model.accessors[position->second];
+            auto texcoord = primitive.attributes.find("TEXCOORD_0");
+            bool hasUv = texcoord != primitive.attributes.end() && accessorValid(model, texcoord->second) &&
+                         model.accessors[texcoord->second].count == positionAccessor.count;
+
+            uint32_t base = static_cast<uint32_t>(positions.size());
+            for (size_t i = 0; i < positionAccessor.count; ++i) {
+                Eigen::Vector4f p;
+                p << readVector<3>(model, positionAccessor, i), 1.0f;
+                positions.push_back((transform * p).head<3>());
+                uvs.push_back(hasUv ? readVector<2>(model, model.accessors[texcoord->second], i)
+                                    : Eigen::Vector2f::Zero());
+            }
+
+            int material = primitive.material >= 0 && primitive.material < defaultMaterial ? primitive.material
+                                                                                           : defaultMaterial;
+            size_t count = positionAccessor.count;
+            bool indexed = primitive.indices >= 0;
+            if (indexed) {
+                if (!accessorValid(model, primitive.indices)) continue;
+                count = model.accessors[primitive.indices].count;
+            }
+            for (size_t i = 0; i + 2 < count; i += 3) {
+                for (size_t k = 0; k < 3; ++k) {
+                    uint32_t index = indexed ? readIndex(model, model.accessors[primitive.indices], i + k)
+                                             : static_cast<uint32_t>(i + k);
+                    indices.push_back(base + std::min<uint32_t>(index, positionAccessor.count - 1));
+                }
+                triangleMaterials.push_back(material);
+            }
+        }
+    };
+
+    std::function<void(int, const Eigen::Matrix4f&)> visit = [&](int nodeIndex, const Eigen::Matrix4f& parent) {
+        if (nodeIndex < 0 || nodeIndex >= static_cast<int>(model.nodes.size())) return;
+        const tinygltf::Node& node = model.nodes[nodeIndex];
+        Eigen::Matrix4f transform = parent * nodeTransform(node);
+        if (node.mesh >= 0 && node.mesh < static_cast<int>(model.meshes.size())) {
+            appendMesh(model.meshes[node.mesh], transform);
+        }
+        for (int child : node.children) visit(child, transform);
+    };
+
+    if (!model.scenes.empty()) {
+        int scene = model.defaultScene >= 0 && model.defaultScene < static_cast<int>(model.scenes.size())
+                        ? model.defaultScene
+                        : 0;
+        for (int node : model.scenes[scene].nodes) visit(node, Eigen::Matrix4f::Identity());
+    } else {
+        for (const tinygltf::Mesh& mesh : model.meshes) appendMesh(mesh, Eigen::Matrix4f::Identity());
+    }
+
+    if (indices.empty()) {
+        throw std::runtime_error("glTF " + path + " has no triangles");
+    }
+
+    Eigen::Vector3f lo = positions.front(), hi = positions.front();
+    for (const Eigen::Vector3f& p : positions) {
+        lo = lo.cwiseMin(p);
+        hi = hi.cwiseMax(p);
+    }
+    Eigen::Vector3f centre = 0.5f * (lo + hi);
+    float extent = (hi - lo).maxCoeff();
+    float scale = extent > 0.0f ? size / extent : 1.0f;
+    for (Eigen::Vector3f& p : positions) p = (p - centre) * scale;
+
+    spdlog::info("Loaded glTF {}: {} triangles, {} materials, {} textures", path, triangleCount(),
+                 materials.size() - 1, textures.size());
+}
+
+Eigen::Vector3f SceneRasterizer::sample(const Material& material, const Eigen::Vector2f& uv) const {
+    Eigen::Vector3f rgb = material.baseColor.head<3>();
+    if (material.texture < 0) return rgb;
+
+    const Texture& texture = textures[material.texture];
+    float u = uv.x() - std::floor(uv.x());
+    float v = uv.y() - std::floor(uv.y());
+    int x = std::min(static_cast<int>(u * texture.width), texture.width - 1);
+    int y = std::min(static_cast<int>(v * texture.height), texture.height - 1);
+    const uint8_t* texel = texture.pixels.data() + (static_cast<size_t>(y) * texture.width + x) * texture.components;
+    return rgb.cwiseProduct(Eigen::Vector3f(texel[0], texel[1], texel[2]) / 255.0f);
+}
+
+void SceneRasterizer::render(const Eigen::Matrix4f& modelToCamera, const StreamIntrinsics& intr, float depthScale,
+                             float wallDepth, uint8_t* bgr, size_t bgrStep, uint16_t* depth, size_t depthStep) {
+    const int width = intr.width, height = intr.height;
+    auto toDepthUnits = [&](float z) {
+        return static_cast<uint16_t>(std::min(65535.0f, std::round(z / depthScale)));
+    };
+
+    // Wall: grey checkerboard, large enough to survive downscaling.
+    zBuffer.assign(static_cast<size_t>(width) * height, wallDepth);
+    uint16_t wall = toDepthUnits(wallDepth);
+    for (int y = 0; y < height; ++y) {
+        uint8_t* c = bgr + y * bgrStep;
+        auto* d = reinterpret_cast<uint16_t*>(reinterpret_cast<uint8_t*>(depth) + y * depthStep);
+        for (int x = 0; x < width; ++x) {
+            uint8_t shade = ((x >> 5) ^ (y >> 5)) & 1 ? 96 : 64;
+            c[3 * x + 0] = c[3 * x + 1] = c[3 * x + 2] = shade;
+            d[x] = wall;
+        }
+    }
+
+    const Eigen::Matrix3f rotation = modelToCamera.topLeftCorner<3, 3>();
+    const Eigen::Vector3f translation = modelToCamera.topRightCorner<3, 1>();
+
+    for (size_t t = 0; t < triangleMaterials.size(); ++t) {
+        Eigen::Vector3f v[3];
+        Eigen::Vector2f uv[3];
+        bool clipped = false;
+        for (int k = 0; k < 3; ++k) {
+            uint32_t index = indices[3 * t + k];
+            v[k] = rotation * positions[index] + translation;
+            uv[k] = uvs[index];
+            clipped |= v[k].z() < nearPlane;
+        }
+        if (clipped) continue;
+
+        // Flat shading with the light at the camera; both faces are lit.
+        Eigen::Vector3f normal = (v[1] - v[0]).cross(v[2] - v[0]);
+        float normalLength = normal.norm();
+        if (normalLength <= 0.0f) continue;
+        Eigen::Vector3f centroid = (v[0] + v[1] + v[2]) / 3.0f;
+        float lambert = std::abs(normal.dot(centroid)) / (normalLength * centroid.norm());
+        float shade = 0.25f + 0.75f * lambert;
+
+        float px[3], py[3], invZ[3];
+        for (int k = 0; k < 3; ++k) {
+            invZ[k] = 1.0f / v[k].z();
+            px[k] = intr.fx * v[k].x() * invZ[k] + intr.cx;
+            py[k] = intr.fy * v[k].y() * invZ[k] + intr.cy;
+        }
+        float area = (px[1] - px[0]) * (py[2] - py[0]) - (px[2] - px[0]) * (py[1] - py[0]);
+        if (std::abs(area) < 1e-8f) continue;
+
+        int x0 = std::max(0, static_cast<int>(std::floor(std::min({px[0], px[1], px[2]}))));
+        int x1 = std::min(width - 1, static_cast<int>(std::ceil(std::max({px[0], px[1], px[2]}))));
+        int y0 = std::max(0, static_cast<int>(std::floor(std::min({py[0], py[1], py[2]}))));
+        int y1 = std::min(height - 1, static_cast<int>(std::ceil(std::max({py[0], py[1], py[2]}))));
+        if (x0 > x1 || y0 > y1) continue;
+
+        const Material& material = materials[triangleMaterials[t]];
+        bool textured = material.texture >= 0;
+        Eigen::Vector3f flat = sample(material, Eigen::Vector2f::Zero()) * shade;
+
+        for (int y = y0; y <= y1; ++y) {
+            float sy = y + 0.5f;
+            uint8_t* c = bgr + y * bgrStep;
+            auto* d = reinterpret_cast<uint16_t*>(reinterpret_cast<uint8_t*>(depth) + y * depthStep);
+            float* z = zBuffer.data() + static_cast<size_t>(y) * width;
+            for (int x = x0; x <= x1; ++x) {
+                float sx = x + 0.5f;
+                float w0 = ((px[1] - sx) * (py[2] - sy) - (px[2] - sx) * (py[1] - sy)) / area;
+                float w1 = ((px[2] - sx) * (py[0] - sy) - (px[0] - sx) * (py[2] - sy)) / area;
+                float w2 = 1.0f - w0 - w1;
+                if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) continue;
+
+                // Perspective-correct depth and texture coordinates.
+                float inverseDepth = w0 * invZ[0] + w1 * invZ[1] + w2 * invZ[2];
+                float pixelDepth = 1.0f / inverseDepth;
+                if (pixelDepth >= z[x]) continue;
+                z[x] = pixelDepth;
+                d[x] = toDepthUnits(pixelDepth);
+
+                Eigen::Vector3f rgb = flat;
+                if (textured) {
+                    Eigen::Vector2f texcoord =
+                        (w0 * invZ[0] * uv[0] + w1 * invZ[1] * uv[1] + w2 * invZ[2] * uv[2]) * pixelDepth;
+                    rgb = sample(material, texcoord) * shade;
+                }
+                c[3 * x + 0] = static_cast<uint8_t>(std::min(255.0f, rgb.z() * 255.0f));
+                c[3 * x + 1] = static_cast<uint8_t>(std::min(255.0f, rgb.y() * 255.0f));
+                c[3 * x + 2] = static_cast<uint8_t>(std::min(255.0f, rgb.x() * 255.0f));
+            }
+        }
+    }
+}
+
+} // namespace UsArMirror
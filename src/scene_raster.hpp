@@ -0,0 +1,60 @@
+#pragma once
+
+#include <Eigen/Core>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "frame_source.hpp"
+
+namespace UsArMirror {
+
+/// Software rasterizer for glTF meshes.
+///
+/// Renders a model into aligned BGR8 color and Z16 depth with the exact
+/// intrinsics and pose it is given, without a GL context, so generated
+/// frames are bit-identical across machines and runs. Shading is flat
+/// Lambert lit from the camera over base color factors and textures.
+class SceneRasterizer {
+public:
+    /// Load `path` (.gltf or .glb) and normalise it to be centred at the
+    /// origin with its largest extent equal to `size` metres. Throws
+    /// std::runtime_error if the file cannot be loaded or has no triangles.
+    explicit SceneRasterizer(const std::string& path, float size = 0.2f);
+
+    /// Render the model transformed by `modelToCamera` (4x4, metres) in
+    /// front of a fronto-parallel wall at `wallDepth` metres. `bgr` and
+    /// `depth` must hold intr.height rows of `bgrStep` / `depthStep` bytes.
+    void render(const Eigen::Matrix4f& modelToCamera, const StreamIntrinsics& intr, float depthScale,
+                float wallDepth, uint8_t* bgr, size_t bgrStep, uint16_t* depth, size_t depthStep);
+
+    size_t triangleCount() const { return indices.size() / 3; }
+
+private:
+    struct Texture {
+        int width = 0;
+        int height = 0;
+        int components = 0;
+        std::vector<uint8_t> pixels;
+    };
+
+    struct Material {
+        Eigen::Vector4f baseColor = Eigen::Vector4f::Ones();
+        int texture = -1;
+    };
+
+    Eigen::Vector3f sample(const Material& material, const Eigen::Vector2f& uv) const;
+
+    std::vector<Eigen::Vector3f> positions;
+    std::vector<Eigen::Vector2f> uvs;
+    std::vector<uint32_t> indices;
+    /// Material index per triangle.
+    std::vector<int> triangleMaterials;
+    std::vector<Material> materials;
+    std::vector<Texture> textures;
+
+    std::vector<float> zBuffer;
+};
+
+} // namespace UsArMirror
@@ -0,0 +1,77 @@
+#include "scene_source.hpp"
+
+#include <Eigen/Geometry>
+#include <opencv2/core.hpp>
+
+#include <cmath>
+
+namespace UsArMirror {
+
+namespace {
+/// Distance of the model and the wall behind it, in metres.
+constexpr float modelDistance = 0.6f;
+constexpr float wallDistance = 1.5f;
+} // namespace
+
+SceneSource::SceneSource(const std::string& path, const FrameSourceOptions& options)
+    : path(path), options(options), rasterizer(path), pacer(options.pace) {
+    caps.hasDepth = true;
+    caps.hasPose = true;
+    caps.fps = options.fps;
+
+    StreamIntrinsics intr;
+    intr.width = options.width;
+    intr.height = options.height;
+    intr.fx = intr.fy = 0.9f * static_cast<float>(options.width);
+    intr.cx = 0.5f * static_cast<float>(options.width);
+    intr.cy = 0.5f * static_cast<float>(options.height);
+    caps.streams.color = intr;
+    caps.streams.depth = intr;
+    caps.streams.depthScale = 0.001f;
+
+    // Color and depth, one frame in flight.
+    framePool = std::make_unique<FramePool>(static_cast<size_t>(options.width) * options.height * 3,
+                                            poolBlockCount(options, 1, 2));
+}
+
+Eigen::Matrix4f SceneSource::poseAt(uint64_t frameNumber) const {
+    // Periods in seconds are mutually prime so the motion does not repeat
+    // for a long time.
+    float t = static_cast<float>(frameNumber / caps.fps);
+    float yaw = 0.6f * std::sin(2.0f * static_cast<float>(M_PI) * t / 7.0f);
+    float pitch = 0.2f * std::sin(2.0f * static_cast<float>(M_PI) * t / 5.0f);
+    float roll = 0.1f * std::sin(2.0f * static_cast<float>(M_PI) * t / 11.0f);
+
+    Eigen::Affine3f pose = Eigen::Affine3f::Identity();
+    pose.translate(Eigen::Vector3f(0.05f * std::sin(2.0f * static_cast<float>(M_PI) * t / 3.0f),
+                                   0.02f * std::sin(2.0f * static_cast<float>(M_PI) * t / 13.0f), modelDistance));
+    // glTF is y-up, the camera is y-down: turn the model upright first.
+    pose.rotate(Eigen::AngleAxisf(yaw, Eigen::Vector3f::UnitY()) * Eigen::AngleAxisf(pitch, Eigen::Vector3f::UnitX()) *
+                Eigen::AngleAxisf(roll, Eigen::Vector3f::UnitZ()) *
+                Eigen::AngleAxisf(static_cast<float>(M_PI), Eigen::Vector3f::UnitX()));
+    return pose.matrix();
+}
+
+bool SceneSource::read(DepthCameraFrame& frame, std::chrono::milliseconds) {
+    double timestamp = static_cast<double>(frameCounter) * 1000.0 / caps.fps;
+    pacer.wait(timestamp);
+
+    Eigen::Matrix4f pose = poseAt(frameCounter);
+    FrameHandle color = framePool->allocate(options.height, options.width, CV_8UC3);
+    FrameHandle depth = framePool->allocate(options.height, options.width, CV_16UC1);
+    rasterizer.render(pose, caps.streams.color, caps.streams.depthScale, wallDistance, color.mat().data,
+                      color.mat().step, reinterpret_cast<uint16_t*>(depth.mat().data), depth.mat().step);
+
+    ++frameCounter;
+    auto arrival = FrameHandle::Clock::now();
+    color.setTiming(timestamp, frameCounter, arrival);
+    depth.setTiming(timestamp, frameCounter, arrival);
+    frame.color = std::move(color);
+    frame.depth = std::move(depth);
+    frame.pose = cv::Mat(4, 4, CV_32F);
+    for (int r = 0; r < 4; ++r)
+        for (int c = 0; c < 4; ++c) frame.pose.at<float>(r, c) = pose(r, c);
+    return true;
+}
+
+} // namespace UsArMirror
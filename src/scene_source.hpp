@@ -0,0 +1,39 @@
+#pragma once
+
+#include <memory>
+
+#include "frame_source.hpp"
+#include "scene_raster.hpp"
+
+namespace UsArMirror {
+
+/// Renders a glTF model into paired BGR8 + Z16 frames with ground truth.
+///
+/// The model turns and drifts in front of a wall on a fixed schedule
+/// driven by the frame number, so every run sees identical frames. Each
+/// frame carries the exact model-to-camera transform as its pose, and the
+/// capabilities report the intrinsics used for rendering.
+class SceneSource : public FrameSource {
+public:
+    /// Throws std::runtime_error if `path` cannot be loaded.
+    SceneSource(const std::string& path, const FrameSourceOptions& options);
+
+    std::string name() const override { return "scene:" + path; }
+    const SourceCapabilities& capabilities() const override { return caps; }
+    bool read(DepthCameraFrame& frame, std::chrono::milliseconds timeout) override;
+    SourcePace pace() const override { return options.pace; }
+
+    /// Model-to-camera transform of frame `frameNumber` (0-based).
+    Eigen::Matrix4f poseAt(uint64_t frameNumber) const;
+
+private:
+    std::string path;
+    FrameSourceOptions options;
+    SceneRasterizer rasterizer;
+    SourceCapabilities caps;
+    std::unique_ptr<FramePool> framePool;
+    FramePacer pacer;
+    uint64_t frameCounter = 0;
+};
+
+} // namespace UsArMirror
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <opencv2/opencv.hpp>
+#include <atomic>
 #include <thread>
 #include <mutex>
 #include <optional>
@@ -8,17 +9,40 @@
 #include <glad/glad.h>
 
 #include "common.hpp"
+#include "frame_handle.hpp"
+#include "frame_history.hpp"
+#include "frame_source.hpp"
+#include "frame_texture.hpp"
+#include "ray_table.hpp"
+#include "triple_buffer.hpp"
 
 namespace UsArMirror {
 
 class CameraInput {
 public:
+    using FrameBuffer = TripleBuffer<FrameHandle>;
+    using FrameRef = FrameBuffer::ReadHandle;
+    using History = FrameHistory<FrameHandle, 8>;
+
     CameraInput(const std::shared_ptr<State>& state, int idx);
     CameraInput(const std::shared_ptr<State>& state, int idx, int rotateCode);
+    /// Take color frames from any source; depth, if present, is ignored.
+    CameraInput(const std::shared_ptr<State>& state, std::unique_ptr<FrameSource> source);
     ~CameraInput();
 
     bool getFrame(cv::Mat& outputFrame);
+    /// Pin the latest frame without copying it.
+    FrameRef acquireFrame() const;
+    /// Block until a frame newer than sequence `after` arrives.
+    FrameRef waitForFrame(uint64_t after, std::chrono::milliseconds timeout) const;
     void render(); // Renders camera feed (defaults to right-half of screen)
+    /// Recently published frames, keyed by the FrameRef sequence; empty
+    /// unless keepHistory is set.
+    const History& getHistory() const { return history; }
+    /// Fill getHistory(). Off by default, as nothing reads it yet; open the
+    /// source with FrameSourceOptions::retainedFrames = History::capacity()
+    /// when setting it so the source pool covers the retained frames.
+    std::atomic<bool> keepHistory = false;
 
     int width, height;
 
@@ -40,23 +64,28 @@ public:
         cv::Mat getDist() const {
             return cv::Mat(1, 5, CV_32F, (void*)dist.data()).clone();
         }
+
+        StreamIntrinsics toStream() const { return {fx, fy, cx, cy, width, height, dist}; }
+        /// Shared undistorted ray table for these intrinsics.
+        std::shared_ptr<const RayTable> rays() const { return RayTable::get(toStream()); }
     };
 
 private:
     void captureLoop();
-    void createGlTexture();
+
+    /// Bounds how long the capture thread blocks, i.e. how quickly it
+    /// notices shutdown.
+    static constexpr unsigned int captureTimeoutMs = 100;
 
     std::shared_ptr<State> state;
-    bool running;
-    cv::VideoCapture cap;
+    std::unique_ptr<FrameSource> source;
+    std::atomic<bool> running;
 
-    cv::Mat frame;
-    std::mutex frameMutex;
+    FrameBuffer frames;
+    History history;
 
-    GLuint textureId;
+    FrameTexture texture;
     std::thread captureThread;
-
-    std::optional<int> rotateCode;
 };
 
 } // namespace UsArMirror
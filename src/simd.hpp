@@ -0,0 +1,54 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace UsArMirror::simd {
+
+// Portable 4-lane vectors via GCC/Clang vector extensions: one SSE register
+// on x86, one NEON register on ARM. Kernels are written once as templates
+// over V = float (borders, tails) or V = f32x4 (bulk of a row).
+using f32x4 = float __attribute__((vector_size(16)));
+using i32x4 = int32_t __attribute__((vector_size(16)));
+using u16x4 = uint16_t __attribute__((vector_size(8)));
+constexpr int lanes = 4;
+
+template<typename V> V splat(float value);
+template<> inline float splat<float>(float value) { return value; }
+template<> inline f32x4 splat<f32x4>(float value) { return f32x4{} + value; }
+
+inline float select(bool mask, float a, float b) { return mask ? a : b; }
+inline f32x4 select(i32x4 mask, f32x4 a, f32x4 b) { return mask ? a : b; }
+
+inline float absolute(float v) { return std::abs(v); }
+inline f32x4 absolute(f32x4 v) { return reinterpret_cast<f32x4>(reinterpret_cast<i32x4>(v) & 0x7fffffff); }
+
+inline float maximum(float a, float b) { return std::max(a, b); }
+inline f32x4 maximum(f32x4 a, f32x4 b) { return a > b ? a : b; }
+inline float minimum(float a, float b) { return std::min(a, b); }
+inline f32x4 minimum(f32x4 a, f32x4 b) { return a < b ? a : b; }
+
+/// Unaligned loads and stores.
+inline f32x4 load(const float* p) {
+    f32x4 v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+inline void store(float* p, f32x4 v) { std::memcpy(p, &v, sizeof(v)); }
+
+/// uint16_t lanes widened to float. Goes through int32 because the direct
+/// u16 -> float conversion is scalarised.
+inline f32x4 loadU16(const uint16_t* p) {
+    u16x4 v;
+    std::memcpy(&v, p, sizeof(v));
+    return __builtin_convertvector(__builtin_convertvector(v, i32x4), f32x4);
+}
+/// Rounded to nearest; `v` must be within [0, 65535].
+inline void storeU16(uint16_t* p, f32x4 v) {
+    u16x4 out = __builtin_convertvector(__builtin_convertvector(v + 0.5f, i32x4), u16x4);
+    std::memcpy(p, &out, sizeof(out));
+}
+
+} // namespace UsArMirror::simd
@@ -0,0 +1,74 @@
+#include "synthetic_source.hpp"
+
+#include <opencv2/opencv.hpp>
+
+#include <cmath>
+
+namespace UsArMirror {
+
+namespace {
+/// Plane depth at the left and right edge, disc depth, in millimetres.
+constexpr uint16_t planeNearMm = 1200;
+constexpr uint16_t planeFarMm = 2000;
+constexpr uint16_t discMm = 800;
+} // namespace
+
+SyntheticSource::SyntheticSource(const FrameSourceOptions& options) : options(options), pacer(options.pace) {
+    caps.hasDepth = true;
+    caps.fps = options.fps;
+
+    StreamIntrinsics intr;
+    intr.width = options.width;
+    intr.height = options.height;
+    intr.fx = intr.fy = 0.9f * static_cast<float>(options.width);
+    intr.cx = 0.5f * static_cast<float>(options.width);
+    intr.cy = 0.5f * static_cast<float>(options.height);
+    caps.streams.color = intr;
+    caps.streams.depth = intr;
+    caps.streams.depthScale = 0.001f;
+
+    // Color and depth, one frame in flight.
+    framePool = std::make_unique<FramePool>(static_cast<size_t>(options.width) * options.height * 3,
+                                            poolBlockCount(options, 1, 2));
+}
+
+bool SyntheticSource::read(DepthCameraFrame& frame, std::chrono::milliseconds) {
+    int rows = options.height, cols = options.width;
+    double timestamp = static_cast<double>(frameCounter) * 1000.0 / caps.fps;
+    pacer.wait(timestamp);
+
+    FrameHandle color = framePool->allocate(rows, cols, CV_8UC3);
+    FrameHandle depth = framePool->allocate(rows, cols, CV_16UC1);
+
+    // Disc circling the centre once every four seconds.
+    double phase = timestamp / 4000.0 * 2.0 * M_PI;
+    int discX = cols / 2 + static_cast<int>(std::cos(phase) * cols / 4);
+    int discY = rows / 2 + static_cast<int>(std::sin(phase) * rows / 4);
+    int radius = rows / 8;
+    int shift = static_cast<int>(frameCounter % 256);
+
+    for (int y = 0; y < rows; ++y) {
+        auto* c = color.mat().ptr<uint8_t>(y);
+        auto* d = depth.mat().ptr<uint16_t>(y);
+        for (int x = 0; x < cols; ++x) {
+            int dx = x - discX, dy = y - discY;
+            bool onDisc = dx * dx + dy * dy <= radius * radius;
+            bool checker = ((x >> 5) ^ (y >> 5)) & 1;
+            c[3 * x + 0] = onDisc ? 40 : static_cast<uint8_t>((x + shift) & 0xff);
+            c[3 * x + 1] = onDisc ? 200 : static_cast<uint8_t>(checker ? 160 : 60);
+            c[3 * x + 2] = onDisc ? 240 : static_cast<uint8_t>(y * 255 / rows);
+            d[x] = onDisc ? discMm : static_cast<uint16_t>(planeNearMm + (planeFarMm - planeNearMm) * x / cols);
+        }
+    }
+
+    ++frameCounter;
+    auto arrival = FrameHandle::Clock::now();
+    color.setTiming(timestamp, frameCounter, arrival);
+    depth.setTiming(timestamp, frameCounter, arrival);
+    frame.color = std::move(color);
+    frame.depth = std::move(depth);
+    frame.pose = cv::Mat();
+    return true;
+}
+
+} // namespace UsArMirror
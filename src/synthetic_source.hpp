@@ -0,0 +1,29 @@
+#pragma once
+
+#include <memory>
+
+#include "frame_source.hpp"
+
+namespace UsArMirror {
+
+/// Generated color + Z16 depth: a disc moving in front of a tilted plane.
+/// Output is deterministic per frame number, so runs are reproducible
+/// without any hardware or data files.
+class SyntheticSource : public FrameSource {
+public:
+    explicit SyntheticSource(const FrameSourceOptions& options);
+
+    std::string name() const override { return "synthetic"; }
+    const SourceCapabilities& capabilities() const override { return caps; }
+    bool read(DepthCameraFrame& frame, std::chrono::milliseconds timeout) override;
+    SourcePace pace() const override { return options.pace; }
+
+private:
+    FrameSourceOptions options;
+    SourceCapabilities caps;
+    std::unique_ptr<FramePool> framePool;
+    FramePacer pacer;
+    uint64_t frameCounter = 0;
+};
+
+} // namespace UsArMirror
@@ -0,0 +1,115 @@
+// Compares AprilTags::TagDetector with TiledTagDetector on one image.
+//
+//   tag_benchmark [image] [iterations]
+//
+// Defaults to captured_images/frame_209.png. Prints the time per call of
+// each detector and, for tags both find, how far their corners and poses
+// are apart.
+
+#include <Eigen/Dense>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AprilTags/Tag25h9.h"
+#include "AprilTags/TagDetector.h"
+#include "tag_detector.hpp"
+
+namespace {
+
+// Color camera intrinsics and tag size used by DepthCameraInput.
+constexpr double fx = 302.02243162;
+constexpr double fy = 301.80520504;
+constexpr double cx = 324.73866457;
+constexpr double cy = 216.85437825;
+constexpr double tagSize = 0.0736;
+
+struct Timing {
+    double median = 0.0;
+    double best = 0.0;
+};
+
+Timing measure(int iterations, const std::function<void()>& run) {
+    std::vector<double> times;
+    run(); // warm-up: allocations, code tables
+    for (int i = 0; i < iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(times.begin(), times.end());
+    return {times[times.size() / 2], times.front()};
+}
+
+void compare(const std::vector<AprilTags::TagDetection>& reference, const std::vector<AprilTags::TagDetection>& tiled) {
+    for (const AprilTags::TagDetection& a : reference) {
+        auto b = std::find_if(tiled.begin(), tiled.end(),
+                              [&](const AprilTags::TagDetection& d) { return d.id == a.id; });
+        if (b == tiled.end()) {
+            std::printf("  tag %d: missed by the tiled detector\n", a.id);
+            continue;
+        }
+        double corner = 0.0;
+        for (int i = 0; i < 4; ++i) {
+            corner = std::max<double>(corner, std::hypot(a.p[i].first - b->p[i].first, a.p[i].second - b->p[i].second));
+        }
+        Eigen::Vector3d ta, tb;
+        Eigen::Matrix3d ra, rb;
+        a.getRelativeTranslationRotation(tagSize, fx, fy, cx, cy, ta, ra);
+        b->getRelativeTranslationRotation(tagSize, fx, fy, cx, cy, tb, rb);
+        double angle = Eigen::AngleAxisd(ra.transpose() * rb).angle() * 180.0 / M_PI;
+        std::printf("  tag %d: corners within %.2f px, translation within %.1f mm, rotation within %.2f deg\n", a.id,
+                    corner, (ta - tb).norm() * 1000.0, angle);
+    }
+    for (const AprilTags::TagDetection& b : tiled) {
+        bool known = std::any_of(reference.begin(), reference.end(),
+                                 [&](const AprilTags::TagDetection& d) { return d.id == b.id; });
+        if (!known) std::printf("  tag %d: found only by the tiled detector\n", b.id);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string path = argc > 1 ? argv[1] : "captured_images/frame_209.png";
+    int iterations = argc > 2 ? std::max(1, std::atoi(argv[2])) : 20;
+
+    cv::Mat color = cv::imread(path, cv::IMREAD_COLOR);
+    if (color.empty()) {
+        std::fprintf(stderr, "Cannot read %s\n", path.c_str());
+        return 1;
+    }
+    cv::Mat gray;
+    cv::cvtColor(color, gray, cv::COLOR_BGR2GRAY);
+    std::printf("%s: %dx%d, %d iterations\n", path.c_str(), gray.cols, gray.rows, iterations);
+
+    AprilTags::TagDetector legacy(AprilTags::tagCodes25h9);
+    std::vector<AprilTags::TagDetection> reference;
+    Timing legacyTime = measure(iterations, [&] { reference = legacy.extractTags(gray); });
+    std::printf("AprilTags::TagDetector       %8.2f ms median, %8.2f ms best, %zu tags\n", legacyTime.median,
+                legacyTime.best, reference.size());
+
+    std::vector<size_t> threadCounts = {1};
+    size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+    if (hardware > 1) threadCounts.push_back(hardware);
+    for (size_t threads : threadCounts) {
+        UsArMirror::TiledTagDetector tiled(AprilTags::tagCodes25h9, 2, UsArMirror::TagDetectorOptions(),
+                                           std::make_shared<UsArMirror::ThreadPool>(threads));
+        std::vector<AprilTags::TagDetection> detections;
+        Timing time = measure(iterations, [&] { detections = tiled.extractTags(gray); });
+        std::printf("TiledTagDetector, %2zu thread%s %8.2f ms median, %8.2f ms best, %zu tags (%.1fx)\n", threads,
+                    threads == 1 ? " " : "s", time.median, time.best, detections.size(),
+                    legacyTime.median / time.median);
+        if (threads == threadCounts.back()) compare(reference, detections);
+    }
+    return 0;
+}
@@ -0,0 +1,218 @@
+#include "tag_bundle.hpp"
+
+#include <opencv2/core.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace UsArMirror {
+
+namespace {
+
+struct Correspondence {
+    Eigen::Vector3d board;
+    Eigen::Vector2d pixel;
+};
+
+/// Area of the quad spanned by the detection's corners, in pixels.
+double quadArea(const AprilTags::TagDetection& detection) {
+    double twiceArea = 0.0;
+    for (int i = 0; i < 4; ++i) {
+        const auto& a = detection.p[i];
+        const auto& b = detection.p[(i + 1) % 4];
+        twiceArea += static_cast<double>(a.first) * b.second - static_cast<double>(b.first) * a.second;
+    }
+    return std::abs(twiceArea) * 0.5;
+}
+
+/// Pose of a square tag of side `size` from its four image corners: the
+/// tag-plane homography decomposed into rotation and translation.
+void planarPose(const AprilTags::TagDetection& detection, double size, double fx, double fy, double cx, double cy,
+                Eigen::Matrix3d& rotation, Eigen::Vector3d& translation) {
+    const double h = size * 0.5;
+    const double local[4][2] = {{-h, -h}, {h, -h}, {h, h}, {-h, h}};
+
+    // Homography from the tag plane to normalized image coordinates, h33 = 1.
+    Eigen::Matrix<double, 8, 8> a;
+    Eigen::Matrix<double, 8, 1> b;
+    for (int i = 0; i < 4; ++i) {
+        double x = local[i][0], y = local[i][1];
+        double u = (detection.p[i].first - cx) / fx;
+        double v = (detection.p[i].second - cy) / fy;
+        a.row(2 * i) << x, y, 1, 0, 0, 0, -u * x, -u * y;
+        a.row(2 * i + 1) << 0, 0, 0, x, y, 1, -v * x, -v * y;
+        b(2 * i) = u;
+        b(2 * i + 1) = v;
+    }
+    Eigen::Matrix<double, 8, 1> solution = a.partialPivLu().solve(b);
+    Eigen::Matrix3d homography;
+    homography << solution(0), solution(1), solution(2), solution(3), solution(4), solution(5), solution(6),
+        solution(7), 1.0;
+
+    Eigen::Vector3d h1 = homography.col(0), h2 = homography.col(1), h3 = homography.col(2);
+    double scale = 2.0 / (h1.norm() + h2.norm());
+    // The tag is in front of the camera.
+    if (h3.z() * scale < 0.0) scale = -scale;
+    Eigen::Matrix3d approximate;
+    approximate.col(0) = h1 * scale;
+    approximate.col(1) = h2 * scale;
+    approximate.col(2) = approximate.col(0).cross(approximate.col(1));
+
+    Eigen::JacobiSVD<Eigen::Matrix3d> svd(approximate, Eigen::ComputeFullU | Eigen::ComputeFullV);
+    rotation = svd.matrixU() * svd.matrixV().transpose();
+    if (rotation.determinant() < 0.0) {
+        Eigen::Matrix3d u = svd.matrixU();
+        u.col(2) = -u.col(2);
+        rotation = u * svd.matrixV().transpose();
+    }
+    translation = h3 * scale;
+}
+
+Eigen::Matrix3d skew(const Eigen::Vector3d& v) {
+    Eigen::Matrix3d m;
+    m << 0, -v.z(), v.y(), v.z(), 0, -v.x(), -v.y(), v.x(), 0;
+    return m;
+}
+
+} // namespace
+
+std::array<Eigen::Vector3d, 4> BundleTag::corners() const {
+    const double h = size * 0.5;
+    return {center + rotation * Eigen::Vector3d(-h, -h, 0.0), center + rotation * Eigen::Vector3d(h, -h, 0.0),
+            center + rotation * Eigen::Vector3d(h, h, 0.0), center + rotation * Eigen::Vector3d(-h, h, 0.0)};
+}
+
+TagBundle::TagBundle(const TagBundleOptions& options) : options(options) {}
+
+TagBundle TagBundle::load(const std::string& path, const TagBundleOptions& options) {
+    cv::FileStorage fs(path, cv::FileStorage::READ);
+    if (!fs.isOpened()) throw std::runtime_error("Cannot open tag bundle " + path);
+
+    cv::FileNode list = fs["tags"];
+    if (!list.isSeq() || list.empty()) throw std::runtime_error("Tag bundle " + path + " lists no tags");
+
+    TagBundle bundle(options);
+    for (const cv::FileNode& node : list) {
+        BundleTag tag;
+        tag.id = static_cast<int>(node["id"]);
+        tag.size = static_cast<double>(node["size"]);
+        cv::FileNode center = node["center"];
+        if (tag.size <= 0.0 || !center.isSeq() || center.size() != 3) {
+            throw std::runtime_error("Tag bundle " + path + ": tag " + std::to_string(tag.id) +
+                                     " needs a size and a 3D center");
+        }
+        tag.center = {static_cast<double>(center[0]), static_cast<double>(center[1]),
+                      static_cast<double>(center[2])};
+        cv::FileNode rotation = node["rotation"];
+        if (!rotation.empty()) {
+            if (!rotation.isSeq() || rotation.size() != 3) {
+                throw std::runtime_error("Tag bundle " + path + ": rotation of tag " + std::to_string(tag.id) +
+                                         " must be an axis-angle vector");
+            }
+            Eigen::Vector3d axisAngle(static_cast<double>(rotation[0]), static_cast<double>(rotation[1]),
+                                      static_cast<double>(rotation[2]));
+            double angle = axisAngle.norm();
+            if (angle > 0.0) tag.rotation = Eigen::AngleAxisd(angle, axisAngle / angle).toRotationMatrix();
+        }
+        if (bundle.find(tag.id)) {
+            throw std::runtime_error("Tag bundle " + path + " lists tag " + std::to_string(tag.id) + " twice");
+        }
+        bundle.addTag(tag);
+    }
+    return bundle;
+}
+
+void TagBundle::addTag(const BundleTag& tag) { tags.push_back(tag); }
+
+const BundleTag* TagBundle::find(int id) const {
+    for (const auto& tag : tags) {
+        if (tag.id == id) return &tag;
+    }
+    return nullptr;
+}
+
+bool TagBundle::solve(const std::vector<AprilTags::TagDetection>& detections, double fx, double fy, double cx,
+                      double cy, Pose& pose) const {
+    std::vector<Correspondence> points;
+    std::vector<int> used;
+    const AprilTags::TagDetection* seed = nullptr;
+    const BundleTag* seedTag = nullptr;
+    double seedArea = 0.0;
+    for (const auto& detection : detections) {
+        const BundleTag* tag = find(detection.id);
+        if (!tag || std::find(used.begin(), used.end(), detection.id) != used.end()) continue;
+        used.push_back(detection.id);
+        std::array<Eigen::Vector3d, 4> corners = tag->corners();
+        for (int i = 0; i < 4; ++i) {
+            points.push_back({corners[i], Eigen::Vector2d(detection.p[i].first, detection.p[i].second)});
+        }
+        double area = quadArea(detection);
+        if (area > seedArea) {
+            seedArea = area;
+            seed = &detection;
+            seedTag = tag;
+        }
+    }
+    if (!seed) return false;
+
+    // Start from the largest tag: camera-from-tag, then camera-from-board.
+    Eigen::Matrix3d tagRotation;
+    Eigen::Vector3d tagTranslation;
+    planarPose(*seed, seedTag->size, fx, fy, cx, cy, tagRotation, tagTranslation);
+    Eigen::Matrix3d rotation = tagRotation * seedTag->rotation.transpose();
+    Eigen::Vector3d translation = tagTranslation - rotation * seedTag->center;
+
+    // Gauss-Newton on the reprojection error, the update applied on the
+    // left: X' = exp(w) X + v for every camera-frame point X.
+    for (int iteration = 0; iteration < options.iterations; ++iteration) {
+        Eigen::Matrix<double, 6, 6> normal = Eigen::Matrix<double, 6, 6>::Zero();
+        Eigen::Matrix<double, 6, 1> gradient = Eigen::Matrix<double, 6, 1>::Zero();
+        for (const auto& point : points) {
+            Eigen::Vector3d camera = rotation * point.board + translation;
+            if (camera.z() <= 1e-6) return false;
+            double invZ = 1.0 / camera.z();
+            Eigen::Vector2d residual(fx * camera.x() * invZ + cx - point.pixel.x(),
+                                     fy * camera.y() * invZ + cy - point.pixel.y());
+            Eigen::Matrix<double, 2, 3> projection;
+            projection << fx * invZ, 0.0, -fx * camera.x() * invZ * invZ, 0.0, fy * invZ,
+                -fy * camera.y() * invZ * invZ;
+            Eigen::Matrix<double, 2, 6> jacobian;
+            jacobian.leftCols<3>() = -projection * skew(camera);
+            jacobian.rightCols<3>() = projection;
+
+            double error = residual.norm();
+            double weight = error <= options.huberPixels ? 1.0 : options.huberPixels / error;
+            normal += weight * jacobian.transpose() * jacobian;
+            gradient += weight * jacobian.transpose() * residual;
+        }
+        Eigen::Matrix<double, 6, 1> step = -normal.ldlt().solve(gradient);
+        if (!step.allFinite()) return false;
+
+        Eigen::Vector3d w = step.head<3>();
+        double angle = w.norm();
+        Eigen::Matrix3d delta =
+            angle > 0.0 ? Eigen::AngleAxisd(angle, w / angle).toRotationMatrix() : Eigen::Matrix3d::Identity();
+        rotation = delta * rotation;
+        translation = delta * translation + step.tail<3>();
+        if (step.norm() < 1e-10) break;
+    }
+
+    double squared = 0.0;
+    for (const auto& point : points) {
+        Eigen::Vector3d camera = rotation * point.board + translation;
+        if (camera.z() <= 1e-6) return false;
+        Eigen::Vector2d projected(fx * camera.x() / camera.z() + cx, fy * camera.y() / camera.z() + cy);
+        squared += (projected - point.pixel).squaredNorm();
+    }
+    double rms = std::sqrt(squared / static_cast<double>(points.size()));
+    if (rms > options.maxReprojectionError) return false;
+
+    pose.rotation = rotation;
+    pose.translation = translation;
+    pose.rmsError = rms;
+    pose.tags = static_cast<int>(used.size());
+    return true;
+}
+
+} // namespace UsArMirror
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <Eigen/Dense>
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "AprilTags/TagDetection.h"
+
+namespace UsArMirror {
+
+/// One tag of a bundle, placed in board coordinates.
+///
+/// The board frame follows the single-tag convention: x to the right and y
+/// up along the printed tags, z out of the board, in meters.
+struct BundleTag {
+    int id = 0;
+    /// Side of the tag's black square.
+    double size = 0.0;
+    Eigen::Vector3d center = Eigen::Vector3d::Zero();
+    /// Tag axes in board coordinates; identity for a flat board with
+    /// every tag upright.
+    Eigen::Matrix3d rotation = Eigen::Matrix3d::Identity();
+
+    /// Corners in board coordinates, in TagDetection::p order.
+    std::array<Eigen::Vector3d, 4> corners() const;
+};
+
+struct TagBundleOptions {
+    /// Gauss-Newton iterations; stops earlier once the update is tiny.
+    int iterations = 10;
+    /// Corners further than this many pixels from their projection are
+    /// down-weighted (Huber), so one bad corner cannot drag the pose.
+    double huberPixels = 2.0;
+    /// Reject the solution when the RMS reprojection error is larger.
+    double maxReprojectionError = 3.0;
+};
+
+/// Board of AprilTags at known positions, solved for as one rigid body.
+///
+/// Every corner of every visible tag in the layout constrains the pose, so
+/// two tags far apart give a pose as steady as dozens of single-tag frames.
+/// The pose starts from the plane homography of the largest visible tag
+/// and is refined over all corners by Gauss-Newton on the reprojection
+/// error (pinhole, no distortion, like TagDetection::getRelativeTransform).
+class TagBundle {
+public:
+    struct Pose {
+        /// Board to camera, OpenCV camera axes (x right, y down, z forward).
+        Eigen::Matrix3d rotation = Eigen::Matrix3d::Identity();
+        Eigen::Vector3d translation = Eigen::Vector3d::Zero();
+        /// RMS reprojection error over the corners used, in pixels.
+        double rmsError = 0.0;
+        int tags = 0;
+    };
+
+    explicit TagBundle(const TagBundleOptions& options = TagBundleOptions());
+
+    /// Read a layout written with cv::FileStorage (YAML or JSON):
+    ///
+    ///     tags:
+    ///       - { id: 0, size: 0.0736, center: [0, 0, 0] }
+    ///       - { id: 1, size: 0.0736, center: [0.2, 0, 0], rotation: [0, 0, 0] }
+    ///
+    /// `rotation` is an optional axis-angle vector in radians. Throws
+    /// std::runtime_error when the file is missing or malformed.
+    static TagBundle load(const std::string& path, const TagBundleOptions& options = TagBundleOptions());
+
+    void addTag(const BundleTag& tag);
+    /// Tag with `id`, or null if it is not part of the bundle.
+    const BundleTag* find(int id) const;
+    const std::vector<BundleTag>& getTags() const { return tags; }
+    bool empty() const { return tags.empty(); }
+
+    /// Solve the board pose from the detections of bundle tags; the other
+    /// detections are ignored. Returns false when no bundle tag is visible
+    /// or the fit is worse than maxReprojectionError.
+    bool solve(const std::vector<AprilTags::TagDetection>& detections, double fx, double fy, double cx, double cy,
+               Pose& pose) const;
+
+    const TagBundleOptions& getOptions() const { return options; }
+
+private:
+    TagBundleOptions options;
+    std::vector<BundleTag> tags;
+};
+
+} // namespace UsArMirror
@@ -0,0 +1,698 @@
+#include "tag_detector.hpp"
+
+#include <Eigen/Dense>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace UsArMirror {
+
+namespace {
+
+constexpr uint8_t black = 0;
+constexpr uint8_t white = 255;
+/// Pixels in tiles too flat to threshold.
+constexpr uint8_t unknown = 127;
+/// Tasks the grouped boundary points are spread over.
+constexpr size_t bucketCount = 64;
+
+unsigned long long rotate90(unsigned long long w, int d) {
+    // Same bit order as AprilTags::TagFamily::rotate90.
+    unsigned long long wr = 0;
+    for (int r = d - 1; r >= 0; --r) {
+        for (int c = 0; c < d; ++c) {
+            int b = r + d * c;
+            wr <<= 1;
+            if (w & (1ULL << b)) wr |= 1;
+        }
+    }
+    return wr;
+}
+
+size_t bucketOf(uint64_t key) {
+    return static_cast<size_t>(((key ^ (key >> 31)) * 0x9E3779B97F4A7C15ULL) >> 58) % bucketCount;
+}
+
+/// Least-squares fit of gray = a*x + b*y + c*x*y + d over tag coordinates,
+/// as AprilTags::GrayModel does, so bit thresholds follow shading.
+class GrayModel {
+public:
+    void add(double x, double y, double gray) {
+        Eigen::Vector4d row(x, y, x * y, 1.0);
+        normal += row * row.transpose();
+        rhs += row * gray;
+        ++count;
+    }
+
+    void solve() {
+        if (count >= 6) {
+            Eigen::Matrix4d inverse;
+            double determinant;
+            bool invertible = false;
+            normal.computeInverseAndDetWithCheck(inverse, determinant, invertible);
+            if (invertible) {
+                coeffs = inverse * rhs;
+                return;
+            }
+        }
+        coeffs.setZero();
+        if (count > 0) coeffs[3] = rhs[3] / count;
+    }
+
+    double at(double x, double y) const { return coeffs[0] * x + coeffs[1] * y + coeffs[2] * x * y + coeffs[3]; }
+
+private:
+    Eigen::Matrix4d normal = Eigen::Matrix4d::Zero();
+    Eigen::Vector4d rhs = Eigen::Vector4d::Zero();
+    Eigen::Vector4d coeffs = Eigen::Vector4d::Zero();
+    int count = 0;
+};
+
+/// Line n . p = c with unit normal n.
+struct Line {
+    cv::Point2f normal;
+    float c = 0.0f;
+};
+
+/// Total least-squares line through `points`; false if it fits worse than
+/// `maxError` RMS.
+bool fitLine(const std::vector<cv::Point2f>& points, float maxError, Line& line) {
+    if (points.size() < 3) return false;
+    double mx = 0.0, my = 0.0;
+    for (const cv::Point2f& p : points) {
+        mx += p.x;
+        my += p.y;
+    }
+    mx /= points.size();
+    my /= points.size();
+    double sxx = 0.0, sxy = 0.0, syy = 0.0;
+    for (const cv::Point2f& p : points) {
+        double dx = p.x - mx, dy = p.y - my;
+        sxx += dx * dx;
+        sxy += dx * dy;
+        syy += dy * dy;
+    }
+    sxx /= points.size();
+    sxy /= points.size();
+    syy /= points.size();
+    // Smallest eigenvalue of the covariance is the mean squared residual;
+    // its eigenvector is the normal.
+    double half = 0.5 * (sxx + syy);
+    double spread = std::sqrt(0.25 * (sxx - syy) * (sxx - syy) + sxy * sxy);
+    double residual = half - spread;
+    if (residual > static_cast<double>(maxError) * maxError) return false;
+    double angle = 0.5 * std::atan2(-2.0 * sxy, syy - sxx);
+    line.normal = cv::Point2f(static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle)));
+    line.c = static_cast<float>(line.normal.x * mx + line.normal.y * my);
+    return true;
+}
+
+bool intersect(const Line& a, const Line& b, cv::Point2f& point) {
+    float det = a.normal.x * b.normal.y - a.normal.y * b.normal.x;
+    if (std::abs(det) < 1e-3f) return false;
+    point.x = (a.c * b.normal.y - b.c * a.normal.y) / det;
+    point.y = (a.normal.x * b.c - b.normal.x * a.c) / det;
+    return true;
+}
+
+float bilinear(const uint8_t* gray, size_t step, float x, float y) {
+    int x0 = static_cast<int>(x), y0 = static_cast<int>(y);
+    float fx = x - x0, fy = y - y0;
+    const uint8_t* r0 = gray + y0 * step + x0;
+    const uint8_t* r1 = r0 + step;
+    return (r0[0] * (1 - fx) + r0[1] * fx) * (1 - fy) + (r1[0] * (1 - fx) + r1[1] * fx) * fy;
+}
+
+/// Homography from tag coordinates [-1, 1]^2 to image coordinates minus
+/// `origin`, as AprilTags::Homography33 stores it.
+Eigen::Matrix3d tagHomography(const cv::Point2f (&corners)[4], const cv::Point2f& origin) {
+    static const double tag[4][2] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+    Eigen::Matrix<double, 8, 8> a;
+    Eigen::Matrix<double, 8, 1> b;
+    for (int i = 0; i < 4; ++i) {
+        double x = tag[i][0], y = tag[i][1];
+        double u = corners[i].x - origin.x, v = corners[i].y - origin.y;
+        a.row(2 * i) << x, y, 1, 0, 0, 0, -x * u, -y * u;
+        a.row(2 * i + 1) << 0, 0, 0, x, y, 1, -x * v, -y * v;
+        b(2 * i) = u;
+        b(2 * i + 1) = v;
+    }
+    Eigen::Matrix<double, 8, 1> h = a.partialPivLu().solve(b);
+    Eigen::Matrix3d homography;
+    homography << h(0), h(1), h(2), h(3), h(4), h(5), h(6), h(7), 1.0;
+    return homography;
+}
+
+cv::Point2f project(const Eigen::Matrix3d& homography, const cv::Point2f& origin, double x, double y) {
+    double z = homography(2, 0) * x + homography(2, 1) * y + homography(2, 2);
+    return cv::Point2f(
+        static_cast<float>((homography(0, 0) * x + homography(0, 1) * y + homography(0, 2)) / z + origin.x),
+        static_cast<float>((homography(1, 0) * x + homography(1, 1) * y + homography(1, 2)) / z + origin.y));
+}
+
+float distance(const std::pair<float, float>& a, const std::pair<float, float>& b) {
+    return std::hypot(a.first - b.first, a.second - b.second);
+}
+
+/// Same tag found twice, e.g. from both sides of a thin border.
+bool sameTag(const AprilTags::TagDetection& a, const AprilTags::TagDetection& b) {
+    if (a.id != b.id) return false;
+    float side = (distance(a.p[0], a.p[1]) + distance(a.p[1], a.p[2]) + distance(a.p[2], a.p[3]) +
+                  distance(a.p[3], a.p[0])) / 4.0f;
+    return distance(a.cxy, b.cxy) < 0.5f * side;
+}
+
+} // namespace
+
+TiledTagDetector::TiledTagDetector(const AprilTags::TagCodes& family, size_t blackBorder,
+                                   const TagDetectorOptions& options, std::shared_ptr<ThreadPool> pool)
+    : options(options), pool(pool ? std::move(pool) : ThreadPool::shared()),
+      dimension(static_cast<int>(std::lround(std::sqrt(static_cast<double>(family.bits))))),
+      blackBorder(static_cast<int>(blackBorder)), codes(family.codes) {
+    // Every word within maxHamming bits of a tag in one of its four
+    // rotations. Ties keep the lowest id and rotation, like TagFamily::decode.
+    const int bits = dimension * dimension;
+    for (size_t id = 0; id < codes.size(); ++id) {
+        for (int rotation = 0; rotation < 4; ++rotation) {
+            // Rotating the observed word `rotation` times gives the code.
+            unsigned long long base = codes[id];
+            for (int r = 0; r < (4 - rotation) % 4; ++r) base = rotate90(base, dimension);
+
+            auto insert = [&](uint32_t word, int hamming) {
+                Decoded value{static_cast<uint16_t>(id), static_cast<uint8_t>(rotation),
+                              static_cast<uint8_t>(hamming)};
+                auto [it, inserted] = codeTable.emplace(word, value);
+                if (!inserted && hamming < it->second.hamming) it->second = value;
+            };
+            insert(static_cast<uint32_t>(base), 0);
+            if (options.maxHamming >= 1) {
+                for (int i = 0; i < bits; ++i) {
+                    insert(static_cast<uint32_t>(base ^ (1ULL << i)), 1);
+                    if (options.maxHamming < 2) continue;
+                    for (int j = i + 1; j < bits; ++j) {
+                        insert(static_cast<uint32_t>(base ^ (1ULL << i) ^ (1ULL << j)), 2);
+                    }
+                }
+            }
+        }
+    }
+}
+
+std::vector<AprilTags::TagDetection> TiledTagDetector::extractTags(const cv::Mat& gray) {
+    CV_Assert(gray.type() == CV_8UC1);
+    return extractTags(gray.ptr<uint8_t>(), gray.step, gray.cols, gray.rows);
+}
+
+std::vector<AprilTags::TagDetection> TiledTagDetector::extractTags(const uint8_t* gray, size_t step, int w, int h) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<AprilTags::TagDetection> detections;
+    if (w < 3 || h < 3) return detections;
+
+    if (w != width || h != height) {
+        width = w;
+        height = h;
+        size_t pixels = static_cast<size_t>(w) * h;
+        binary.assign(pixels, unknown);
+        parent.resize(pixels);
+        blobSize.resize(pixels);
+        labels.resize(pixels);
+    }
+
+    threshold(gray, step);
+    labelBlobs();
+    collectBoundaries();
+
+    buckets.resize(bucketCount);
+    bucketDetections.resize(bucketCount);
+    pool->parallelFor(bucketCount, [&](size_t bucket) { processBucket(bucket, gray, step); });
+
+    for (const auto& found : bucketDetections) {
+        for (const AprilTags::TagDetection& detection : found) {
+            // Prefer fewer bit errors, then the larger outline.
+            auto other = std::find_if(detections.begin(), detections.end(),
+                                      [&](const AprilTags::TagDetection& d) { return sameTag(d, detection); });
+            if (other == detections.end()) {
+                detections.push_back(detection);
+            } else if (detection.hammingDistance < other->hammingDistance ||
+                       (detection.hammingDistance == other->hammingDistance &&
+                        detection.observedPerimeter > other->observedPerimeter)) {
+                *other = detection;
+            }
+        }
+    }
+    // Bucket order depends on blob labels; report tags in a stable order.
+    std::sort(detections.begin(), detections.end(),
+              [](const AprilTags::TagDetection& a, const AprilTags::TagDetection& b) {
+                  return a.id != b.id ? a.id < b.id : a.cxy < b.cxy;
+              });
+
+    lastCost = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return detections;
+}
+
+void TiledTagDetector::threshold(const uint8_t* gray, size_t step) {
+    const int tile = options.thresholdTile;
+    const int tilesX = width / tile, tilesY = height / tile;
+    if (tilesX == 0 || tilesY == 0) {
+        std::fill(binary.begin(), binary.end(), unknown);
+        return;
+    }
+    tileMin.resize(static_cast<size_t>(tilesX) * tilesY);
+    tileMax.resize(tileMin.size());
+
+    // Extremes per tile.
+    pool->parallelFor(tilesY, [&](size_t ty) {
+        for (int tx = 0; tx < tilesX; ++tx) {
+            uint8_t lo = 255, hi = 0;
+            for (int y = 0; y < tile; ++y) {
+                const uint8_t* row = gray + (ty * tile + y) * step + tx * tile;
+                for (int x = 0; x < tile; ++x) {
+                    lo = std::min(lo, row[x]);
+                    hi = std::max(hi, row[x]);
+                }
+            }
+            tileMin[ty * tilesX + tx] = lo;
+            tileMax[ty * tilesX + tx] = hi;
+        }
+    });
+
+    // Threshold each pixel against the extremes of its tile's 3x3
+    // neighbourhood, so a tile on an edge still sees both sides.
+    pool->parallelFor(tilesY, [&](size_t tyIndex) {
+        const int ty = static_cast<int>(tyIndex);
+        const int y1 = ty + 1 == tilesY ? height : (ty + 1) * tile;
+        for (int tx = 0; tx < tilesX; ++tx) {
+            uint8_t lo = 255, hi = 0;
+            for (int ny = std::max(ty - 1, 0); ny <= std::min(ty + 1, tilesY - 1); ++ny) {
+                for (int nx = std::max(tx - 1, 0); nx <= std::min(tx + 1, tilesX - 1); ++nx) {
+                    lo = std::min(lo, tileMin[ny * tilesX + nx]);
+                    hi = std::max(hi, tileMax[ny * tilesX + nx]);
+                }
+            }
+            const int x0 = tx * tile;
+            const int x1 = tx + 1 == tilesX ? width : x0 + tile;
+            for (int y = ty * tile; y < y1; ++y) {
+                const uint8_t* in = gray + y * step;
+                uint8_t* out = binary.data() + static_cast<size_t>(y) * width;
+                if (hi - lo < options.minContrast) {
+                    std::fill(out + x0, out + x1, unknown);
+                    continue;
+                }
+                const int mid = lo + (hi - lo) / 2;
+                for (int x = x0; x < x1; ++x) out[x] = in[x] > mid ? white : black;
+            }
+        }
+    });
+}
+
+void TiledTagDetector::labelBlobs() {
+    // Union-find over runs of equal pixels, each run named by the index of
+    // its first pixel.
+    auto find = [this](uint32_t i) {
+        while (parent[i] != i) {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    };
+    auto unite = [&](uint32_t a, uint32_t b) {
+        a = find(a);
+        b = find(b);
+        if (a == b) return;
+        if (blobSize[a] < blobSize[b]) std::swap(a, b);
+        parent[b] = a;
+        blobSize[a] += blobSize[b];
+    };
+
+    // Strips are labelled independently; they touch disjoint pixels.
+    const int rows = std::max(options.stripRows, 1);
+    const size_t strips = (height + rows - 1) / rows;
+    pool->parallelFor(strips, [&](size_t strip) {
+        struct Run {
+            int x0, x1;
+            uint32_t id;
+        };
+        std::vector<Run> previous, current;
+        const int y0 = static_cast<int>(strip) * rows;
+        const int y1 = std::min(y0 + rows, height);
+        for (int y = y0; y < y1; ++y) {
+            const uint32_t rowStart = static_cast<uint32_t>(y) * width;
+            const uint8_t* row = binary.data() + rowStart;
+            const uint8_t* above = row - width;
+            current.clear();
+            size_t overlap = 0;
+            for (int x = 0; x < width;) {
+                const uint8_t v = row[x];
+                int end = x + 1;
+                while (end < width && row[end] == v) ++end;
+                const uint32_t id = rowStart + x;
+                parent[id] = id;
+                blobSize[id] = end - x;
+                std::fill(labels.begin() + id, labels.begin() + rowStart + end, id);
+                current.push_back({x, end, id});
+
+                // 4-connected to every run above that overlaps this one.
+                while (overlap < previous.size() && previous[overlap].x1 <= x) ++overlap;
+                if (v != unknown) {
+                    for (size_t k = overlap; k < previous.size() && previous[k].x0 < end; ++k) {
+                        if (above[previous[k].x0] == v) unite(id, previous[k].id);
+                    }
+                }
+                x = end;
+            }
+            std::swap(previous, current);
+        }
+    });
+
+    // Stitch the seams.
+    for (size_t strip = 1; strip < strips; ++strip) {
+        const uint32_t rowStart = static_cast<uint32_t>(strip * rows) * width;
+        uint32_t lastBelow = 0, lastAbove = 0;
+        for (int x = 0; x < width; ++x) {
+            uint32_t i = rowStart + x;
+            uint8_t v = binary[i];
+            if (v == unknown || binary[i - width] != v) continue;
+            if (labels[i] == lastBelow && labels[i - width] == lastAbove) continue;
+            lastBelow = labels[i];
+            lastAbove = labels[i - width];
+            unite(lastBelow, lastAbove);
+        }
+    }
+}
+
+void TiledTagDetector::collectBoundaries() {
+    const int rows = std::max(options.stripRows, 1);
+    const size_t strips = (height + rows - 1) / rows;
+    stripPoints.resize(strips * bucketCount);
+    const uint32_t minBlob = static_cast<uint32_t>(options.minBlobPixels);
+
+    pool->parallelFor(strips, [&](size_t strip) {
+        std::vector<BoundaryPoint>* out = stripPoints.data() + strip * bucketCount;
+        for (size_t b = 0; b < bucketCount; ++b) out[b].clear();
+
+        // Read-only walk up the forest, so strips can run concurrently.
+        auto blobOf = [this](uint32_t i) {
+            uint32_t root = labels[i];
+            while (parent[root] != root) root = parent[root];
+            return root;
+        };
+        auto emit = [&](uint32_t i, uint32_t j, float x, float y, int dx, int dy) {
+            // i and j are neighbours of opposite color.
+            uint32_t blackLabel = blobOf(i), whiteLabel = blobOf(j);
+            if (binary[i] != black) {
+                std::swap(blackLabel, whiteLabel);
+                dx = -dx;
+                dy = -dy;
+            }
+            if (blobSize[blackLabel] < minBlob || blobSize[whiteLabel] < minBlob) return;
+            uint64_t key = (static_cast<uint64_t>(blackLabel) << 32) | whiteLabel;
+            out[bucketOf(key)].push_back({key, x, y, static_cast<int8_t>(dx), static_cast<int8_t>(dy)});
+        };
+
+        const int y0 = static_cast<int>(strip) * rows;
+        const int y1 = std::min(y0 + rows, height);
+        for (int y = y0; y < y1; ++y) {
+            for (int x = 0; x < width; ++x) {
+                uint32_t i = static_cast<uint32_t>(y) * width + x;
+                uint8_t v = binary[i];
+                if (v == unknown) continue;
+                if (x + 1 < width && binary[i + 1] != unknown && binary[i + 1] != v) {
+                    emit(i, i + 1, x + 0.5f, static_cast<float>(y), 1, 0);
+                }
+                if (y + 1 < height && binary[i + width] != unknown && binary[i + width] != v) {
+                    emit(i, i + width, static_cast<float>(x), y + 0.5f, 0, 1);
+                }
+            }
+        }
+    });
+}
+
+void TiledTagDetector::processBucket(size_t bucket, const uint8_t* gray, size_t step) {
+    std::vector<BoundaryPoint>& points = buckets[bucket];
+    std::vector<AprilTags::TagDetection>& found = bucketDetections[bucket];
+    points.clear();
+    found.clear();
+    for (size_t strip = 0; strip * bucketCount < stripPoints.size(); ++strip) {
+        const std::vector<BoundaryPoint>& part = stripPoints[strip * bucketCount + bucket];
+        points.insert(points.end(), part.begin(), part.end());
+    }
+    std::stable_sort(points.begin(), points.end(),
+                     [](const BoundaryPoint& a, const BoundaryPoint& b) { return a.key < b.key; });
+
+    Quad quad;
+    AprilTags::TagDetection detection;
+    for (size_t begin = 0; begin < points.size();) {
+        size_t end = begin + 1;
+        while (end < points.size() && points[end].key == points[begin].key) ++end;
+        if (fitQuad(gray, step, points.data() + begin, end - begin, quad) && decode(gray, step, quad, detection)) {
+            found.push_back(detection);
+        }
+        begin = end;
+    }
+}
+
+bool TiledTagDetector::fitQuad(const uint8_t* gray, size_t step, const BoundaryPoint* points, size_t count,
+                               Quad& quad) const {
+    const float minSide = options.minSidePixels;
+    if (count < static_cast<size_t>(4 * minSide) || count > 4 * static_cast<size_t>(width + height)) return false;
+
+    float cx = 0.0f, cy = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        cx += points[i].x;
+        cy += points[i].y;
+    }
+    cx /= count;
+    cy /= count;
+
+    // The tag border is black inside a white surround: the black-to-white
+    // steps must point away from the centre.
+    float outward = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        outward += points[i].dx * (points[i].x - cx) + points[i].dy * (points[i].y - cy);
+    }
+    if (outward <= 0.0f) return false;
+
+    // Walk the outline in angle order around the centre.
+    std::vector<std::pair<float, cv::Point2f>> byAngle(count);
+    for (size_t i = 0; i < count; ++i) {
+        byAngle[i] = {std::atan2(points[i].y - cy, points[i].x - cx), cv::Point2f(points[i].x, points[i].y)};
+    }
+    std::sort(byAngle.begin(), byAngle.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+    std::vector<cv::Point2f> outline(count);
+    for (size_t i = 0; i < count; ++i) outline[i] = byAngle[i].second;
+
+    // Corners: farthest point from the centre, farthest point from that
+    // one, then the farthest points on either side of the diagonal.
+    auto farthestFrom = [&](const cv::Point2f& p) {
+        size_t best = 0;
+        float bestDistance = -1.0f;
+        for (size_t i = 0; i < count; ++i) {
+            cv::Point2f d = outline[i] - p;
+            float distance = d.dot(d);
+            if (distance > bestDistance) {
+                bestDistance = distance;
+                best = i;
+            }
+        }
+        return best;
+    };
+    size_t a = farthestFrom(cv::Point2f(cx, cy));
+    size_t c = farthestFrom(outline[a]);
+    cv::Point2f diagonal = outline[c] - outline[a];
+    float diagonalLength = std::sqrt(diagonal.dot(diagonal));
+    if (diagonalLength < minSide) return false;
+    cv::Point2f normal(-diagonal.y / diagonalLength, diagonal.x / diagonalLength);
+    size_t b = a, d = a;
+    float bDistance = 0.0f, dDistance = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        float side = (outline[i] - outline[a]).dot(normal);
+        if (side > bDistance) {
+            bDistance = side;
+            b = i;
+        } else if (side < dDistance) {
+            dDistance = side;
+            d = i;
+        }
+    }
+    if (bDistance < 0.25f * minSide || -dDistance < 0.25f * minSide) return false;
+
+    size_t cornerIndex[4] = {a, b, c, d};
+    std::sort(cornerIndex, cornerIndex + 4);
+
+    // Fit each side to the points between its corners, leaving out the
+    // rounded ends.
+    Line lines[4];
+    std::vector<cv::Point2f> side;
+    for (int s = 0; s < 4; ++s) {
+        size_t first = cornerIndex[s];
+        size_t length = (cornerIndex[(s + 1) % 4] + count - first) % count;
+        size_t trim = length / 8 + 1;
+        side.clear();
+        for (size_t k = trim; k + trim < length; ++k) side.push_back(outline[(first + k) % count]);
+        if (!fitLine(side, options.maxEdgeError, lines[s])) return false;
+    }
+
+    auto intersectAll = [&](cv::Point2f (&corners)[4]) {
+        for (int s = 0; s < 4; ++s) {
+            if (!intersect(lines[(s + 3) % 4], lines[s], corners[s])) return false;
+        }
+        return true;
+    };
+    if (!intersectAll(quad.corners)) return false;
+
+    if (options.refineEdges) {
+        // Move every side onto the point where the intensity profile
+        // across it rises fastest, sampled along the side.
+        const cv::Point2f centre(cx, cy);
+        for (int s = 0; s < 4; ++s) {
+            cv::Point2f p0 = quad.corners[s], p1 = quad.corners[(s + 1) % 4];
+            cv::Point2f along = p1 - p0;
+            float length = std::sqrt(along.dot(along));
+            if (length < 1.0f) return false;
+            cv::Point2f n = lines[s].normal;
+            if (n.dot((p0 + p1) * 0.5f - centre) < 0.0f) n = -n;
+
+            int samples = std::clamp(static_cast<int>(length / 2.0f), 4, 64);
+            side.clear();
+            for (int k = 0; k < samples; ++k) {
+                float t = 0.1f + 0.8f * (k + 0.5f) / samples;
+                cv::Point2f p = p0 + along * t;
+                float sum = 0.0f, weighted = 0.0f;
+                float previous = -1.0f;
+                bool inside = true;
+                for (int j = 0; j <= 10 && inside; ++j) {
+                    float offset = -2.5f + 0.5f * j;
+                    cv::Point2f q = p + n * offset;
+                    if (q.x < 0.0f || q.y < 0.0f || q.x >= width - 1 || q.y >= height - 1) {
+                        inside = false;
+                        break;
+                    }
+                    float value = bilinear(gray, step, q.x, q.y);
+                    if (j > 0 && value > previous) {
+                        float rise = value - previous;
+                        sum += rise;
+                        weighted += rise * (offset - 0.25f);
+                    }
+                    previous = value;
+                }
+                if (inside && sum > 0.0f) side.push_back(p + n * (weighted / sum));
+            }
+            Line refined;
+            if (side.size() >= 4 && fitLine(side, options.maxEdgeError, refined)) lines[s] = refined;
+        }
+        if (!intersectAll(quad.corners)) return false;
+    }
+
+    // Convex, with every side long enough.
+    float perimeter = 0.0f;
+    float turn = 0.0f;
+    for (int s = 0; s < 4; ++s) {
+        cv::Point2f e0 = quad.corners[(s + 1) % 4] - quad.corners[s];
+        cv::Point2f e1 = quad.corners[(s + 2) % 4] - quad.corners[(s + 1) % 4];
+        float sideLength = std::sqrt(e0.dot(e0));
+        if (sideLength < minSide) return false;
+        perimeter += sideLength;
+        float cross = e0.x * e1.y - e0.y * e1.x;
+        if (s > 0 && cross * turn <= 0.0f) return false;
+        turn = cross;
+    }
+    quad.perimeter = perimeter;
+    return true;
+}
+
+bool TiledTagDetector::decode(const uint8_t* gray, size_t step, const Quad& quad,
+                              AprilTags::TagDetection& detection) const {
+    // AprilTags orders the quad counter-clockwise on screen, starting at
+    // tag coordinate (-1, -1).
+    cv::Point2f corners[4] = {quad.corners[0], quad.corners[3], quad.corners[2], quad.corners[1]};
+    const cv::Point2f origin(width / 2.0f, height / 2.0f);
+    const Eigen::Matrix3d homography = tagHomography(corners, origin);
+    const int dd = 2 * blackBorder + dimension;
+
+    auto sample = [&](double x01, double y01, float& value) {
+        cv::Point2f p = project(homography, origin, 2.0 * x01 - 1.0, 2.0 * y01 - 1.0);
+        int ix = static_cast<int>(p.x + 0.5f), iy = static_cast<int>(p.y + 0.5f);
+        if (ix < 0 || ix >= width || iy < 0 || iy >= height) return false;
+        value = gray[iy * step + ix];
+        return true;
+    };
+
+    // Shading models from the white ring just outside the tag and the
+    // outermost ring of the black border.
+    GrayModel whiteModel, blackModel;
+    for (int iy = -1; iy <= dd; ++iy) {
+        double y = (iy + 0.5) / dd;
+        for (int ix = -1; ix <= dd; ++ix) {
+            double x = (ix + 0.5) / dd;
+            float value;
+            if (!sample(x, y, value)) continue;
+            if (iy == -1 || iy == dd || ix == -1 || ix == dd) {
+                whiteModel.add(x, y, value);
+            } else if (iy == 0 || iy == dd - 1 || ix == 0 || ix == dd - 1) {
+                blackModel.add(x, y, value);
+            }
+        }
+    }
+    whiteModel.solve();
+    blackModel.solve();
+
+    // Same bit order as AprilTags::TagDetector.
+    unsigned long long word = 0;
+    for (int iy = dimension - 1; iy >= 0; --iy) {
+        double y = (blackBorder + iy + 0.5) / dd;
+        for (int ix = 0; ix < dimension; ++ix) {
+            double x = (blackBorder + ix + 0.5) / dd;
+            float value;
+            if (!sample(x, y, value)) return false;
+            word <<= 1;
+            if (value > 0.5 * (blackModel.at(x, y) + whiteModel.at(x, y))) word |= 1;
+        }
+    }
+
+    auto match = codeTable.find(static_cast<uint32_t>(word));
+    if (match == codeTable.end()) return false;
+    const Decoded& decoded = match->second;
+
+    detection.good = true;
+    detection.obsCode = static_cast<long long>(word);
+    detection.code = static_cast<long long>(codes[decoded.id]);
+    detection.id = decoded.id;
+    detection.hammingDistance = decoded.hamming;
+    detection.rotation = decoded.rotation;
+    detection.observedPerimeter = quad.perimeter;
+
+    cv::Point2f centre = project(homography, origin, 0.0, 0.0);
+    detection.cxy = {centre.x, centre.y};
+
+    // Rotate the homography to the decoded orientation, then start the
+    // corners at the one nearest tag coordinate (-1, -1).
+    double angle = decoded.rotation * M_PI / 2.0;
+    Eigen::Matrix3d rotation = Eigen::Matrix3d::Identity();
+    rotation(0, 0) = rotation(1, 1) = std::cos(angle);
+    rotation(0, 1) = -std::sin(angle);
+    rotation(1, 0) = std::sin(angle);
+    detection.homography = homography * rotation;
+    detection.hxy = {origin.x, origin.y};
+
+    cv::Point2f bottomLeft = project(detection.homography, origin, -1.0, -1.0);
+    int first = 0;
+    float bestDistance = std::numeric_limits<float>::max();
+    for (int i = 0; i < 4; ++i) {
+        cv::Point2f d = corners[i] - bottomLeft;
+        float squared = d.dot(d);
+        if (squared < bestDistance) {
+            bestDistance = squared;
+            first = i;
+        }
+    }
+    for (int i = 0; i < 4; ++i) {
+        const cv::Point2f& p = corners[(i + first) % 4];
+        detection.p[i] = {p.x, p.y};
+    }
+    return true;
+}
+
+} // namespace UsArMirror
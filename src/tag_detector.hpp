@@ -0,0 +1,124 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "AprilTags/TagDetector.h"
+#include "thread_pool.hpp"
+
+namespace UsArMirror {
+
+struct TagDetectorOptions {
+    /// Side of the tiles the local black/white threshold is computed on.
+    int thresholdTile = 4;
+    /// Tiles whose darkest and brightest pixel differ by less than this
+    /// are too flat to threshold and take part in no quad.
+    int minContrast = 20;
+    /// Smallest black or white blob, in pixels, that can border a tag.
+    int minBlobPixels = 24;
+    /// Shortest tag side in pixels.
+    float minSidePixels = 8.0f;
+    /// Largest RMS distance of edge points from their fitted line.
+    float maxEdgeError = 1.0f;
+    /// Move each quad edge onto the intensity midpoint between the border
+    /// and the background before intersecting the edges.
+    bool refineEdges = true;
+    /// Bit errors corrected when decoding. 1 matches AprilTags::TagFamily.
+    int maxHamming = 1;
+    /// Rows per union-find strip and per boundary-collection task.
+    int stripRows = 32;
+};
+
+/// AprilTag detector that runs its stages in parallel.
+///
+/// A drop-in replacement for AprilTags::TagDetector::extractTags(): the same
+/// tag family, border width and TagDetection conventions (corner order,
+/// homography, rotation, id), so getRelativeTranslationRotation() gives the
+/// same pose. The pipeline follows the newer AprilTag designs:
+///  1. local threshold per tile of min/max (tiles in parallel);
+///  2. black and white blobs by union-find over row strips, the strips
+///     labelled in parallel and stitched at their seams;
+///  3. pixel edges between a black and a white blob gathered per strip and
+///     grouped by blob pair, one group per candidate outline;
+///  4. quad fit per group: corners, least-squares edges, optional sub-pixel
+///     edge refinement (groups in parallel);
+///  5. bits sampled through the quad homography and decoded through a
+///     table of every code word within maxHamming bits of a tag.
+class TiledTagDetector {
+public:
+    explicit TiledTagDetector(const AprilTags::TagCodes& codes, size_t blackBorder = 2,
+                              const TagDetectorOptions& options = TagDetectorOptions(),
+                              std::shared_ptr<ThreadPool> pool = nullptr);
+
+    /// Detect tags in a CV_8UC1 image. Not thread-safe: scratch buffers
+    /// are reused between calls.
+    std::vector<AprilTags::TagDetection> extractTags(const cv::Mat& gray);
+    std::vector<AprilTags::TagDetection> extractTags(const uint8_t* gray, size_t step, int width, int height);
+
+    const TagDetectorOptions& getOptions() const { return options; }
+    /// Wall time of the last extractTags() call.
+    double lastCostMs() const { return lastCost; }
+
+private:
+    /// Midpoint between a black pixel and a white neighbour.
+    struct BoundaryPoint {
+        /// Black blob label in the high half, white blob label in the low.
+        uint64_t key;
+        float x;
+        float y;
+        /// Unit step from the black pixel to the white one.
+        int8_t dx;
+        int8_t dy;
+    };
+
+    struct Quad {
+        /// Clockwise on screen, starting anywhere.
+        cv::Point2f corners[4];
+        float perimeter = 0.0f;
+    };
+
+    struct Decoded {
+        uint16_t id;
+        uint8_t rotation;
+        uint8_t hamming;
+    };
+
+    void threshold(const uint8_t* gray, size_t step);
+    void labelBlobs();
+    void collectBoundaries();
+    /// Sort one bucket by blob pair and turn every group into detections.
+    void processBucket(size_t bucket, const uint8_t* gray, size_t step);
+    bool fitQuad(const uint8_t* gray, size_t step, const BoundaryPoint* points, size_t count, Quad& quad) const;
+    bool decode(const uint8_t* gray, size_t step, const Quad& quad, AprilTags::TagDetection& detection) const;
+
+    TagDetectorOptions options;
+    std::shared_ptr<ThreadPool> pool;
+
+    // Tag family
+    int dimension = 0;
+    int blackBorder = 2;
+    std::vector<unsigned long long> codes;
+    /// Every code word within maxHamming bits of a tag, in any rotation.
+    std::unordered_map<uint32_t, Decoded> codeTable;
+
+    // Per-call scratch, sized to the last image
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> binary;
+    std::vector<uint8_t> tileMin;
+    std::vector<uint8_t> tileMax;
+    std::vector<uint32_t> parent;
+    std::vector<uint32_t> blobSize;
+    std::vector<uint32_t> labels;
+    std::vector<std::vector<BoundaryPoint>> stripPoints;
+    std::vector<std::vector<BoundaryPoint>> buckets;
+    std::vector<std::vector<AprilTags::TagDetection>> bucketDetections;
+
+    double lastCost = 0.0;
+};
+
+} // namespace UsArMirror
@@ -0,0 +1,122 @@
+#include "tag_tracker.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "derived_images.hpp"
+
+namespace UsArMirror {
+
+namespace {
+
+void offsetDetection(AprilTags::TagDetection& detection, float dx, float dy) {
+    for (auto& corner : detection.p) {
+        corner.first += dx;
+        corner.second += dy;
+    }
+    detection.cxy.first += dx;
+    detection.cxy.second += dy;
+    // The homography maps tag coordinates relative to hxy.
+    detection.hxy.first += dx;
+    detection.hxy.second += dy;
+}
+
+/// Keep one detection per tag id, the first one seen.
+void removeDuplicates(std::vector<AprilTags::TagDetection>& detections) {
+    std::vector<AprilTags::TagDetection> unique;
+    for (const auto& detection : detections) {
+        bool seen = std::any_of(unique.begin(), unique.end(),
+                                [&](const AprilTags::TagDetection& other) { return other.id == detection.id; });
+        if (!seen) unique.push_back(detection);
+    }
+    detections = std::move(unique);
+}
+
+} // namespace
+
+TagTracker::TagTracker(const AprilTags::TagCodes& codes, const TagTrackerOptions& options)
+    : options(options), detector(std::make_unique<TiledTagDetector>(codes)) {}
+
+void TagTracker::reset() {
+    tracked.clear();
+    misses = 0;
+}
+
+cv::Rect TagTracker::searchWindow(const AprilTags::TagDetection& detection, float scale,
+                                  const cv::Rect& bounds) const {
+    float minX = detection.p[0].first, maxX = minX;
+    float minY = detection.p[0].second, maxY = minY;
+    for (const auto& corner : detection.p) {
+        minX = std::min(minX, corner.first);
+        maxX = std::max(maxX, corner.first);
+        minY = std::min(minY, corner.second);
+        maxY = std::max(maxY, corner.second);
+    }
+    minX *= scale;
+    maxX *= scale;
+    minY *= scale;
+    maxY *= scale;
+    float marginX = std::max(options.roiMargin * (maxX - minX), static_cast<float>(options.minMarginPixels));
+    float marginY = std::max(options.roiMargin * (maxY - minY), static_cast<float>(options.minMarginPixels));
+    cv::Rect window(cv::Point(static_cast<int>(std::floor(minX - marginX)), static_cast<int>(std::floor(minY - marginY))),
+                    cv::Point(static_cast<int>(std::ceil(maxX + marginX)), static_cast<int>(std::ceil(maxY + marginY))));
+    return window & bounds;
+}
+
+void TagTracker::detectIn(const cv::Mat& gray, const cv::Rect& area, std::vector<AprilTags::TagDetection>& out) {
+    if (area.width < 8 || area.height < 8) return;
+    for (AprilTags::TagDetection& detection : detector->extractTags(gray(area))) {
+        offsetDetection(detection, static_cast<float>(area.x), static_cast<float>(area.y));
+        out.push_back(std::move(detection));
+    }
+}
+
+std::vector<AprilTags::TagDetection> TagTracker::detect(const DerivedImages& frame) {
+    auto start = std::chrono::steady_clock::now();
+    const cv::Mat& gray = frame.gray();
+    const cv::Rect bounds(0, 0, gray.cols, gray.rows);
+    std::vector<AprilTags::TagDetection> found;
+    pass = Pass::None;
+
+    if (options.tracking && !tracked.empty()) {
+        for (const auto& previous : tracked) {
+            detectIn(gray, searchWindow(previous, 1.0f, bounds), found);
+        }
+        if (!found.empty()) {
+            pass = Pass::Tracked;
+            misses = 0;
+        } else if (++misses < options.maxMisses) {
+            // The tag may be briefly occluded; keep the old windows.
+            lastCost = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            return found;
+        }
+    }
+
+    if (found.empty() && options.decimate) {
+        const cv::Mat& coarse = frame.grayHalf();
+        for (const auto& candidate : detector->extractTags(coarse)) {
+            detectIn(gray, searchWindow(candidate, 2.0f, bounds), found);
+        }
+        if (!found.empty()) pass = Pass::Coarse;
+    }
+
+    if (found.empty()) {
+        for (AprilTags::TagDetection& detection : detector->extractTags(gray)) {
+            found.push_back(std::move(detection));
+        }
+        if (!found.empty()) pass = Pass::Full;
+    }
+
+    removeDuplicates(found);
+    if (!found.empty()) {
+        tracked = found;
+        misses = 0;
+    } else {
+        tracked.clear();
+    }
+    lastCost = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return found;
+}
+
+} // namespace UsArMirror
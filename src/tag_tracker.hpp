@@ -0,0 +1,75 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <memory>
+#include <vector>
+
+#include "AprilTags/TagDetection.h"
+#include "tag_detector.hpp"
+
+namespace UsArMirror {
+
+class DerivedImages;
+
+struct TagTrackerOptions {
+    /// Search only around the tags found last time. The search window is
+    /// the previous quad's bounding box grown by `roiMargin` times its size
+    /// on every side, and by at least `minMarginPixels`.
+    bool tracking = true;
+    float roiMargin = 0.5f;
+    int minMarginPixels = 16;
+    /// Consecutive tracked misses before searching the whole frame again.
+    int maxMisses = 3;
+
+    /// Search the whole frame at half resolution first, then detect each
+    /// candidate again at full resolution inside its own window. Tags too
+    /// small to decode at half size are still found by the full pass, but
+    /// only when the coarse pass finds no tag at all.
+    bool decimate = true;
+};
+
+/// AprilTag detection that avoids scanning the whole frame when it can.
+///
+/// Three passes, cheapest first:
+///  - tracked: a window around each tag from the previous call;
+///  - coarse: the whole frame at half size, refined per candidate at full
+///    resolution;
+///  - full: the whole frame at full size, if the coarse pass finds nothing.
+/// Detections always come back in full-frame pixel coordinates, refined at
+/// full resolution, so poses do not lose accuracy to the shortcuts.
+class TagTracker {
+public:
+    enum class Pass { None, Tracked, Coarse, Full };
+
+    explicit TagTracker(const AprilTags::TagCodes& codes, const TagTrackerOptions& options = TagTrackerOptions());
+
+    /// Detect tags in `frame`. Not thread-safe; one tracker per stream.
+    std::vector<AprilTags::TagDetection> detect(const DerivedImages& frame);
+
+    /// Forget the tracked tags; the next call searches the whole frame.
+    void reset();
+
+    const TagTrackerOptions& getOptions() const { return options; }
+    /// Pass that produced the last result, None if nothing was found.
+    Pass lastPass() const { return pass; }
+    /// Wall time of the last detect() call.
+    double lastCostMs() const { return lastCost; }
+
+private:
+    /// Detect inside `window` of `gray` and shift the results to frame
+    /// coordinates.
+    void detectIn(const cv::Mat& gray, const cv::Rect& window, std::vector<AprilTags::TagDetection>& out);
+    /// Bounding box of `detection` scaled by `scale`, grown by the margin
+    /// and clipped to `bounds`.
+    cv::Rect searchWindow(const AprilTags::TagDetection& detection, float scale, const cv::Rect& bounds) const;
+
+    TagTrackerOptions options;
+    std::unique_ptr<TiledTagDetector> detector;
+    std::vector<AprilTags::TagDetection> tracked;
+    int misses = 0;
+    Pass pass = Pass::None;
+    double lastCost = 0.0;
+};
+
+} // namespace UsArMirror
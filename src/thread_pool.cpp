@@ -0,0 +1,97 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+namespace UsArMirror {
+
+namespace {
+/// Set while this thread is running loop items.
+thread_local bool insideLoop = false;
+} // namespace
+
+ThreadPool::ThreadPool(size_t threads) {
+    size_t count = std::max<size_t>(threads, 1) - 1;
+    workers.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(stateMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) worker.join();
+}
+
+std::shared_ptr<ThreadPool> ThreadPool::shared() {
+    static std::shared_ptr<ThreadPool> pool = std::make_shared<ThreadPool>();
+    return pool;
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& fn) {
+    if (count == 0) return;
+    if (insideLoop || workers.empty() || count == 1) {
+        for (size_t i = 0; i < count; ++i) fn(i);
+        return;
+    }
+
+    std::lock_guard loop(loopMutex);
+    {
+        std::unique_lock lock(stateMutex);
+        // A worker that woke late for the previous loop may still be
+        // reading its size.
+        done.wait(lock, [this] { return active == 0; });
+        job = &fn;
+        jobSize = count;
+        nextIndex = 0;
+        finished = 0;
+        ++generation;
+    }
+    wake.notify_all();
+
+    insideLoop = true;
+    drain();
+    insideLoop = false;
+
+    std::unique_lock lock(stateMutex);
+    done.wait(lock, [this] { return finished.load() == jobSize && active == 0; });
+    job = nullptr;
+}
+
+void ThreadPool::drain() {
+    for (;;) {
+        size_t i = nextIndex.fetch_add(1);
+        if (i >= jobSize) break;
+        (*job)(i);
+        if (finished.fetch_add(1) + 1 == jobSize) {
+            std::lock_guard lock(stateMutex);
+            done.notify_all();
+        }
+    }
+}
+
+void ThreadPool::workerLoop() {
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock lock(stateMutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+            ++active;
+        }
+        insideLoop = true;
+        drain();
+        insideLoop = false;
+        {
+            std::lock_guard lock(stateMutex);
+            --active;
+        }
+        done.notify_all();
+    }
+}
+
+} // namespace UsArMirror
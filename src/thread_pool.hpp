@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace UsArMirror {
+
+/// Fixed set of worker threads for data-parallel loops.
+///
+/// parallelFor() hands out indices one at a time from a shared counter, so
+/// uneven items balance themselves. The calling thread works too and the
+/// call returns once every index has run. Calls from different threads
+/// take turns; a call from inside a running loop runs inline, so nesting
+/// cannot deadlock.
+class ThreadPool {
+public:
+    /// `threads` counts the caller, so 1 means no worker threads at all.
+    explicit ThreadPool(size_t threads = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// Process-wide pool sized to the machine, created on first use.
+    static std::shared_ptr<ThreadPool> shared();
+
+    /// Threads that take part in a loop, including the caller.
+    size_t size() const { return workers.size() + 1; }
+
+    /// Run `fn(i)` for every i in [0, count). `fn` must not throw.
+    void parallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+private:
+    void workerLoop();
+    /// Run indices of the current loop until none are left.
+    void drain();
+
+    std::vector<std::thread> workers;
+    /// One loop at a time.
+    std::mutex loopMutex;
+
+    std::mutex stateMutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    bool stopping = false;
+    uint64_t generation = 0;
+    /// Workers currently inside drain().
+    int active = 0;
+
+    // Current loop
+    const std::function<void(size_t)>* job = nullptr;
+    size_t jobSize = 0;
+    std::atomic<size_t> nextIndex{0};
+    std::atomic<size_t> finished{0};
+};
+
+} // namespace UsArMirror
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+
+namespace UsArMirror {
+
+/// Single-producer / multi-reader frame exchange.
+///
+/// The producer fills a buffer that is neither published nor held by any
+/// reader and then publishes it with a single atomic store. Readers pin the
+/// published buffer through a ReadHandle, so they never copy the payload and
+/// never wait on the producer. The producer never blocks either: if every
+/// spare buffer is pinned, the new frame is dropped and counted.
+///
+/// Readers that want every new frame can block in waitNewer() instead of
+/// polling; the producer only touches the wake-up mutex while someone waits.
+///
+/// A handle only keeps its buffer stable while it is alive. Shallow copies of
+/// the payload (e.g. a cv::Mat header) taken out of a handle must not outlive
+/// it; use copyTo/clone when a frame has to be kept.
+template <typename T, std::size_t N = 3>
+class TripleBuffer {
+    static_assert(N >= 3, "TripleBuffer needs at least three buffers");
+
+    struct Slot {
+        T value{};
+        std::atomic<int> readers{0};
+        uint64_t sequence = 0;
+    };
+
+public:
+    class ReadHandle {
+    public:
+        ReadHandle() = default;
+        ReadHandle(const ReadHandle&) = delete;
+        ReadHandle& operator=(const ReadHandle&) = delete;
+        ReadHandle(ReadHandle&& other) noexcept : slot(std::exchange(other.slot, nullptr)) {}
+        ReadHandle& operator=(ReadHandle&& other) noexcept {
+            if (this != &other) {
+                release();
+                slot = std::exchange(other.slot, nullptr);
+            }
+            return *this;
+        }
+        ~ReadHandle() { release(); }
+
+        explicit operator bool() const { return slot != nullptr; }
+        const T& operator*() const { return slot->value; }
+        const T* operator->() const { return &slot->value; }
+        /// Sequence number of the held frame, 0 if the handle is empty.
+        uint64_t sequence() const { return slot ? slot->sequence : 0; }
+
+        void release() {
+            if (slot) {
+                slot->readers.fetch_sub(1, std::memory_order_release);
+                slot = nullptr;
+            }
+        }
+
+    private:
+        friend class TripleBuffer;
+        explicit ReadHandle(Slot* slot) : slot(slot) {}
+        Slot* slot = nullptr;
+    };
+
+    TripleBuffer() = default;
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    /// Fill a free buffer through `write(T&)` and publish it. `write` returns
+    /// false to abandon the frame. Producer thread only.
+    template <typename Fn>
+    bool publish(Fn&& write) {
+        int current = published.load(std::memory_order_acquire);
+        for (std::size_t i = 0; i < N; ++i) {
+            if (static_cast<int>(i) == current) continue;
+            Slot& slot = slots[i];
+            // Pairs with the pin and re-check in acquire(): a reader that
+            // pinned this slot after the last publish moved away from it
+            // must either be seen here or see that move.
+            if (slot.readers.load(std::memory_order_seq_cst) != 0) continue;
+            if (!write(slot.value)) return false;
+            slot.sequence = ++produced;
+            published.store(static_cast<int>(i), std::memory_order_seq_cst);
+            latest.store(slot.sequence, std::memory_order_seq_cst);
+            if (waiters.load(std::memory_order_seq_cst) > 0) {
+                { std::lock_guard lock(waitMutex); }
+                waitCondition.notify_all();
+            }
+            return true;
+        }
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    /// Pin the most recently published frame. Returns an empty handle until
+    /// the first publish.
+    ReadHandle acquire() const {
+        while (true) {
+            int idx = published.load(std::memory_order_seq_cst);
+            if (idx < 0) return {};
+            Slot& slot = slots[idx];
+            slot.readers.fetch_add(1, std::memory_order_seq_cst);
+            // The producer only writes unpublished slots, so once the slot is
+            // pinned and still published its contents are complete.
+            if (published.load(std::memory_order_seq_cst) == idx) return ReadHandle(&slot);
+            slot.readers.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    /// Block until a frame newer than `after` is published, then pin it.
+    /// Returns an empty handle on timeout.
+    template <typename Rep, typename Period>
+    ReadHandle waitNewer(uint64_t after, std::chrono::duration<Rep, Period> timeout) const {
+        if (latest.load(std::memory_order_acquire) <= after) {
+            waiters.fetch_add(1, std::memory_order_seq_cst);
+            {
+                std::unique_lock lock(waitMutex);
+                waitCondition.wait_for(lock, timeout, [&] {
+                    return latest.load(std::memory_order_seq_cst) > after;
+                });
+            }
+            waiters.fetch_sub(1, std::memory_order_relaxed);
+        }
+        ReadHandle handle = acquire();
+        if (handle.sequence() <= after) handle.release();
+        return handle;
+    }
+
+    /// Sequence number of the latest published frame, 0 if none yet.
+    uint64_t sequence() const { return latest.load(std::memory_order_acquire); }
+
+    /// Frames dropped because every spare buffer was pinned by a reader.
+    uint64_t droppedFrames() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    mutable std::array<Slot, N> slots;
+    std::atomic<int> published{-1};
+    uint64_t produced = 0;
+    std::atomic<uint64_t> latest{0};
+    std::atomic<uint64_t> dropped{0};
+
+    mutable std::atomic<int> waiters{0};
+    mutable std::mutex waitMutex;
+    mutable std::condition_variable waitCondition;
+};
+
+} // namespace UsArMirror
@@ -0,0 +1,360 @@
+#include "v4l2_source.hpp"
+
+#include <opencv2/opencv.hpp>
+#include <spdlog/spdlog.h>
+
+#include <cerrno>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <jpeglib.h>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace UsArMirror {
+
+namespace {
+
+constexpr unsigned int driverBufferCount = 4;
+constexpr int pollTimeoutMs = 100;
+
+int xioctl(int fd, unsigned long request, void* arg) {
+    int result;
+    do {
+        result = ioctl(fd, request, arg);
+    } while (result == -1 && errno == EINTR);
+    return result;
+}
+
+struct JpegErrorManager {
+    jpeg_error_mgr pub;
+    std::jmp_buf jump;
+};
+
+void onJpegError(j_common_ptr cinfo) {
+    std::longjmp(reinterpret_cast<JpegErrorManager*>(cinfo->err)->jump, 1);
+}
+
+// Webcams routinely produce "Corrupt JPEG data" warnings; the frames are
+// still usable, so keep them off stderr.
+void onJpegMessage(j_common_ptr) {}
+
+/// One libjpeg decompressor, reused by a decode worker for every frame.
+struct JpegDecoder {
+    jpeg_decompress_struct cinfo;
+    JpegErrorManager error;
+
+    JpegDecoder() {
+        cinfo.err = jpeg_std_error(&error.pub);
+        error.pub.error_exit = onJpegError;
+        error.pub.output_message = onJpegMessage;
+        jpeg_create_decompress(&cinfo);
+    }
+    ~JpegDecoder() { jpeg_destroy_decompress(&cinfo); }
+
+    JpegDecoder(const JpegDecoder&) = delete;
+    JpegDecoder& operator=(const JpegDecoder&) = delete;
+
+    // The two stages below only touch plain data between setjmp and any
+    // longjmp out of libjpeg, so no C++ object is skipped on error.
+
+    bool start(const uint8_t* data, size_t size, int scale, int& width, int& height) {
+        if (setjmp(error.jump)) {
+            jpeg_abort_decompress(&cinfo);
+            return false;
+        }
+        jpeg_mem_src(&cinfo, const_cast<uint8_t*>(data), static_cast<unsigned long>(size));
+        jpeg_read_header(&cinfo, TRUE);
+        cinfo.out_color_space = JCS_EXT_BGR;
+        cinfo.scale_num = 1;
+        cinfo.scale_denom = static_cast<unsigned int>(scale);
+        cinfo.dct_method = JDCT_IFAST;
+        jpeg_start_decompress(&cinfo);
+        width = static_cast<int>(cinfo.output_width);
+        height = static_cast<int>(cinfo.output_height);
+        return true;
+    }
+
+    bool finish(uint8_t* dst, size_t step) {
+        if (setjmp(error.jump)) {
+            jpeg_abort_decompress(&cinfo);
+            return false;
+        }
+        while (cinfo.output_scanline < cinfo.output_height) {
+            JSAMPROW rows[4];
+            JDIMENSION count = 0;
+            for (; count < 4 && cinfo.output_scanline + count < cinfo.output_height; ++count) {
+                rows[count] = dst + (cinfo.output_scanline + count) * step;
+            }
+            jpeg_read_scanlines(&cinfo, rows, count);
+        }
+        jpeg_finish_decompress(&cinfo);
+        return true;
+    }
+};
+
+} // namespace
+
+V4l2MjpegSource::V4l2MjpegSource(int index, const FrameSourceOptions& options) : index(index), options(options) {
+    if (options.decodeScale != 1 && options.decodeScale != 2 && options.decodeScale != 4 &&
+        options.decodeScale != 8) {
+        throw std::runtime_error("decodeScale must be 1, 2, 4 or 8");
+    }
+    openDevice();
+
+    int threads = std::max(1, options.decodeThreads);
+    maxInFlight = 2 * static_cast<size_t>(threads);
+
+    int width = (captureWidth + options.decodeScale - 1) / options.decodeScale;
+    int height = (captureHeight + options.decodeScale - 1) / options.decodeScale;
+    bool transposed = options.rotateCode.has_value() && options.rotateCode.value() != cv::ROTATE_180;
+    caps.live = true;
+    caps.streams.color.width = transposed ? height : width;
+    caps.streams.color.height = transposed ? width : height;
+
+    // Every frame in flight, twice when rotating.
+    size_t perFrame = options.rotateCode.has_value() ? 2 : 1;
+    framePool = std::make_unique<FramePool>(static_cast<size_t>(width) * height * 3,
+                                            poolBlockCount(options, maxInFlight * perFrame));
+
+    startStreaming();
+    grabThread = std::thread(&V4l2MjpegSource::grabLoop, this);
+    for (int i = 0; i < threads; ++i) decodeThreads.emplace_back(&V4l2MjpegSource::decodeLoop, this);
+
+    spdlog::info("V4L2 MJPEG capture on /dev/video{}: {}x{} @ {:.1f} fps, {} decode threads, 1/{} scale", index,
+                 captureWidth, captureHeight, caps.fps, threads, options.decodeScale);
+}
+
+V4l2MjpegSource::~V4l2MjpegSource() {
+    {
+        std::lock_guard lock(jobMutex);
+        running = false;
+    }
+    jobCondition.notify_all();
+    resultCondition.notify_all();
+    if (grabThread.joinable()) grabThread.join();
+    for (auto& thread : decodeThreads) thread.join();
+    stopStreaming();
+    spdlog::info("/dev/video{} closed: {} frames dropped, {} corrupt", index, dropped.load(), corrupt.load());
+}
+
+void V4l2MjpegSource::openDevice() {
+    std::string path = "/dev/video" + std::to_string(index);
+    fd = open(path.c_str(), O_RDWR | O_NONBLOCK);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open " + path + ": " + std::strerror(errno));
+    }
+
+    v4l2_capability cap{};
+    uint32_t deviceCaps = 0;
+    if (xioctl(fd, VIDIOC_QUERYCAP, &cap) == 0) {
+        // UVC cameras expose metadata nodes that share the device caps.
+        deviceCaps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps : cap.capabilities;
+    }
+    if (!(deviceCaps & V4L2_CAP_VIDEO_CAPTURE) || !(deviceCaps & V4L2_CAP_STREAMING)) {
+        close(fd);
+        throw std::runtime_error(path + " is not a streaming capture device");
+    }
+
+    v4l2_format format{};
+    format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    format.fmt.pix.width = static_cast<uint32_t>(options.width);
+    format.fmt.pix.height = static_cast<uint32_t>(options.height);
+    format.fmt.pix.pixelformat = V4L2_PIX_FMT_MJPEG;
+    format.fmt.pix.field = V4L2_FIELD_ANY;
+    if (xioctl(fd, VIDIOC_S_FMT, &format) != 0 || format.fmt.pix.pixelformat != V4L2_PIX_FMT_MJPEG) {
+        close(fd);
+        throw std::runtime_error(path + " cannot deliver MJPEG");
+    }
+    captureWidth = static_cast<int>(format.fmt.pix.width);
+    captureHeight = static_cast<int>(format.fmt.pix.height);
+
+    v4l2_streamparm parm{};
+    parm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (xioctl(fd, VIDIOC_G_PARM, &parm) == 0 && (parm.parm.capture.capability & V4L2_CAP_TIMEPERFRAME)) {
+        parm.parm.capture.timeperframe.numerator = 1000;
+        parm.parm.capture.timeperframe.denominator = static_cast<uint32_t>(options.fps * 1000.0);
+        xioctl(fd, VIDIOC_S_PARM, &parm);
+    }
+    const v4l2_fract& interval = parm.parm.capture.timeperframe;
+    if (interval.numerator > 0 && interval.denominator > 0) {
+        caps.fps = static_cast<double>(interval.denominator) / interval.numerator;
+    }
+}
+
+void V4l2MjpegSource::startStreaming() {
+    v4l2_requestbuffers request{};
+    request.count = driverBufferCount;
+    request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    request.memory = V4L2_MEMORY_MMAP;
+    if (xioctl(fd, VIDIOC_REQBUFS, &request) != 0 || request.count < 2) {
+        stopStreaming();
+        throw std::runtime_error("Could not allocate V4L2 buffers");
+    }
+
+    buffers.resize(request.count);
+    for (unsigned int i = 0; i < request.count; ++i) {
+        v4l2_buffer buffer{};
+        buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buffer.memory = V4L2_MEMORY_MMAP;
+        buffer.index = i;
+        if (xioctl(fd, VIDIOC_QUERYBUF, &buffer) != 0) {
+            stopStreaming();
+            throw std::runtime_error("Could not query V4L2 buffer");
+        }
+        void* data = mmap(nullptr, buffer.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, buffer.m.offset);
+        if (data == MAP_FAILED) {
+            stopStreaming();
+            throw std::runtime_error("Could not map V4L2 buffer");
+        }
+        buffers[i] = {data, buffer.length};
+        xioctl(fd, VIDIOC_QBUF, &buffer);
+    }
+
+    v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (xioctl(fd, VIDIOC_STREAMON, &type) != 0) {
+        stopStreaming();
+        throw std::runtime_error("Could not start V4L2 streaming");
+    }
+}
+
+void V4l2MjpegSource::stopStreaming() {
+    if (fd < 0) return;
+    v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    xioctl(fd, VIDIOC_STREAMOFF, &type);
+    for (const MappedBuffer& buffer : buffers) {
+        if (buffer.data) munmap(buffer.data, buffer.length);
+    }
+    buffers.clear();
+    close(fd);
+    fd = -1;
+}
+
+void V4l2MjpegSource::grabLoop() {
+    while (running) {
+        pollfd descriptor{fd, POLLIN, 0};
+        int ready = poll(&descriptor, 1, pollTimeoutMs);
+        if (ready <= 0) continue;
+
+        v4l2_buffer buffer{};
+        buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buffer.memory = V4L2_MEMORY_MMAP;
+        if (xioctl(fd, VIDIOC_DQBUF, &buffer) != 0) {
+            if (errno != EAGAIN) spdlog::error("VIDIOC_DQBUF failed: {}", std::strerror(errno));
+            continue;
+        }
+        // Arrival is when the host got the frame, as for every other
+        // backend; the driver's capture time only goes into the timestamp.
+        auto arrival = FrameHandle::Clock::now();
+        double timestampMs = buffer.timestamp.tv_sec * 1000.0 + buffer.timestamp.tv_usec / 1000.0;
+
+        bool queued = false;
+        if (!(buffer.flags & V4L2_BUF_FLAG_ERROR) && buffer.bytesused > 0) {
+            std::lock_guard lock(jobMutex);
+            if (inFlight < maxInFlight) {
+                Job job;
+                if (!spareBuffers.empty()) {
+                    job.jpeg = std::move(spareBuffers.back());
+                    spareBuffers.pop_back();
+                }
+                const auto* bytes = static_cast<const uint8_t*>(buffers[buffer.index].data);
+                job.jpeg.assign(bytes, bytes + buffer.bytesused);
+                job.ticket = nextTicket++;
+                job.timestampMs = timestampMs;
+                job.frameNumber = buffer.sequence;
+                job.arrival = arrival;
+                jobs.push_back(std::move(job));
+                ++inFlight;
+                queued = true;
+            } else {
+                ++dropped;
+            }
+        } else {
+            ++corrupt;
+        }
+        // The compressed frame has been copied out, so the driver can reuse
+        // its buffer while we decode.
+        xioctl(fd, VIDIOC_QBUF, &buffer);
+        if (queued) jobCondition.notify_one();
+    }
+}
+
+void V4l2MjpegSource::decodeLoop() {
+    JpegDecoder decoder;
+    while (true) {
+        Job job;
+        {
+            std::unique_lock lock(jobMutex);
+            jobCondition.wait(lock, [&] { return !jobs.empty() || !running; });
+            if (!running) return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        FrameHandle decoded;
+        int width = 0, height = 0;
+        if (decoder.start(job.jpeg.data(), job.jpeg.size(), options.decodeScale, width, height)) {
+            FrameHandle target = framePool->allocate(height, width, CV_8UC3);
+            if (decoder.finish(target.mat().data, target.mat().step)) decoded = std::move(target);
+        }
+
+        if (decoded && options.rotateCode.has_value()) {
+            const cv::Mat& src = decoded.mat();
+            bool transposed = options.rotateCode.value() != cv::ROTATE_180;
+            FrameHandle rotated = transposed ? framePool->allocate(src.cols, src.rows, src.type())
+                                             : framePool->allocate(src.rows, src.cols, src.type());
+            cv::rotate(src, rotated.mat(), options.rotateCode.value());
+            decoded = std::move(rotated);
+        }
+        if (decoded) {
+            decoded.setTiming(job.timestampMs, job.frameNumber, job.arrival);
+        } else {
+            ++corrupt;
+        }
+
+        {
+            std::lock_guard lock(jobMutex);
+            spareBuffers.push_back(std::move(job.jpeg));
+        }
+        {
+            // Failed frames are published empty so read() does not wait on
+            // their ticket forever.
+            std::lock_guard lock(resultMutex);
+            results.emplace(job.ticket, std::move(decoded));
+        }
+        resultCondition.notify_all();
+    }
+}
+
+bool V4l2MjpegSource::read(DepthCameraFrame& frame, std::chrono::milliseconds timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    std::unique_lock lock(resultMutex);
+    while (running) {
+        if (!resultCondition.wait_until(lock, deadline, [&] { return results.count(nextResult) || !running; })) {
+            return false;
+        }
+        if (!running) break;
+
+        FrameHandle decoded = std::move(results.at(nextResult));
+        results.erase(nextResult++);
+        {
+            std::lock_guard jobLock(jobMutex);
+            --inFlight;
+        }
+        if (decoded.empty()) continue;
+
+        frame.color = std::move(decoded);
+        frame.depth = FrameHandle();
+        frame.pose = cv::Mat();
+        return true;
+    }
+    return false;
+}
+
+} // namespace UsArMirror
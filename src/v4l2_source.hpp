@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "frame_source.hpp"
+
+namespace UsArMirror {
+
+/// MJPEG webcam capture straight from V4L2 with parallel JPEG decoding.
+///
+/// A grab thread dequeues the driver's mmap'd buffers, copies out the
+/// compressed frame and immediately requeues the buffer. Decoding happens
+/// on a small pool of libjpeg-turbo workers, so throughput is bounded by
+/// the number of workers rather than one decode's latency. read() hands
+/// frames out in capture order; when decoding falls behind, new frames are
+/// dropped at the grab thread instead of queueing up latency.
+class V4l2MjpegSource : public FrameSource {
+public:
+    /// Open /dev/video<index>. Throws std::runtime_error if the device does
+    /// not exist, does not stream or cannot deliver MJPEG.
+    V4l2MjpegSource(int index, const FrameSourceOptions& options);
+    ~V4l2MjpegSource() override;
+
+    std::string name() const override { return "v4l2:" + std::to_string(index); }
+    const SourceCapabilities& capabilities() const override { return caps; }
+    bool read(DepthCameraFrame& frame, std::chrono::milliseconds timeout) override;
+
+    /// Frames dropped because every decoder was busy.
+    uint64_t droppedFrames() const { return dropped.load(); }
+    /// Frames whose JPEG data could not be decoded.
+    uint64_t corruptFrames() const { return corrupt.load(); }
+
+private:
+    struct MappedBuffer {
+        void* data = nullptr;
+        size_t length = 0;
+    };
+
+    struct Job {
+        uint64_t ticket = 0;
+        std::vector<uint8_t> jpeg;
+        double timestampMs = 0.0;
+        uint64_t frameNumber = 0;
+        FrameHandle::Clock::time_point arrival;
+    };
+
+    void openDevice();
+    void startStreaming();
+    void stopStreaming();
+    void grabLoop();
+    void decodeLoop();
+
+    int index;
+    FrameSourceOptions options;
+    SourceCapabilities caps;
+    int fd = -1;
+    int captureWidth = 0;
+    int captureHeight = 0;
+    std::vector<MappedBuffer> buffers;
+    std::unique_ptr<FramePool> framePool;
+
+    // Grab thread -> decoders
+    std::mutex jobMutex;
+    std::condition_variable jobCondition;
+    std::deque<Job> jobs;
+    std::vector<std::vector<uint8_t>> spareBuffers;
+    /// Frames between dequeue and read(); bounded so a slow decoder or
+    /// consumer costs dropped frames, not latency.
+    size_t inFlight = 0;
+    size_t maxInFlight = 0;
+    uint64_t nextTicket = 0;
+
+    // Decoders -> read(), reordered by ticket
+    std::mutex resultMutex;
+    std::condition_variable resultCondition;
+    std::map<uint64_t, FrameHandle> results;
+    uint64_t nextResult = 0;
+
+    std::atomic<uint64_t> dropped = 0;
+    std::atomic<uint64_t> corrupt = 0;
+    std::atomic<bool> running = true;
+    std::thread grabThread;
+    std::vector<std::thread> decodeThreads;
+};
+
+} // namespace UsArMirror
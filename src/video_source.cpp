@@ -0,0 +1,104 @@
+#include "video_source.hpp"
+
+#include <opencv2/opencv.hpp>
+#include <spdlog/spdlog.h>
+
+#include <stdexcept>
+
+namespace UsArMirror {
+
+VideoCaptureSource::VideoCaptureSource(int index, const FrameSourceOptions& options)
+    : label("v4l2:" + std::to_string(index)), options(options), pacer(SourcePace::Unthrottled) {
+    spdlog::info("Attempting to open webcam at index {}", index);
+    if (!cap.open(index, cv::CAP_V4L2)) {
+        spdlog::error("Failed to open camera at index {}. Checking /dev/video* availability...", index);
+        for (int i = 0; i <= 10; ++i) {
+            if (i == index) continue;
+            if (cap.open(i, cv::CAP_V4L2)) {
+                spdlog::warn("Fallback successful: opened camera at index {}", i);
+                label = "v4l2:" + std::to_string(i);
+                break;
+            }
+        }
+        if (!cap.isOpened()) {
+            throw std::runtime_error("Could not open camera at index " + std::to_string(index));
+        }
+    }
+
+    const std::string& fourcc = options.fourcc;
+    if (fourcc.size() == 4) {
+        cap.set(cv::CAP_PROP_FOURCC, cv::VideoWriter::fourcc(fourcc[0], fourcc[1], fourcc[2], fourcc[3]));
+    }
+    cap.set(cv::CAP_PROP_FRAME_WIDTH, options.width);
+    cap.set(cv::CAP_PROP_FRAME_HEIGHT, options.height);
+    cap.set(cv::CAP_PROP_FPS, options.fps);
+    caps.live = true;
+    initialise();
+}
+
+VideoCaptureSource::VideoCaptureSource(const std::string& path, const FrameSourceOptions& options)
+    : label("video:" + path), options(options), pacer(options.pace) {
+    if (!cap.open(path)) {
+        throw std::runtime_error("Could not open video: " + path);
+    }
+    initialise();
+}
+
+void VideoCaptureSource::initialise() {
+    int width = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_WIDTH));
+    int height = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_HEIGHT));
+    double fps = cap.get(cv::CAP_PROP_FPS);
+    if (fps > 0) caps.fps = fps;
+
+    bool transposed = options.rotateCode.has_value() && options.rotateCode.value() != cv::ROTATE_180;
+    caps.streams.color.width = transposed ? height : width;
+    caps.streams.color.height = transposed ? width : height;
+
+    // The frame being decoded and its rotated copy are in flight.
+    framePool = std::make_unique<FramePool>(static_cast<size_t>(width) * height * 3, poolBlockCount(options, 2));
+}
+
+bool VideoCaptureSource::read(DepthCameraFrame& frame, std::chrono::milliseconds) {
+    if (done) return false;
+
+    // Decode straight into a pooled block; VideoCapture only reallocates
+    // if the stream size differs from what it reported.
+    int rows = caps.streams.color.height, cols = caps.streams.color.width;
+    bool transposed = options.rotateCode.has_value() && options.rotateCode.value() != cv::ROTATE_180;
+    FrameHandle captured = transposed ? framePool->allocate(cols, rows, CV_8UC3)
+                                      : framePool->allocate(rows, cols, CV_8UC3);
+    if (!cap.read(captured.mat())) {
+        if (caps.live) return false;
+        if (!options.loop || frameCounter == 0) {
+            done = true;
+            return false;
+        }
+        cap.set(cv::CAP_PROP_POS_FRAMES, 0);
+        pacer.restart();
+        if (!cap.read(captured.mat())) {
+            done = true;
+            return false;
+        }
+    }
+
+    // With the V4L2 backend POS_MSEC is the driver's buffer timestamp, for
+    // files it is the presentation time.
+    double timestamp = cap.get(cv::CAP_PROP_POS_MSEC);
+    if (!caps.live) pacer.wait(timestamp);
+    captured.setTiming(timestamp, ++frameCounter, FrameHandle::Clock::now());
+
+    if (options.rotateCode.has_value()) {
+        const cv::Mat& src = captured.mat();
+        FrameHandle rotated = framePool->allocate(rows, cols, src.type());
+        cv::rotate(src, rotated.mat(), options.rotateCode.value());
+        rotated.setTiming(captured.timestamp(), captured.frameNumber(), captured.arrivalTime());
+        captured = std::move(rotated);
+    }
+
+    frame.color = std::move(captured);
+    frame.depth = FrameHandle();
+    frame.pose = cv::Mat();
+    return true;
+}
+
+} // namespace UsArMirror
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <opencv2/videoio.hpp>
+
+#include <memory>
+
+#include "frame_source.hpp"
+
+namespace UsArMirror {
+
+/// Webcams and video files through cv::VideoCapture. Frames are decoded
+/// into pooled buffers; depth is never available.
+class VideoCaptureSource : public FrameSource {
+public:
+    /// Open V4L2 device `index`, falling back to the first device that opens.
+    /// Throws std::runtime_error if none does.
+    VideoCaptureSource(int index, const FrameSourceOptions& options);
+    /// Open a video file. Throws std::runtime_error if it cannot be read.
+    VideoCaptureSource(const std::string& path, const FrameSourceOptions& options);
+
+    std::string name() const override { return label; }
+    const SourceCapabilities& capabilities() const override { return caps; }
+    bool read(DepthCameraFrame& frame, std::chrono::milliseconds timeout) override;
+    bool finished() const override { return done; }
+    SourcePace pace() const override { return options.pace; }
+
+private:
+    void initialise();
+
+    std::string label;
+    FrameSourceOptions options;
+    cv::VideoCapture cap;
+    SourceCapabilities caps;
+    std::unique_ptr<FramePool> framePool;
+    FramePacer pacer;
+    uint64_t frameCounter = 0;
+    bool done = false;
+};
+
+} // namespace UsArMirror